@@ -315,4 +315,17 @@ contract TestContract {
 
 
 
+
+
+    function encode_overloaded(
+        uint p1
+    ) public {}
+
+    function encode_overloaded(
+        string calldata p1,
+        uint p2
+    ) public {}
+
+
+
 }
@@ -0,0 +1,487 @@
+// Micro-benchmarks for the hot paths: hashing, hex, trie roots, ABI encoding/decoding, and signer recovery.
+// The ABI cases reuse TestContract's functions and the values from tests.js.
+//
+//     ./benchmark [--json <file>] [--min-time <ms>] [filter]
+//
+// Reports ns/op, throughput (bytes of input per second, where meaningful) and heap allocations
+// per op. With --json, results are also written to file, one JSON object per benchmark per line.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <memory_resource>
+
+#include <tao/json.hpp>
+
+#include "hoytech/error.h"
+#include "hoytech/hex.h"
+#include "ethers-cpp/keccak.h"
+#include "ethers-cpp/keccakBatch.h"
+#include "ethers-cpp/trieRoot.h"
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/SolidityAbi.h"
+#include "ethers-cpp/ecrecover.h"
+#include "ethers-cpp/txSender.h"
+
+
+// Every heap allocation made by the process is counted
+
+static std::atomic<uint64_t> numAllocs = 0;
+
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // GCC doesn't pair these up after inlining
+
+void *operator new(size_t size) {
+    numAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+
+template<typename T>
+static void doNotOptimize(const T &v) {
+    asm volatile("" : : "r"(&v) : "memory");
+}
+
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double bytesPerSec; // 0 if the benchmark has no meaningful input size
+    double allocsPerOp;
+};
+
+struct BenchRunner {
+    std::string filter;
+    double minTimeNs = 500e6;
+    std::vector<BenchResult> results;
+
+    /// f is run repeatedly, doubling the iteration count until one run takes at least minTime
+    template<typename F>
+    void run(const std::string &name, size_t bytesPerOp, F &&f) {
+        if (name.find(filter) == std::string::npos) return;
+
+        doNotOptimize(f()); // warm up caches and lazily-built state
+
+        uint64_t iterations = 1;
+
+        while (true) {
+            uint64_t allocsBefore = numAllocs.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+
+            for (uint64_t i = 0; i < iterations; i++) doNotOptimize(f());
+
+            double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            uint64_t allocs = numAllocs.load(std::memory_order_relaxed) - allocsBefore;
+
+            if (elapsed >= minTimeNs || iterations >= (1ULL << 40)) {
+                double nsPerOp = elapsed / iterations;
+                results.push_back({ name, iterations, nsPerOp, bytesPerOp ? bytesPerOp * 1e9 / nsPerOp : 0, double(allocs) / iterations });
+                print(results.back());
+                return;
+            }
+
+            iterations *= elapsed < minTimeNs / 16 ? 8 : 2;
+        }
+    }
+
+    void print(const BenchResult &r) {
+        char buf[256];
+        if (r.bytesPerSec) snprintf(buf, sizeof(buf), "%-44s %12.1f ns/op %10.1f MB/s %8.1f allocs/op\n", r.name.c_str(), r.nsPerOp, r.bytesPerSec / 1e6, r.allocsPerOp);
+        else snprintf(buf, sizeof(buf), "%-44s %12.1f ns/op %15s %8.1f allocs/op\n", r.name.c_str(), r.nsPerOp, "", r.allocsPerOp);
+        std::cout << buf << std::flush;
+    }
+
+    void writeJson(const std::string &path) {
+        std::ofstream output(path);
+        if (!output) throw hoytech::error("unable to open ", path);
+
+        for (auto &r : results) {
+            tao::json::value v = tao::json::empty_object;
+            v["name"] = r.name;
+            v["iterations"] = r.iterations;
+            v["nsPerOp"] = r.nsPerOp;
+            v["bytesPerSec"] = r.bytesPerSec;
+            v["allocsPerOp"] = r.allocsPerOp;
+            output << tao::json::to_string(v) << "\n";
+        }
+    }
+};
+
+
+// Return data for a function, encoded by treating its outputs as the inputs of a fake function
+
+static std::string encodeFunctionResult(tao::json::value &abiJson, const std::string &funcName, const tao::json::value &values) {
+    for (auto &item : abiJson.get_array()) {
+        if (item.optional<std::string>("name") != funcName) continue;
+
+        tao::json::value fake = tao::json::empty_object;
+        fake["type"] = "function";
+        fake["name"] = "fake";
+        fake["inputs"] = item.at("outputs");
+        fake["outputs"] = tao::json::empty_array;
+
+        tao::json::value fakeAbi = tao::json::empty_array;
+        fakeAbi.get_array().push_back(fake);
+
+        return EthersCpp::SolidityAbi(fakeAbi).encodeFunctionData("fake", values).substr(4);
+    }
+
+    throw hoytech::error("no such function: ", funcName);
+}
+
+
+// Typed mirrors of TestContract's decode_kitchenSink outputs
+
+struct MyNestedStruct {
+    EthersCpp::Address addr;
+    std::vector<EthersCpp::uint256> nums;
+    static constexpr auto abiFields() { return std::make_tuple(&MyNestedStruct::addr, &MyNestedStruct::nums); }
+};
+
+struct MyDynStruct {
+    EthersCpp::uint256 a;
+    uint64_t b;
+    std::string_view str;
+    MyNestedStruct nested;
+    static constexpr auto abiFields() { return std::make_tuple(&MyDynStruct::a, &MyDynStruct::b, &MyDynStruct::str, &MyDynStruct::nested); }
+};
+
+struct MyStaticStruct {
+    std::array<EthersCpp::uint256, 2> s1;
+    EthersCpp::Address s2;
+    EthersCpp::Bytes32 s3;
+    static constexpr auto abiFields() { return std::make_tuple(&MyStaticStruct::s1, &MyStaticStruct::s2, &MyStaticStruct::s3); }
+};
+
+using KitchenSink = std::tuple<uint64_t, std::vector<EthersCpp::uint256>, EthersCpp::uint256, std::array<uint32_t, 4>, std::string_view, std::string_view,
+                               EthersCpp::Bytes32, EthersCpp::FixedBytes<12>, MyDynStruct, bool, MyStaticStruct>;
+
+struct DecodeStruct3 {
+    EthersCpp::uint256 a;
+    std::string_view b;
+    static constexpr auto abiFields() { return std::make_tuple(&DecodeStruct3::a, &DecodeStruct3::b); }
+};
+
+struct TransferEvent {
+    EthersCpp::Address from;
+    EthersCpp::Address to;
+    EthersCpp::uint256 value;
+    static constexpr auto abiFields() { return std::make_tuple(&TransferEvent::from, &TransferEvent::to, &TransferEvent::value); }
+};
+
+
+int main(int argc, char **argv) {
+    BenchRunner runner;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc) runner.minTimeNs = std::stod(argv[++i]) * 1e6;
+        else if (arg.starts_with("--")) throw hoytech::error("invalid usage");
+        else runner.filter = arg;
+    }
+
+    std::string abiStr;
+
+    {
+        std::ifstream input("artifacts/TestContract.abi");
+        std::stringstream sstr;
+        while(input >> sstr.rdbuf());
+        abiStr = sstr.str();
+    }
+
+    auto abiJson = tao::json::from_string(abiStr);
+    EthersCpp::SolidityAbi abi(abiStr);
+
+
+    // Keccak
+
+    for (size_t size : { 32, 1024 }) {
+        std::string input(size, '\x55');
+        runner.run("keccak256/" + std::to_string(size), size, [&]{ return keccak256(input); });
+
+        runner.run("keccak256NoAlloc/" + std::to_string(size), size, [&]{
+            EthersCpp::Bytes32 output;
+            EthersCpp::Keccak k;
+            k.add(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+            k.getHash(output.data());
+            return output;
+        });
+    }
+
+    // Hex: encoding then decoding into caller-provided buffers with each implementation the CPU
+    // supports, and hoytech's string-building codec for comparison
+
+    for (size_t size : { 32, 1024 }) {
+        std::string input;
+        for (size_t i = 0; i < size; i++) input.push_back(static_cast<char>(i * 37));
+        std::string encoded(size * 2, '\0'), decoded(size, '\0');
+
+        runner.run("hexRoundTrip/" + std::to_string(size) + "/hoytech", size, [&]{ return hoytech::from_hex(hoytech::to_hex(input)); });
+
+        for (auto [impl, implName] : { std::pair{ EthersCpp::HexImpl::Scalar, "scalar" }, { EthersCpp::HexImpl::Ssse3, "ssse3" }, { EthersCpp::HexImpl::Avx2, "avx2" } }) {
+            if (!EthersCpp::hexImplSupported(impl)) continue;
+
+            runner.run("hexRoundTrip/" + std::to_string(size) + "/" + implName, size, [&]{
+                EthersCpp::hexEncode(input, encoded.data(), impl);
+                if (!EthersCpp::hexDecode(encoded, decoded.data(), impl)) throw hoytech::error("hex round trip failed");
+                return decoded[0];
+            });
+        }
+    }
+
+    // Per batch of 256 inputs, with each implementation the CPU supports
+
+    for (size_t size : { 32, 85, 200 }) {
+        std::vector<std::string> inputs;
+        for (size_t i = 0; i < 256; i++) inputs.emplace_back(size, static_cast<char>(i));
+        std::vector<std::string_view> views(inputs.begin(), inputs.end());
+        std::vector<EthersCpp::Keccak256Digest> digests(views.size());
+
+        for (auto [impl, implName] : { std::pair{ EthersCpp::KeccakBatchImpl::Scalar, "scalar" }, { EthersCpp::KeccakBatchImpl::Avx2, "avx2" }, { EthersCpp::KeccakBatchImpl::Avx512, "avx512" } }) {
+            try {
+                EthersCpp::keccak256Batch(views, digests, impl);
+            } catch (hoytech::error &) {
+                continue;
+            }
+
+            runner.run("keccak256Batch/" + std::to_string(size) + "/" + implName, size * views.size(), [&]{ EthersCpp::keccak256Batch(views, digests, impl); return digests[0]; });
+        }
+    }
+
+
+    // Trie roots: a 1500-transaction block's transactionsRoot
+
+    {
+        std::vector<std::string> items;
+        for (size_t i = 0; i < 1500; i++) items.emplace_back(180 + i % 100, static_cast<char>(i));
+        std::vector<std::string_view> views(items.begin(), items.end());
+        size_t size = 0;
+        for (auto &item : items) size += item.size();
+
+        EthersCpp::TrieRoot trie;
+        EthersCpp::ThreadPool pool;
+
+        runner.run("orderedTrieRoot/1500", size, [&]{ return trie.ordered(views); });
+        runner.run("orderedTrieRootPool/1500", size, [&]{ return trie.ordered(views, pool); });
+
+        // The floor: just hashing the items, which the leaf encodings are slightly longer than
+        std::vector<EthersCpp::Keccak256Digest> digests(views.size());
+        runner.run("orderedTrieRootLeafHashes/1500", size, [&]{ EthersCpp::keccak256Batch(views, digests); return digests[0]; });
+    }
+
+
+    // Encoding: encode_kitchenSink
+
+    {
+        auto input = tao::json::from_string(R"({
+            "p3": "-19231212939123912939",
+            "p4": "-123123123123",
+            "p6": "hello world!",
+            "p7": "0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEE",
+            "p8": "0x3333333333333333333333333333333333333333333333333333333333333333",
+            "p9": "0x0011223344556677889900aa",
+            "p10": [1, 2, 3],
+            "p11": "0x00aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+        })");
+
+        size_t size = abi.encodeFunctionData("encode_kitchenSink", input).size();
+
+        runner.run("encodeFunctionData/kitchenSink", size, [&]{ return abi.encodeFunctionData("encode_kitchenSink", input); });
+
+        std::string out;
+        runner.run("encodeFunctionDataReuse/kitchenSink", size, [&]{
+            out.clear();
+            abi.encodeFunctionData("encode_kitchenSink", input, out);
+            return out.size();
+        });
+
+        std::vector<EthersCpp::uint256> p10 = { 1, 2, 3 };
+        std::string p7 = EthersCpp::fromHex(input.at("p7").get_string());
+        auto p3 = EthersCpp::int256::fromString("-19231212939123912939");
+        auto p8 = EthersCpp::fixedBytesFromHex<32>(input.at("p8").get_string());
+        auto p9 = EthersCpp::fixedBytesFromHex<12>(input.at("p9").get_string());
+        auto p11 = EthersCpp::addressFromHex(input.at("p11").get_string());
+        auto encoder = abi.functionDataEncoder<EthersCpp::int256, int64_t, std::string_view, std::string_view, EthersCpp::Bytes32, EthersCpp::FixedBytes<12>,
+                                               std::span<const EthersCpp::uint256>, EthersCpp::Address>("encode_kitchenSink");
+
+        runner.run("encodeTyped/kitchenSink", size, [&]{
+            out.clear();
+            encoder.encode(out, p3, int64_t(-123123123123), "hello world!", p7, p8, p9, std::span<const EthersCpp::uint256>(p10), p11);
+            return out.size();
+        });
+
+        auto structInput = tao::json::from_string(R"({
+            "p1": 1234,
+            "p2": [
+                { "a": 9999, "b": true, "c": false },
+                { "a": 192391293, "b": false, "c": false }
+            ],
+            "p3": 4321
+        })");
+
+        size_t structSize = abi.encodeFunctionData("encode_dyn_arr_struct1", structInput).size();
+
+        runner.run("encodeFunctionDataReuse/dynArrStruct", structSize, [&]{
+            out.clear();
+            abi.encodeFunctionData("encode_dyn_arr_struct1", structInput, out);
+            return out.size();
+        });
+    }
+
+
+    // Decoding: decode_kitchenSink and decode_dyn_array_of_dyn_structs
+
+    {
+        std::string result = encodeFunctionResult(abiJson, "decode_kitchenSink", tao::json::from_string(R"({
+            "o1": "5555555",
+            "o2": ["1", "2", "3"],
+            "o3": "8888888",
+            "o3_5": ["10", "20", "30", "40"],
+            "o4": "hello world",
+            "o5": "0x12345678",
+            "o6": "0x3333333333333333333333333333333333333333333333333333333333333333",
+            "o7": "0x007777777777777777777700",
+            "o8": {
+                "a": "12345",
+                "b": "9876654",
+                "str": "this is a string!",
+                "nested": { "addr": "0xaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "nums": ["8000", "9000"] }
+            },
+            "o9": true,
+            "o10": {
+                "s1": ["123", "234"],
+                "s2": "0xbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb",
+                "s3": "0x4444444444444444444444444444444444444444444444444444444444444444"
+            }
+        })"));
+
+        runner.run("decodeFunctionResult/kitchenSink", result.size(), [&]{ return abi.decodeFunctionResult("decode_kitchenSink", result); });
+
+        std::vector<char> arenaBuffer(1 << 20);
+        std::pmr::monotonic_buffer_resource arena(arenaBuffer.data(), arenaBuffer.size());
+        runner.run("decodeArena/kitchenSink", result.size(), [&]{
+            auto v = abi.decodeFunctionResult("decode_kitchenSink", result, arena);
+            arena.release();
+            return v.size();
+        });
+
+        auto decoder = abi.functionResultDecoder<KitchenSink>("decode_kitchenSink");
+        runner.run("decodeTyped/kitchenSink", result.size(), [&]{ return std::get<0>(decoder(result)); });
+    }
+
+    {
+        tao::json::value structs = tao::json::empty_array;
+        for (int i = 0; i < 100; i++) {
+            tao::json::value s = tao::json::empty_object;
+            s["a"] = std::to_string(i * 1000 + 123);
+            s["b"] = i % 2 ? "hello" : "world";
+            structs.get_array().push_back(std::move(s));
+        }
+
+        tao::json::value values = tao::json::empty_object;
+        values["o1"] = std::move(structs);
+        std::string result = encodeFunctionResult(abiJson, "decode_dyn_array_of_dyn_structs", values);
+
+        runner.run("decodeFunctionResult/dynArrayOfDynStructs", result.size(), [&]{ return abi.decodeFunctionResult("decode_dyn_array_of_dyn_structs", result); });
+
+        auto limitedAbi = abi;
+        limitedAbi.setDecodeLimits(EthersCpp::AbiDecodeLimits());
+        runner.run("decodeFunctionResultLimited/dynArrayOfDynStructs", result.size(), [&]{ return limitedAbi.decodeFunctionResult("decode_dyn_array_of_dyn_structs", result); });
+
+        std::vector<char> arenaBuffer(1 << 20);
+        std::pmr::monotonic_buffer_resource arena(arenaBuffer.data(), arenaBuffer.size());
+        runner.run("decodeArena/dynArrayOfDynStructs", result.size(), [&]{
+            auto v = abi.decodeFunctionResult("decode_dyn_array_of_dyn_structs", result, arena);
+            arena.release();
+            return v.size();
+        });
+
+        auto decoder = abi.functionResultDecoder<std::vector<DecodeStruct3>>("decode_dyn_array_of_dyn_structs");
+        runner.run("decodeTyped/dynArrayOfDynStructs", result.size(), [&]{ return decoder(result).size(); });
+    }
+
+
+    // Events: Transfer(address indexed, address indexed, uint)
+
+    {
+        std::string topics = abi.getEventHash("Transfer");
+        topics += std::string(12, '\0') + std::string(20, '\xaa');
+        topics += std::string(12, '\0') + std::string(20, '\xbb');
+        std::string data = std::string(31, '\0') + "\x64";
+
+        runner.run("decodeEvent/Transfer", topics.size() + data.size(), [&]{ return abi.decodeEvent(topics, data); });
+
+        auto decoder = abi.eventDecoder<TransferEvent>("Transfer");
+        runner.run("decodeEventTyped/Transfer", topics.size() + data.size(), [&]{ return decoder(topics, data).value; });
+    }
+
+
+    // Signer recovery
+
+    {
+        std::string hash = keccak256("benchmark");
+        std::string secretKey(32, '\x11');
+
+        secp256k1_ecdsa_recoverable_signature sig;
+        if (!secp256k1_ecdsa_sign_recoverable(EthersCpp::secp256k1ctx, &sig, reinterpret_cast<const unsigned char*>(hash.data()), reinterpret_cast<const unsigned char*>(secretKey.data()), nullptr, nullptr)) {
+            throw hoytech::error("secp256k1_ecdsa_sign_recoverable");
+        }
+
+        std::string rs(64, '\0');
+        int v;
+        secp256k1_ecdsa_recoverable_signature_serialize_compact(EthersCpp::secp256k1ctx, reinterpret_cast<unsigned char*>(rs.data()), &v, &sig);
+
+        runner.run("ecrecover", 0, [&]{ return EthersCpp::ecrecover(hash, v, std::string_view(rs).substr(0, 32), std::string_view(rs).substr(32)); });
+
+        std::string signature = rs + static_cast<char>(v + 27);
+        runner.run("recoverAddress", 0, [&]{ return *EthersCpp::recoverAddress(hash, signature); });
+
+        // Per batch of 256, so allocs/op is the batch's fixed overhead
+        size_t n = 256;
+        std::vector<EthersCpp::Bytes32> hashes(n, EthersCpp::fixedBytesFromRaw<32>(hash)), rVals(n, EthersCpp::fixedBytesFromRaw<32>(rs.substr(0, 32))), sVals(n, EthersCpp::fixedBytesFromRaw<32>(rs.substr(32)));
+        std::vector<uint8_t> vVals(n, v), ok(n);
+        std::vector<EthersCpp::Address> addresses(n);
+        EthersCpp::ThreadPool pool;
+
+        runner.run("ecrecoverBatch/256", 0, [&]{ return EthersCpp::ecrecoverBatch(hashes, vVals, rVals, sVals, addresses, ok, pool); });
+    }
+
+
+    // Transaction signing hashes: parsing and hashing an EIP-1559 transaction, without recovery
+
+    {
+        std::string fields;
+        for (uint64_t n : { 1, 0, 2, 100, 21000 }) EthersCpp::rlpAppendUint(fields, n);
+        EthersCpp::rlpAppendString(fields, std::string(20, '\x44'));
+        EthersCpp::rlpAppendUint(fields, 1000);
+        EthersCpp::rlpAppendString(fields, std::string(100, '\xab'));
+        EthersCpp::rlpAppendListHeader(fields, 0);
+        EthersCpp::rlpAppendUint(fields, 1);
+        EthersCpp::rlpAppendString(fields, std::string(32, '\x11'));
+        EthersCpp::rlpAppendString(fields, std::string(32, '\x22'));
+
+        std::string rawTx = "\x02";
+        EthersCpp::rlpAppendListHeader(rawTx, fields.size());
+        rawTx += fields;
+
+        runner.run("txSignature/eip1559", rawTx.size(), [&]{ return EthersCpp::txSignature(rawTx).signingHash; });
+    }
+
+
+    if (jsonPath.size()) runner.writeJson(jsonPath);
+
+    return 0;
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <limits>
+#include <memory_resource>
+#include <cstring>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/uint256.h"
+#include "ethers-cpp/AbiPlan.h"
+#include "ethers-cpp/AbiVisitor.h"
+
+
+// Decoding into a caller-supplied std::pmr::memory_resource. The result is a tree of
+// AbiArenaValues with the same shape and formatting as SolidityAbi's tao::json output (objects
+// for tuples, decimal strings for integers, 0x hex for byte values), but every node, string
+// and scratch allocation comes from the resource, and nothing needs to be destroyed:
+//
+//     std::pmr::monotonic_buffer_resource arena;
+//     for (auto &result : results) {
+//         auto v = abi.decodeFunctionResult("getReserves", result, arena);
+//         ... v["reserves"][3]["amount"].getString() ...
+//         arena.release(); // frees the whole result at once
+//     }
+//
+// Object keys point into the ABI, so the SolidityAbi must outlive the values too.
+
+
+namespace EthersCpp {
+
+class AbiArenaValue {
+  public:
+    enum class Type : uint8_t { Null, Bool, String, Array, Object };
+
+    Type type() const { return t; }
+    bool isNull() const { return t == Type::Null; }
+
+    bool getBoolean() const {
+        if (t != Type::Bool) throw hoytech::error("ABI value is not a bool");
+        return b;
+    }
+
+    std::string_view getString() const {
+        if (t != Type::String) throw hoytech::error("ABI value is not a string");
+        return str;
+    }
+
+    /// Number of array elements or object members
+    size_t size() const {
+        if (t != Type::Array && t != Type::Object) throw hoytech::error("ABI value has no elements");
+        return n;
+    }
+
+    const AbiArenaValue &operator[](size_t i) const {
+        if (i >= size()) throw hoytech::error("ABI value index out of range: ", i);
+        return children[i];
+    }
+
+    /// Object member. Like the tao::json output, if names repeat (eg unnamed outputs) the last one is used.
+    const AbiArenaValue *find(std::string_view k) const {
+        if (t != Type::Object) throw hoytech::error("ABI value is not an object");
+        for (size_t i = n; i > 0; i--) {
+            if (keys[i - 1] == k) return &children[i - 1];
+        }
+        return nullptr;
+    }
+
+    const AbiArenaValue &operator[](std::string_view k) const {
+        auto *v = find(k);
+        if (!v) throw hoytech::error("no such ABI value member: ", k);
+        return *v;
+    }
+
+    const AbiArenaValue &operator[](const char *k) const { return (*this)[std::string_view(k)]; }
+
+    /// Name of the i'th object member
+    std::string_view key(size_t i) const {
+        if (t != Type::Object) throw hoytech::error("ABI value is not an object");
+        if (i >= n) throw hoytech::error("ABI value index out of range: ", i);
+        return keys[i];
+    }
+
+    tao::json::value toJson() const {
+        switch (t) {
+            case Type::Bool: return b;
+            case Type::String: return std::string(str);
+
+            case Type::Array: {
+                tao::json::value output = tao::json::empty_array;
+                for (size_t i = 0; i < n; i++) output.get_array().push_back(children[i].toJson());
+                return output;
+            }
+
+            case Type::Object: {
+                tao::json::value output = tao::json::empty_object;
+                for (size_t i = 0; i < n; i++) output[std::string(keys[i])] = children[i].toJson();
+                return output;
+            }
+
+            default: return tao::json::null;
+        }
+    }
+
+  private:
+    friend class AbiArenaBuilder;
+
+    Type t = Type::Null;
+    bool b = false;
+    uint32_t n = 0;
+    std::string_view str;
+    const AbiArenaValue *children = nullptr;
+    const std::string_view *keys = nullptr;
+};
+
+static_assert(std::is_trivially_destructible_v<AbiArenaValue>);
+
+
+/// Visitor (see AbiVisitor.h) that builds AbiArenaValues in a memory_resource
+class AbiArenaBuilder : public AbiVisitor {
+  public:
+    AbiArenaValue result;
+
+    AbiArenaBuilder(std::pmr::memory_resource &mr) : mr(mr), stack(&mr) {}
+
+    void beginTuple(const AbiPlan &, const AbiNode &node) { open(AbiArenaValue::Type::Object, node.numChildren); }
+    void endTuple(const AbiPlan &, const AbiNode &) { stack.pop_back(); }
+    void beginArray(const AbiPlan &, const AbiNode &, size_t len) { open(AbiArenaValue::Type::Array, len); }
+    void endArray(const AbiPlan &, const AbiNode &, size_t) { stack.pop_back(); }
+
+    void key(const AbiPlan &plan, const AbiNode &component) {
+        auto &top = stack.back();
+        top.keys[top.next] = plan.name(component);
+    }
+
+    void uintValue(const AbiPlan &, const AbiNode &, const uint256 &v) {
+        char buf[uint256::maxDecimalDigits];
+        slot() = makeString(copyString(std::string_view(buf, v.toChars(buf))));
+    }
+
+    void intValue(const AbiPlan &, const AbiNode &, const int256 &v) {
+        char buf[uint256::maxDecimalDigits + 1];
+        slot() = makeString(copyString(std::string_view(buf, v.toChars(buf))));
+    }
+
+    void address(const AbiPlan &, const AbiNode &, const Address &v) { slot() = makeString(hexString(asStringView(v))); }
+    void fixedBytes(const AbiPlan &, const AbiNode &, std::string_view v) { slot() = makeString(hexString(v)); }
+    void bytes(const AbiPlan &, const AbiNode &, std::string_view v) { slot() = makeString(hexString(v)); }
+    void string(const AbiPlan &, const AbiNode &, std::string_view v) { slot() = makeString(copyString(v)); }
+
+    void boolean(const AbiPlan &, const AbiNode &, bool v) {
+        auto &s = slot();
+        s.t = AbiArenaValue::Type::Bool;
+        s.b = v;
+    }
+
+    /// A string value referring to v, which isn't copied
+    static AbiArenaValue makeString(std::string_view v) {
+        AbiArenaValue output;
+        output.t = AbiArenaValue::Type::String;
+        output.str = v;
+        return output;
+    }
+
+    /// An object with the given members, which are copied (shallowly) into the arena
+    AbiArenaValue makeObject(std::span<const std::pair<std::string_view, AbiArenaValue>> members) {
+        AbiArenaValue output;
+        output.t = AbiArenaValue::Type::Object;
+        output.n = members.size();
+
+        auto *children = allocate<AbiArenaValue>(members.size());
+        auto *keys = allocate<std::string_view>(members.size());
+
+        for (size_t i = 0; i < members.size(); i++) {
+            keys[i] = members[i].first;
+            children[i] = members[i].second;
+        }
+
+        output.children = children;
+        output.keys = keys;
+        return output;
+    }
+
+  private:
+    struct Frame {
+        AbiArenaValue *children; // the open value's, writable
+        std::string_view *keys;
+        size_t next = 0;
+    };
+
+    std::pmr::memory_resource &mr;
+    std::pmr::vector<Frame> stack;
+
+    template<typename T>
+    T *allocate(size_t count) {
+        if (count == 0) return nullptr;
+        auto *p = static_cast<T*>(mr.allocate(count * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < count; i++) new (p + i) T();
+        return p;
+    }
+
+    std::string_view copyString(std::string_view s) {
+        if (s.empty()) return {};
+        auto *p = static_cast<char*>(mr.allocate(s.size(), 1));
+        memcpy(p, s.data(), s.size());
+        return { p, s.size() };
+    }
+
+    std::string_view hexString(std::string_view raw) {
+        size_t size = 2 + raw.size() * 2;
+        auto *p = static_cast<char*>(mr.allocate(size, 1));
+        p[0] = '0';
+        p[1] = 'x';
+        hexEncode(raw, p + 2);
+        return { p, size };
+    }
+
+    AbiArenaValue &slot() {
+        if (stack.empty()) return result;
+        auto &top = stack.back();
+        return top.children[top.next++];
+    }
+
+    void open(AbiArenaValue::Type type, size_t size) {
+        if (size > std::numeric_limits<uint32_t>::max()) throw hoytech::error("ABI value too large");
+
+        auto &v = slot();
+        v.t = type;
+        v.n = size;
+
+        auto *children = allocate<AbiArenaValue>(size);
+        auto *keys = type == AbiArenaValue::Type::Object ? allocate<std::string_view>(size) : nullptr;
+        v.children = children;
+        v.keys = keys;
+
+        stack.push_back({ children, keys });
+    }
+};
+
+
+/// Decodes the plan's root tuple into mr
+static inline AbiArenaValue abiDecodeArena(const AbiPlan &plan, std::string_view buffer, std::pmr::memory_resource &mr) {
+    AbiArenaBuilder builder(mr);
+    abiVisit(plan, buffer, builder);
+    return builder.result;
+}
+
+/// Same, with limits for untrusted data (see AbiDecodeLimits)
+static inline AbiArenaValue abiDecodeArena(const AbiPlan &plan, std::string_view buffer, std::pmr::memory_resource &mr, const AbiDecodeLimits &limits) {
+    AbiArenaBuilder builder(mr);
+    abiVisit(plan, buffer, builder, limits);
+    return builder.result;
+}
+
+}
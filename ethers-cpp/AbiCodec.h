@@ -0,0 +1,611 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <array>
+#include <tuple>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <optional>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/AbiPlan.h"
+#include "ethers-cpp/AbiVisitor.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/uint256.h"
+
+
+// Encodes and decodes ABI data straight from/into C++ values. AbiCodec<T> knows which ABI
+// types T can hold. AbiEncoder, AbiDecoder and AbiEventDecoder check their types against the
+// ABI once and can then process any number of calls without building a JSON tree.
+//
+//   uint256                           uintN
+//   int256                            intN
+//   native integers                   uintN/intN (each value is range-checked)
+//   bool                              bool
+//   Address                           address (or bytes20)
+//   FixedBytes<N>                     bytesN
+//   std::string, std::string_view     string, bytes (raw, not hex). Decoded views point into the input.
+//   const char *                      string, bytes (encoding only)
+//   std::vector<T>                    T[] or T[k]
+//   std::span<const T>                T[] or T[k] (encoding only)
+//   std::array<T, N>                  T[N] (except uint8_t, which is bytesN)
+//   std::tuple<...>                   tuple
+//   structs with abiFields()          tuple, see below
+//
+// Structs describe their fields, in ABI order, with pointers to members:
+//
+//   struct Pair {
+//       Address token;
+//       uint256 amount;
+//       static constexpr auto abiFields() { return std::make_tuple(&Pair::token, &Pair::amount); }
+//   };
+//
+// or, for types you can't modify, by specialising EthersCpp::AbiFields<T> with a static fields().
+//
+// Decoding reads the buffer through the same hooks as abiVisit(), so AbiDecoder and
+// AbiEventDecoder enforce AbiDecodeLimits (see AbiVisitor.h) when given them.
+
+
+namespace EthersCpp {
+
+template<typename T>
+struct AbiFields;
+
+template<typename T>
+concept AbiStruct = requires { T::abiFields(); } || requires { AbiFields<T>::fields(); };
+
+template<AbiStruct T>
+constexpr auto abiFieldsOf() {
+    if constexpr (requires { T::abiFields(); }) return T::abiFields();
+    else return AbiFields<T>::fields();
+}
+
+
+template<typename T>
+struct AbiCodec;
+
+namespace abiCodecDetail {
+    [[noreturn]] static inline void mismatch(const AbiPlan &plan, const AbiNode &node, std::string_view cppType) {
+        throw hoytech::error("ABI type ", plan.type(node), " (", plan.name(node), ") can't be decoded into ", cppType);
+    }
+
+    // Runs body with the cursor for a node's contents: the cursor itself for static nodes,
+    // or the target of the pointer (as a new offset basis) for dynamic ones. Counts as one
+    // level of nesting with n elements for the limits.
+    template<typename G, typename F>
+    static inline void withBody(const AbiNode &node, AbiDecodeCursor &c, G &g, size_t n, F &&body) {
+        g.enter();
+        g.elements(n);
+
+        if (node.dynamic) {
+            auto target = g.follow(c).newOffsetBasis();
+            body(target);
+        } else {
+            body(c);
+        }
+
+        g.leave();
+    }
+
+    // The next word, counted against the limits
+    template<typename G>
+    static inline const uint8_t *word(AbiDecodeCursor &c, G &g) {
+        g.materialize(32);
+        return reinterpret_cast<const uint8_t*>(g.consume(c).data());
+    }
+
+    // bits is the two's complement representation for intN
+    static inline void checkRange(const AbiPlan &plan, const AbiNode &node, const uint256 &bits) {
+        size_t width = node.byteWidth * 8;
+        bool ok;
+
+        if (node.kind == AbiKind::Uint) ok = width == 256 || (bits >> width).isZero();
+        else ok = (bits >> (width - 1)) == (bits.bit(255) ? ~uint256() >> (width - 1) : uint256());
+
+        if (!ok) throw hoytech::error("value out of range for ", plan.type(node), " (", plan.name(node), ")");
+    }
+
+    // Writes the pointer for a dynamic value at headPos and returns where its body starts
+    static inline size_t startBody(std::string &out, size_t basis, size_t headPos) {
+        writeWord(out, headPos, uint256(out.size() - basis));
+        return out.size();
+    }
+
+    // Encodes elements of a range as consecutive heads starting at headPos, with tails appended
+    template<typename T, typename R>
+    static inline void encodeElems(const AbiPlan &plan, const AbiNode &node, const R &range, std::string &out, size_t headPos) {
+        auto &elem = plan.child(node, 0);
+        size_t n = std::size(range);
+
+        if (node.kind == AbiKind::StaticArray && n != node.arraySize) throw hoytech::error("wrong number of elements for ", plan.type(node), ": ", n);
+
+        size_t basis = headPos;
+
+        if (node.dynamic) {
+            if (node.kind == AbiKind::DynamicArray) {
+                out.append(32, '\0');
+                writeWord(out, out.size() - 32, uint256(n));
+            }
+            basis = headPos = out.size();
+            out.resize(out.size() + n * elem.headSize);
+        }
+
+        for (const auto &v : range) {
+            AbiCodec<T>::encode(plan, elem, v, out, basis, headPos);
+            headPos += elem.headSize;
+        }
+    }
+
+    template<typename T>
+    struct IsTuple : std::false_type {};
+
+    template<typename... Ts>
+    struct IsTuple<std::tuple<Ts...>> : std::true_type {};
+}
+
+
+template<>
+struct AbiCodec<uint256> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::Uint) abiCodecDetail::mismatch(plan, node, "uint256");
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &, const AbiNode &, AbiDecodeCursor &c, uint256 &out, G &g) {
+        out = uint256::fromBigEndian(abiCodecDetail::word(c, g));
+    }
+
+    static void encode(const AbiPlan &plan, const AbiNode &node, const uint256 &v, std::string &out, size_t, size_t headPos) {
+        abiCodecDetail::checkRange(plan, node, v);
+        writeWord(out, headPos, v);
+    }
+};
+
+template<>
+struct AbiCodec<int256> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::Int) abiCodecDetail::mismatch(plan, node, "int256");
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &, const AbiNode &, AbiDecodeCursor &c, int256 &out, G &g) {
+        out = int256::fromBits(uint256::fromBigEndian(abiCodecDetail::word(c, g)));
+    }
+
+    static void encode(const AbiPlan &plan, const AbiNode &node, const int256 &v, std::string &out, size_t, size_t headPos) {
+        abiCodecDetail::checkRange(plan, node, v.bits);
+        writeWord(out, headPos, v.bits);
+    }
+};
+
+template<>
+struct AbiCodec<bool> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::Bool) abiCodecDetail::mismatch(plan, node, "bool");
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &, const AbiNode &, AbiDecodeCursor &c, bool &out, G &g) {
+        g.materialize(32);
+        out = g.consume(c).find_first_not_of('\0') != std::string_view::npos;
+    }
+
+    static void encode(const AbiPlan &, const AbiNode &, bool v, std::string &out, size_t, size_t headPos) {
+        out[headPos + 31] = v ? 1 : 0;
+    }
+};
+
+template<typename T> requires (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+struct AbiCodec<T> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::Uint && node.kind != AbiKind::Int) abiCodecDetail::mismatch(plan, node, "integer");
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &plan, const AbiNode &node, AbiDecodeCursor &c, T &out, G &g) {
+        auto v = uint256::fromBigEndian(abiCodecDetail::word(c, g));
+        bool ok;
+
+        if (node.kind == AbiKind::Int && v.bit(255)) {
+            auto lo = static_cast<int64_t>(v.low64());
+            ok = (v.limbs[1] & v.limbs[2] & v.limbs[3]) == ~uint64_t(0) && lo < 0 && std::in_range<T>(lo);
+            out = static_cast<T>(lo);
+        } else {
+            ok = v.fitsUint64() && std::in_range<T>(v.low64());
+            out = static_cast<T>(v.low64());
+        }
+
+        if (!ok) throw hoytech::error("value out of range for ", plan.type(node), " (", plan.name(node), ")");
+    }
+
+    static void encode(const AbiPlan &plan, const AbiNode &node, T v, std::string &out, size_t, size_t headPos) {
+        uint256 bits;
+
+        if constexpr (std::is_signed_v<T>) {
+            if (v < 0 && node.kind == AbiKind::Uint) throw hoytech::error("value for uint is negative: ", plan.name(node));
+            bits = int256(static_cast<int64_t>(v)).bits;
+        } else {
+            bits = uint256(static_cast<uint64_t>(v));
+        }
+
+        abiCodecDetail::checkRange(plan, node, bits);
+        writeWord(out, headPos, bits);
+    }
+};
+
+/// bytesN, and also address when N == 20
+template<size_t N>
+struct AbiCodec<FixedBytes<N>> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (N == 20 && node.kind == AbiKind::Address) return;
+        if (node.kind != AbiKind::FixedBytes || node.byteWidth != N) abiCodecDetail::mismatch(plan, node, "FixedBytes<" + std::to_string(N) + ">");
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &, const AbiNode &node, AbiDecodeCursor &c, FixedBytes<N> &out, G &g) {
+        memcpy(out.data(), abiCodecDetail::word(c, g) + (node.kind == AbiKind::Address ? 12 : 0), N);
+    }
+
+    static void encode(const AbiPlan &, const AbiNode &node, const FixedBytes<N> &v, std::string &out, size_t, size_t headPos) {
+        memcpy(out.data() + headPos + (node.kind == AbiKind::Address ? 12 : 0), v.data(), N);
+    }
+};
+
+template<typename S> requires (std::is_same_v<S, std::string> || std::is_same_v<S, std::string_view> || std::is_same_v<S, const char*>)
+struct AbiCodec<S> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::String && node.kind != AbiKind::Bytes) abiCodecDetail::mismatch(plan, node, "string");
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &, const AbiNode &, AbiDecodeCursor &c, S &out, G &g) {
+        auto target = g.follow(c);
+        size_t len = g.length(target);
+        out = S(g.consume(target, len));
+        g.materialize(len);
+    }
+
+    static void encode(const AbiPlan &, const AbiNode &, std::string_view v, std::string &out, size_t basis, size_t headPos) {
+        abiCodecDetail::startBody(out, basis, headPos);
+        appendLengthPrefixed(out, v);
+    }
+};
+
+template<typename T>
+struct AbiCodec<std::vector<T>> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::DynamicArray && node.kind != AbiKind::StaticArray) abiCodecDetail::mismatch(plan, node, "std::vector");
+        AbiCodec<T>::check(plan, plan.child(node, 0));
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &plan, const AbiNode &node, AbiDecodeCursor &c, std::vector<T> &out, G &g) {
+        auto &elem = plan.child(node, 0);
+
+        auto decodeElems = [&](AbiDecodeCursor &body, size_t len){
+            // Every element takes at least one head word, so a corrupt length can't cause a huge allocation
+            if (len > body.remaining() / std::max<size_t>(elem.headSize, 32)) throw hoytech::error("buffer underrun");
+            g.elements(len);
+            out.resize(len);
+
+            if constexpr (std::is_same_v<T, bool>) {
+                for (size_t i = 0; i < len; i++) {
+                    bool v;
+                    AbiCodec<bool>::decode(plan, elem, body, v, g);
+                    out[i] = v;
+                }
+            } else {
+                for (auto &v : out) AbiCodec<T>::decode(plan, elem, body, v, g);
+            }
+        };
+
+        g.enter();
+
+        if (node.dynamic) {
+            auto target = g.follow(c);
+            size_t len = node.kind == AbiKind::StaticArray ? node.arraySize : g.length(target);
+            auto body = target.newOffsetBasis();
+            decodeElems(body, len);
+        } else {
+            decodeElems(c, node.arraySize);
+        }
+
+        g.leave();
+    }
+
+    static void encode(const AbiPlan &plan, const AbiNode &node, const std::vector<T> &v, std::string &out, size_t basis, size_t headPos) {
+        if (node.dynamic) abiCodecDetail::startBody(out, basis, headPos);
+        abiCodecDetail::encodeElems<T>(plan, node, v, out, headPos);
+    }
+};
+
+template<typename T>
+struct AbiCodec<std::span<const T>> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        AbiCodec<std::vector<T>>::check(plan, node);
+    }
+
+    static void encode(const AbiPlan &plan, const AbiNode &node, std::span<const T> v, std::string &out, size_t basis, size_t headPos) {
+        if (node.dynamic) abiCodecDetail::startBody(out, basis, headPos);
+        abiCodecDetail::encodeElems<T>(plan, node, v, out, headPos);
+    }
+};
+
+template<typename T, size_t N> requires (!std::is_same_v<T, uint8_t>)
+struct AbiCodec<std::array<T, N>> {
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::StaticArray || node.arraySize != N) abiCodecDetail::mismatch(plan, node, "std::array<T, " + std::to_string(N) + ">");
+        AbiCodec<T>::check(plan, plan.child(node, 0));
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &plan, const AbiNode &node, AbiDecodeCursor &c, std::array<T, N> &out, G &g) {
+        auto &elem = plan.child(node, 0);
+        abiCodecDetail::withBody(node, c, g, N, [&](AbiDecodeCursor &body){
+            for (auto &v : out) AbiCodec<T>::decode(plan, elem, body, v, g);
+        });
+    }
+
+    static void encode(const AbiPlan &plan, const AbiNode &node, const std::array<T, N> &v, std::string &out, size_t basis, size_t headPos) {
+        if (node.dynamic) abiCodecDetail::startBody(out, basis, headPos);
+        abiCodecDetail::encodeElems<T>(plan, node, v, out, headPos);
+    }
+};
+
+/// std::tuple and AbiStruct types
+template<typename T> requires (abiCodecDetail::IsTuple<T>::value || AbiStruct<T>)
+struct AbiCodec<T> {
+    static constexpr size_t numFields() {
+        if constexpr (AbiStruct<T>) return std::tuple_size_v<decltype(abiFieldsOf<T>())>;
+        else return std::tuple_size_v<T>;
+    }
+
+    /// Calls f(index, field) for each field of obj (T or const T), in order
+    template<typename O, typename F>
+    static void forEachField(O &obj, F &&f) {
+        forEachFieldImpl(obj, f, std::make_index_sequence<numFields()>{});
+    }
+
+    static void check(const AbiPlan &plan, const AbiNode &node) {
+        if (node.kind != AbiKind::Tuple || node.numChildren != numFields()) abiCodecDetail::mismatch(plan, node, "tuple/struct with " + std::to_string(numFields()) + " fields");
+
+        checkFields(plan, node, std::make_index_sequence<numFields()>{});
+    }
+
+    template<typename G>
+    static void decode(const AbiPlan &plan, const AbiNode &node, AbiDecodeCursor &c, T &out, G &g) {
+        abiCodecDetail::withBody(node, c, g, numFields(), [&](AbiDecodeCursor &body){
+            forEachField(out, [&]<typename F>(size_t i, F &field){
+                AbiCodec<F>::decode(plan, plan.child(node, i), body, field, g);
+            });
+        });
+    }
+
+    static void encode(const AbiPlan &plan, const AbiNode &node, const T &v, std::string &out, size_t basis, size_t headPos) {
+        if (node.dynamic) {
+            basis = headPos = abiCodecDetail::startBody(out, basis, headPos);
+            out.resize(out.size() + headSizeOfChildren(plan, node));
+        }
+
+        forEachField(v, [&]<typename F>(size_t i, const F &field){
+            auto &child = plan.child(node, i);
+            AbiCodec<F>::encode(plan, child, field, out, basis, headPos);
+            headPos += child.headSize;
+        });
+    }
+
+  private:
+    template<size_t I, typename O>
+    static auto &field(O &obj) {
+        if constexpr (AbiStruct<T>) return obj.*std::get<I>(abiFieldsOf<T>());
+        else return std::get<I>(obj);
+    }
+
+    template<typename O, typename F, size_t... I>
+    static void forEachFieldImpl(O &obj, F &f, std::index_sequence<I...>) {
+        (f(I, field<I>(obj)), ...);
+    }
+
+    static size_t headSizeOfChildren(const AbiPlan &plan, const AbiNode &node) {
+        size_t total = 0;
+        for (size_t i = 0; i < node.numChildren; i++) total += plan.child(node, i).headSize;
+        return total;
+    }
+
+    template<size_t... I>
+    static void checkFields(const AbiPlan &plan, const AbiNode &node, std::index_sequence<I...>) {
+        (AbiCodec<std::remove_cvref_t<decltype(field<I>(std::declval<T&>()))>>::check(plan, plan.child(node, I)), ...);
+    }
+};
+
+
+/// Encodes Args as a plan's items (eg a function's inputs), using the same layout as solc:
+/// each dynamic value's data follows the heads of the tuple or array that contains it.
+/// prefix (eg a function selector) is written before the encoding.
+template<typename... Args>
+class AbiEncoder {
+  public:
+    AbiEncoder(const AbiPlan &plan, std::string_view prefix = "") : plan(&plan), prefix(prefix) {
+        auto &root = plan.root();
+        if (root.numChildren != sizeof...(Args)) throw hoytech::error("ABI has ", root.numChildren, " items but ", sizeof...(Args), " arguments were given");
+
+        size_t i = 0;
+        (AbiCodec<Args>::check(plan, plan.child(root, i++)), ...);
+    }
+
+    /// Appends to out, which can be reused between calls to avoid allocating
+    void encode(std::string &out, const Args &...args) const {
+        auto &root = plan->root();
+
+        out += prefix;
+        size_t basis = out.size();
+        out.resize(basis + root.headSize);
+
+        size_t headPos = basis;
+        size_t i = 0;
+
+        ([&]{
+            auto &child = plan->child(root, i++);
+            AbiCodec<Args>::encode(*plan, child, args, out, basis, headPos);
+            headPos += child.headSize;
+        }(), ...);
+    }
+
+    std::string operator()(const Args &...args) const {
+        std::string out;
+        encode(out, args...);
+        return out;
+    }
+
+  private:
+    const AbiPlan *plan;
+    std::string prefix;
+};
+
+
+/// Decodes buffers laid out by a plan (eg a function's outputs) into T. If T is a tuple or
+/// struct with as many fields as the plan has items, fields map to items. Otherwise the plan
+/// must have exactly one item, which is decoded into T (eg uint256 for balanceOf()).
+/// With limits, decoding throws as soon as the data breaks one of them.
+template<typename T>
+class AbiDecoder {
+  public:
+    AbiDecoder(const AbiPlan &plan, std::optional<AbiDecodeLimits> limits = std::nullopt) : plan(&plan), node(&rootFor(plan)), limits(limits) {
+        AbiCodec<T>::check(plan, *node);
+    }
+
+    void decode(std::string_view data, T &out) const {
+        AbiDecodeCursor c{ data };
+
+        if (limits) {
+            abiVisitorDetail::Bounded g(*limits, data);
+            // Count the root tuple when decoding its only item, as abiVisit() does
+            if (node != &plan->root()) {
+                g.enter();
+                g.elements(1);
+            }
+            AbiCodec<T>::decode(*plan, *node, c, out, g);
+        } else {
+            abiVisitorDetail::NoLimits g;
+            AbiCodec<T>::decode(*plan, *node, c, out, g);
+        }
+    }
+
+    T operator()(std::string_view data) const {
+        T out{};
+        decode(data, out);
+        return out;
+    }
+
+  private:
+    const AbiPlan *plan;
+    const AbiNode *node;
+    std::optional<AbiDecodeLimits> limits;
+
+    static const AbiNode &rootFor(const AbiPlan &plan) {
+        auto &root = plan.root();
+
+        if constexpr (abiCodecDetail::IsTuple<T>::value || AbiStruct<T>) {
+            if (root.numChildren == AbiCodec<T>::numFields()) return root;
+        }
+
+        if (root.numChildren != 1) throw hoytech::error("can't decode ", root.numChildren, " ABI items into a single value");
+        return plan.child(root, 0);
+    }
+};
+
+/// Decodes logs of one event into T, a tuple or struct with one field per event parameter in
+/// declaration order. Indexed parameters come from the topics and the rest from the data.
+/// Indexed strings, bytes, arrays and tuples are only present as their keccak256 hash, so
+/// their fields must be Bytes32.
+template<typename T>
+class AbiEventDecoder {
+  public:
+    static_assert(abiCodecDetail::IsTuple<T>::value || AbiStruct<T>, "event decoding needs a tuple or struct");
+
+    /// isIndexed has one entry per parameter, in declaration order
+    AbiEventDecoder(const AbiPlan &indexed, const AbiPlan &nonIndexed, std::span<const uint8_t> isIndexed, std::string_view topic0,
+                    std::optional<AbiDecodeLimits> limits = std::nullopt) : limits(limits) {
+        if (isIndexed.size() != AbiCodec<T>::numFields()) throw hoytech::error("event has ", isIndexed.size(), " parameters but type has ", AbiCodec<T>::numFields(), " fields");
+        if (topic0.size() != 32) throw hoytech::error("bad topic0 length");
+        memcpy(this->topic0.data(), topic0.data(), 32);
+
+        size_t nextIndexed = 0, nextNonIndexed = 0;
+
+        for (auto i : isIndexed) {
+            Field f;
+            f.indexed = i;
+            f.plan = f.indexed ? &indexed : &nonIndexed;
+            f.node = &f.plan->child(f.plan->root(), f.indexed ? nextIndexed++ : nextNonIndexed++);
+            auto kind = f.node->kind;
+            f.hashed = f.indexed && (f.node->dynamic || kind == AbiKind::Tuple || kind == AbiKind::StaticArray);
+            fields.push_back(f);
+        }
+
+        T dummy{};
+        AbiCodec<T>::forEachField(dummy, [&]<typename F>(size_t i, F &){
+            auto &f = fields[i];
+            if (!f.hashed) AbiCodec<F>::check(*f.plan, *f.node);
+            else if (!std::is_same_v<F, Bytes32>) abiCodecDetail::mismatch(*f.plan, *f.node, "anything except Bytes32 (indexed value is hashed)");
+        });
+    }
+
+    /// topics is the concatenation of all 32-byte topics, including topic0
+    void decode(std::string_view topics, std::string_view data, T &out) const {
+        if (topics.size() < 32 || memcmp(topics.data(), topic0.data(), 32) != 0) throw hoytech::error("log is not an instance of this event");
+
+        if (limits) {
+            abiVisitorDetail::Bounded topicGuard(*limits, topics.substr(32)), dataGuard(*limits, data);
+            decodeFields(topics.substr(32), data, out, topicGuard, dataGuard);
+        } else {
+            abiVisitorDetail::NoLimits topicGuard, dataGuard;
+            decodeFields(topics.substr(32), data, out, topicGuard, dataGuard);
+        }
+    }
+
+    T operator()(std::string_view topics, std::string_view data) const {
+        T out{};
+        decode(topics, data, out);
+        return out;
+    }
+
+  private:
+    struct Field {
+        const AbiPlan *plan;
+        const AbiNode *node;
+        bool indexed;
+        bool hashed;
+    };
+
+    std::vector<Field> fields;
+    Bytes32 topic0;
+    std::optional<AbiDecodeLimits> limits;
+
+    template<typename G>
+    void decodeFields(std::string_view topics, std::string_view data, T &out, G &topicGuard, G &dataGuard) const {
+        AbiDecodeCursor topicCursor{ topics };
+        AbiDecodeCursor dataCursor{ data };
+
+        AbiCodec<T>::forEachField(out, [&]<typename F>(size_t i, F &field){
+            auto &f = fields[i];
+
+            if constexpr (std::is_same_v<F, Bytes32>) {
+                if (f.hashed) {
+                    memcpy(field.data(), abiCodecDetail::word(topicCursor, topicGuard), 32);
+                    return;
+                }
+            }
+
+            if (f.indexed) AbiCodec<F>::decode(*f.plan, *f.node, topicCursor, field, topicGuard);
+            else AbiCodec<F>::decode(*f.plan, *f.node, dataCursor, field, dataGuard);
+        });
+    }
+};
+
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <type_traits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/AbiPlan.h"
+
+
+// Binary precompiled ABIs. AbiFileWriter serialises the processed form of an ABI (compiled
+// parameter plans, selectors, topic hashes and names), usually via SolidityAbi::toBinary().
+// AbiFile maps the result into memory and uses it in place: loading does no JSON parsing and
+// no hashing, and the AbiPlans refer straight to the mapped nodes and strings.
+//
+//     auto file = EthersCpp::AbiFile::open("ERC20.abibin");
+//     EthersCpp::SolidityAbi abi(file);
+//
+// The layout is a header, the function records, the event records, every plan's AbiNodes, and
+// then one block of strings. Records refer to everything else by offset, so the file is
+// position-independent. It's in native byte order, and files written on a machine with a
+// different byte order, AbiNode layout, or format version are rejected.
+
+
+namespace EthersCpp {
+
+struct AbiFileString {
+    uint32_t offset, size; // Into the strings block
+};
+
+struct AbiFilePlan {
+    uint32_t firstNode, numNodes; // Into the nodes block
+    uint32_t stringsOffset, stringsSize; // The plan's own strings, which its nodes' offsets are relative to
+};
+
+struct AbiFileFunction {
+    uint32_t selector; // first 4 bytes of keccak256(signature), big-endian
+    AbiFileString name;
+    AbiFileString signature;
+    AbiFilePlan inputs;
+    AbiFilePlan outputs;
+};
+
+struct AbiFileEvent {
+    uint8_t topic0[32];
+    AbiFileString name;
+    AbiFileString signature;
+    AbiFileString isIndexed; // one byte (0 or 1) per input, in declaration order
+    AbiFilePlan indexedItems;
+    AbiFilePlan nonIndexedItems;
+};
+
+struct AbiFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // byteOrderMark as written by the compiling machine
+    uint32_t nodeSize; // sizeof(AbiNode)
+    uint32_t numFunctions;
+    uint32_t numEvents;
+    uint32_t numNodes;
+    uint64_t stringsSize;
+
+    static constexpr char expectedMagic[8] = { 'E', 'T', 'H', 'A', 'B', 'I', '\0', '\0' };
+    static constexpr uint32_t currentVersion = 1;
+    static constexpr uint32_t byteOrderMark = 0x01020304;
+};
+
+static_assert(std::is_trivially_copyable_v<AbiNode> && std::is_standard_layout_v<AbiNode>);
+static_assert(sizeof(AbiFileHeader) % alignof(AbiNode) == 0 && sizeof(AbiFileFunction) % alignof(AbiNode) == 0 && sizeof(AbiFileEvent) % alignof(AbiNode) == 0,
+              "nodes block must be aligned");
+
+
+class AbiFileWriter {
+  public:
+    void addFunction(std::string_view name, std::string_view signature, uint32_t selector, const AbiPlan &inputs, const AbiPlan &outputs) {
+        AbiFileFunction f{};
+        f.selector = selector;
+        f.name = addString(name);
+        f.signature = addString(signature);
+        f.inputs = addPlan(inputs);
+        f.outputs = addPlan(outputs);
+        functions.push_back(f);
+    }
+
+    void addEvent(std::string_view name, std::string_view signature, const Bytes32 &topic0, std::span<const uint8_t> isIndexed, const AbiPlan &indexedItems, const AbiPlan &nonIndexedItems) {
+        AbiFileEvent e{};
+        memcpy(e.topic0, topic0.data(), 32);
+        e.name = addString(name);
+        e.signature = addString(signature);
+        e.isIndexed = addString(std::string_view(reinterpret_cast<const char*>(isIndexed.data()), isIndexed.size()));
+        e.indexedItems = addPlan(indexedItems);
+        e.nonIndexedItems = addPlan(nonIndexedItems);
+        events.push_back(e);
+    }
+
+    /// The file's contents
+    std::string finish() const {
+        AbiFileHeader h{};
+        memcpy(h.magic, AbiFileHeader::expectedMagic, sizeof(h.magic));
+        h.version = AbiFileHeader::currentVersion;
+        h.byteOrder = AbiFileHeader::byteOrderMark;
+        h.nodeSize = sizeof(AbiNode);
+        h.numFunctions = functions.size();
+        h.numEvents = events.size();
+        h.numNodes = nodes.size();
+        h.stringsSize = strings.size();
+
+        std::string output;
+        output.reserve(sizeof(h) + functions.size() * sizeof(AbiFileFunction) + events.size() * sizeof(AbiFileEvent) + nodes.size() * sizeof(AbiNode) + strings.size());
+
+        auto append = [&](const void *p, size_t n){ output.append(static_cast<const char*>(p), n); };
+        append(&h, sizeof(h));
+        append(functions.data(), functions.size() * sizeof(AbiFileFunction));
+        append(events.data(), events.size() * sizeof(AbiFileEvent));
+        append(nodes.data(), nodes.size() * sizeof(AbiNode));
+        output += strings;
+
+        return output;
+    }
+
+  private:
+    std::vector<AbiFileFunction> functions;
+    std::vector<AbiFileEvent> events;
+    std::vector<AbiNode> nodes;
+    std::string strings;
+
+    AbiFileString addString(std::string_view s) {
+        AbiFileString output{ uint32_t(strings.size()), uint32_t(s.size()) };
+        strings += s;
+        return output;
+    }
+
+    AbiFilePlan addPlan(const AbiPlan &plan) {
+        auto planNodes = plan.allNodes();
+        auto planStrings = addString(plan.allStrings());
+
+        AbiFilePlan output{ uint32_t(nodes.size()), uint32_t(planNodes.size()), planStrings.offset, planStrings.size };
+        nodes.insert(nodes.end(), planNodes.begin(), planNodes.end()); // as-is, since node offsets are relative to the plan
+
+        return output;
+    }
+};
+
+
+class AbiFile {
+  public:
+    /// Maps a file written by AbiFileWriter
+    static std::shared_ptr<const AbiFile> open(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) throw hoytech::error("couldn't open ABI file ", path, ": ", strerror(errno));
+
+        struct stat st;
+        if (::fstat(fd, &st) == -1) {
+            int e = errno;
+            ::close(fd);
+            throw hoytech::error("couldn't stat ABI file ", path, ": ", strerror(e));
+        }
+
+        size_t size = st.st_size;
+        void *p = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        int e = errno;
+        ::close(fd);
+        if (p == MAP_FAILED) throw hoytech::error("couldn't mmap ABI file ", path, ": ", strerror(e));
+
+        std::shared_ptr<AbiFile> file(new AbiFile(std::string_view(static_cast<const char*>(p), size)));
+        file->mapped = p;
+        file->validate();
+        return file;
+    }
+
+    /// Uses contents in place, which must outlive the AbiFile and be 4-byte aligned
+    static std::shared_ptr<const AbiFile> fromBuffer(std::string_view contents) {
+        std::shared_ptr<AbiFile> file(new AbiFile(contents));
+        file->validate();
+        return file;
+    }
+
+    ~AbiFile() {
+        if (mapped) ::munmap(mapped, contents.size());
+    }
+
+    AbiFile(const AbiFile &) = delete;
+    AbiFile &operator=(const AbiFile &) = delete;
+
+    std::span<const AbiFileFunction> functions() const { return { reinterpret_cast<const AbiFileFunction*>(contents.data() + sizeof(AbiFileHeader)), header().numFunctions }; }
+    std::span<const AbiFileEvent> events() const { return { reinterpret_cast<const AbiFileEvent*>(functions().data() + functions().size()), header().numEvents }; }
+
+    std::string_view string(const AbiFileString &s) const { return strings().substr(s.offset, s.size); }
+
+    /// Refers to the file's memory, so the AbiFile must outlive it
+    AbiPlan plan(const AbiFilePlan &p) const {
+        return AbiPlan(nodes().subspan(p.firstNode, p.numNodes), strings().substr(p.stringsOffset, p.stringsSize));
+    }
+
+  private:
+    std::string_view contents;
+    void *mapped = nullptr;
+
+    AbiFile(std::string_view contents) : contents(contents) {}
+
+    const AbiFileHeader &header() const { return *reinterpret_cast<const AbiFileHeader*>(contents.data()); }
+
+    std::span<const AbiNode> nodes() const {
+        return { reinterpret_cast<const AbiNode*>(events().data() + events().size()), header().numNodes };
+    }
+
+    std::string_view strings() const {
+        auto *begin = reinterpret_cast<const char*>(nodes().data() + nodes().size());
+        return { begin, header().stringsSize };
+    }
+
+    // Bounds checks everything that's used later without checks. This is linear in the file
+    // size, but only compares integers.
+    void validate() const {
+        if (contents.size() < sizeof(AbiFileHeader)) throw hoytech::error("ABI file truncated");
+        if (reinterpret_cast<uintptr_t>(contents.data()) % alignof(AbiNode) != 0) throw hoytech::error("ABI file not aligned");
+
+        auto &h = header();
+        if (memcmp(h.magic, AbiFileHeader::expectedMagic, sizeof(h.magic)) != 0) throw hoytech::error("not an ABI file");
+        if (h.version != AbiFileHeader::currentVersion) throw hoytech::error("unsupported ABI file version: ", h.version);
+        if (h.byteOrder != AbiFileHeader::byteOrderMark || h.nodeSize != sizeof(AbiNode)) throw hoytech::error("ABI file written for a different platform");
+
+        uint64_t expectedSize = sizeof(AbiFileHeader) + uint64_t(h.numFunctions) * sizeof(AbiFileFunction) + uint64_t(h.numEvents) * sizeof(AbiFileEvent)
+                                + uint64_t(h.numNodes) * sizeof(AbiNode) + h.stringsSize;
+        if (contents.size() != expectedSize) throw hoytech::error("ABI file size mismatch");
+
+        for (auto &f : functions()) {
+            checkString(f.name);
+            checkString(f.signature);
+            checkPlan(f.inputs);
+            checkPlan(f.outputs);
+        }
+
+        for (auto &e : events()) {
+            checkString(e.name);
+            checkString(e.signature);
+            checkString(e.isIndexed);
+            checkPlan(e.indexedItems);
+            checkPlan(e.nonIndexedItems);
+            checkIsIndexed(e);
+        }
+    }
+
+    void checkString(const AbiFileString &s) const {
+        if (uint64_t(s.offset) + s.size > header().stringsSize) throw hoytech::error("ABI file string out of bounds");
+    }
+
+    // Event decoding takes the next child of one of the root tuples for each byte, without checks
+    void checkIsIndexed(const AbiFileEvent &e) const {
+        size_t numIndexed = 0, numNonIndexed = 0;
+
+        for (char c : string(e.isIndexed)) {
+            if (c == 1) numIndexed++;
+            else if (c == 0) numNonIndexed++;
+            else throw hoytech::error("ABI file event has bad isIndexed");
+        }
+
+        if (numIndexed != nodes()[e.indexedItems.firstNode].numChildren || numNonIndexed != nodes()[e.nonIndexedItems.firstNode].numChildren) {
+            throw hoytech::error("ABI file event isIndexed doesn't match its items");
+        }
+    }
+
+    void checkPlan(const AbiFilePlan &p) const {
+        if (p.numNodes == 0 || uint64_t(p.firstNode) + p.numNodes > header().numNodes) throw hoytech::error("ABI file plan out of bounds");
+        checkString({ p.stringsOffset, p.stringsSize });
+
+        auto planNodes = nodes().subspan(p.firstNode, p.numNodes);
+        if (planNodes[0].kind != AbiKind::Tuple) throw hoytech::error("ABI file plan has no root tuple");
+
+        for (size_t i = 0; i < planNodes.size(); i++) {
+            auto &n = planNodes[i];
+            if (n.kind > AbiKind::Unknown) throw hoytech::error("ABI file has bad node kind");
+            if (uint64_t(n.nameOffset) + n.nameSize > p.stringsSize || uint64_t(n.typeOffset) + n.typeSize > p.stringsSize) throw hoytech::error("ABI file node string out of bounds");
+            bool hasChildren = n.kind == AbiKind::Tuple || n.kind == AbiKind::StaticArray || n.kind == AbiKind::DynamicArray;
+            // Children always follow their parent, so decoding can't loop
+            if (hasChildren && (n.firstChild <= i || uint64_t(n.firstChild) + n.numChildren > p.numNodes)) throw hoytech::error("ABI file node child out of bounds");
+            if ((n.kind == AbiKind::StaticArray || n.kind == AbiKind::DynamicArray) && n.numChildren != 1) throw hoytech::error("ABI file array node needs one child");
+        }
+
+        // The encoders write at the offsets and sizes in the nodes without checks, so recompute them
+        // as AbiPlan does. Children follow their parents, so going backwards checks them first.
+        for (size_t i = planNodes.size(); i-- > 0; ) {
+            auto &n = planNodes[i];
+            bool dynamic = false;
+            uint64_t headSize = 32;
+            bool hasByteWidth = false;
+
+            switch (n.kind) {
+                case AbiKind::Tuple: {
+                    uint64_t componentsSize = 0;
+                    for (size_t j = 0; j < n.numChildren; j++) {
+                        auto &c = planNodes[n.firstChild + j];
+                        if (c.headOffset != componentsSize) throw hoytech::error("ABI file tuple component at wrong offset");
+                        if (c.dynamic) dynamic = true;
+                        componentsSize += c.headSize;
+                    }
+                    if (i == 0) dynamic = false; // the root is never dynamic, and its head holds all the components
+                    headSize = dynamic ? 32 : componentsSize;
+                    break;
+                }
+
+                case AbiKind::StaticArray: {
+                    auto &elem = planNodes[n.firstChild];
+                    dynamic = elem.dynamic;
+                    headSize = dynamic ? 32 : uint64_t(n.arraySize) * elem.headSize;
+                    break;
+                }
+
+                case AbiKind::DynamicArray:
+                case AbiKind::Bytes:
+                case AbiKind::String:
+                    dynamic = true;
+                    break;
+
+                case AbiKind::Uint:
+                case AbiKind::Int:
+                case AbiKind::FixedBytes:
+                    hasByteWidth = true;
+                    break;
+
+                default:
+                    break;
+            }
+
+            // dynamic is read as a byte, since a bool holding anything but 0 or 1 is undefined
+            if (reinterpret_cast<const uint8_t &>(n.dynamic) != dynamic || n.headSize != headSize) throw hoytech::error("ABI file node has inconsistent layout");
+            if (n.kind != AbiKind::StaticArray && n.arraySize != 0) throw hoytech::error("ABI file node has inconsistent layout");
+            if (hasByteWidth ? (n.byteWidth < 1 || n.byteWidth > 32) : n.byteWidth != 0) throw hoytech::error("ABI file node has bad byte width");
+        }
+    }
+};
+
+}
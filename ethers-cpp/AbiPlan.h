@@ -0,0 +1,368 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <span>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/uint256.h"
+
+
+// A parameter list from a JSON ABI (function inputs/outputs, event indexed/non-indexed items),
+// compiled once into a flat array of nodes. The encoder and decoder walk this instead of
+// re-parsing the JSON type strings on every call. Also has the word-level helpers shared by
+// the encoders and decoders.
+
+
+namespace EthersCpp {
+
+enum class AbiKind : uint8_t { Uint, Int, Address, Bool, FixedBytes, Bytes, String, Tuple, DynamicArray, StaticArray, Unknown };
+
+struct AbiNode {
+    AbiKind kind = AbiKind::Unknown;
+    bool dynamic = false;
+    uint8_t byteWidth = 0; // Uint/Int/FixedBytes
+    uint32_t arraySize = 0; // StaticArray
+    uint32_t headSize = 32; // Bytes taken in the enclosing head: 32 for dynamic nodes (the pointer), else the full encoding
+    uint32_t headOffset = 0; // Tuple components: position within the tuple's head
+    uint32_t firstChild = 0; // Tuple: first component, arrays: element type. Tuple components are contiguous.
+    uint32_t numChildren = 0;
+    uint32_t nameOffset = 0, nameSize = 0; // Into AbiPlan::strings
+    uint32_t typeOffset = 0, typeSize = 0;
+};
+
+class AbiPlan {
+  public:
+    AbiPlan() : AbiPlan(std::span<const tao::json::value>{}) {}
+
+    AbiPlan(std::span<const tao::json::value> items) {
+        ownedNodes.resize(1 + items.size());
+
+        AbiNode &root = ownedNodes[0];
+        root.kind = AbiKind::Tuple;
+        root.firstChild = 1;
+        root.numChildren = items.size();
+        root.typeOffset = addString("tuple");
+        root.typeSize = 5;
+
+        uint32_t headSize = 0;
+
+        for (size_t i = 0; i < items.size(); i++) {
+            compile(1 + i, items[i], items[i].at("type").get_string());
+            ownedNodes[1 + i].headOffset = headSize;
+            headSize += ownedNodes[1 + i].headSize;
+        }
+
+        ownedNodes[0].headSize = headSize;
+        bind();
+    }
+
+    /// A plan whose nodes and strings are stored elsewhere (eg in an AbiFile), and must outlive it
+    AbiPlan(std::span<const AbiNode> nodes, std::string_view strings) : nodes(nodes), strings(strings) {}
+
+    AbiPlan(const AbiPlan &o) : ownedNodes(o.ownedNodes), ownedStrings(o.ownedStrings), nodes(o.nodes), strings(o.strings) { bind(); }
+    AbiPlan(AbiPlan &&o) noexcept : ownedNodes(std::move(o.ownedNodes)), ownedStrings(std::move(o.ownedStrings)), nodes(o.nodes), strings(o.strings) { bind(); }
+
+    AbiPlan &operator=(const AbiPlan &o) {
+        if (this != &o) *this = AbiPlan(o);
+        return *this;
+    }
+
+    AbiPlan &operator=(AbiPlan &&o) noexcept {
+        ownedNodes = std::move(o.ownedNodes);
+        ownedStrings = std::move(o.ownedStrings);
+        nodes = o.nodes;
+        strings = o.strings;
+        bind();
+        return *this;
+    }
+
+    const AbiNode &root() const { return nodes[0]; }
+    const AbiNode &child(const AbiNode &node, size_t i) const { return nodes[node.firstChild + i]; }
+
+    std::string_view name(const AbiNode &node) const { return strings.substr(node.nameOffset, node.nameSize); }
+    std::string_view type(const AbiNode &node) const { return strings.substr(node.typeOffset, node.typeSize); }
+
+    /// All of the nodes (nodes[0] is the root tuple, which is never dynamic) and the strings they refer to
+    std::span<const AbiNode> allNodes() const { return nodes; }
+    std::string_view allStrings() const { return strings; }
+
+  private:
+    std::vector<AbiNode> ownedNodes; // Empty if the plan refers to external storage
+    std::string ownedStrings;
+    std::span<const AbiNode> nodes;
+    std::string_view strings;
+
+    // Points the views at the owned storage, which moves when the plan is copied or moved
+    void bind() {
+        if (ownedNodes.empty()) return;
+        nodes = ownedNodes;
+        strings = ownedStrings;
+    }
+
+    uint32_t addString(std::string_view s) {
+        uint32_t offset = ownedStrings.size();
+        ownedStrings += s;
+        return offset;
+    }
+
+    static bool parseNum(std::string_view s, uint32_t &out) {
+        auto res = std::from_chars(s.data(), s.data() + s.size(), out);
+        return res.ec == std::errc() && res.ptr == s.data() + s.size();
+    }
+
+    // Fills ownedNodes[idx]. Array element types share the field (and name) of their array.
+    void compile(size_t idx, const tao::json::value &field, std::string_view type) {
+        AbiNode n;
+
+        auto &fieldName = field.at("name").get_string();
+        n.nameOffset = addString(fieldName);
+        n.nameSize = fieldName.size();
+        n.typeOffset = addString(type);
+        n.typeSize = type.size();
+
+        if (type.ends_with("]")) {
+            auto pos = type.find_last_of('[');
+            if (pos == std::string::npos) throw hoytech::error("unbalanced array brackets in type: ", type);
+            auto arrayLenSpec = type.substr(pos + 1, type.size() - pos - 2);
+
+            if (arrayLenSpec.empty()) {
+                n.kind = AbiKind::DynamicArray;
+                n.dynamic = true;
+            } else {
+                n.kind = AbiKind::StaticArray;
+                if (!parseNum(arrayLenSpec, n.arraySize)) throw hoytech::error("bad array length in type: ", type);
+            }
+
+            n.firstChild = ownedNodes.size();
+            n.numChildren = 1;
+            ownedNodes.emplace_back();
+            compile(n.firstChild, field, type.substr(0, pos));
+
+            auto &elem = ownedNodes[n.firstChild];
+            if (elem.dynamic) n.dynamic = true;
+            n.headSize = n.dynamic ? 32 : n.arraySize * elem.headSize;
+
+            ownedNodes[idx] = n;
+            return;
+        }
+
+        size_t curr = type.find_first_not_of("abcdefghijklmnopqrstuvwxyz");
+        if (curr == std::string::npos) curr = type.size();
+        auto base = type.substr(0, curr);
+        auto suffix = type.substr(curr);
+
+        uint32_t width = 0;
+        bool hasWidth = !suffix.empty() && parseNum(suffix, width);
+
+        if (base == "tuple" && suffix.empty()) {
+            auto &components = field.at("components").get_array();
+
+            n.kind = AbiKind::Tuple;
+            n.firstChild = ownedNodes.size();
+            n.numChildren = components.size();
+            ownedNodes.resize(ownedNodes.size() + components.size());
+
+            uint32_t headSize = 0;
+
+            for (size_t i = 0; i < components.size(); i++) {
+                compile(n.firstChild + i, components[i], components[i].at("type").get_string());
+                auto &c = ownedNodes[n.firstChild + i];
+                if (c.dynamic) n.dynamic = true;
+                c.headOffset = headSize;
+                headSize += c.headSize;
+            }
+
+            n.headSize = n.dynamic ? 32 : headSize;
+        } else if ((base == "uint" || base == "int") && (suffix.empty() || (hasWidth && width % 8 == 0 && width >= 8 && width <= 256))) {
+            n.kind = base == "uint" ? AbiKind::Uint : AbiKind::Int;
+            n.byteWidth = suffix.empty() ? 32 : width / 8;
+        } else if (base == "bytes" && suffix.empty()) {
+            n.kind = AbiKind::Bytes;
+            n.dynamic = true;
+        } else if (base == "bytes" && hasWidth && width >= 1 && width <= 32) {
+            n.kind = AbiKind::FixedBytes;
+            n.byteWidth = width;
+        } else if (base == "address" && suffix.empty()) {
+            n.kind = AbiKind::Address;
+        } else if (base == "bool" && suffix.empty()) {
+            n.kind = AbiKind::Bool;
+        } else if (base == "string" && suffix.empty()) {
+            n.kind = AbiKind::String;
+            n.dynamic = true;
+        } else {
+            // Unsupported types (fixed, function, ...) only throw when a call actually uses them
+            n.kind = AbiKind::Unknown;
+        }
+
+        ownedNodes[idx] = n;
+    }
+};
+
+
+/// Canonical signature of an ABI function or event, as hashed for its selector or topic0: eg
+/// "transfer(address,uint256)". Tuples are written out as their component types.
+static inline std::string abiSignature(std::string_view name, const tao::json::value &inputs) {
+    std::string output(name);
+
+    output += "(";
+
+    bool first = true;
+
+    for (auto &input : inputs.get_array()) {
+        if (!first) output += ",";
+        first = false;
+
+        auto &type = input.at("type").get_string();
+
+        if (type.starts_with("tuple")) {
+            output += abiSignature("", input.at("components"));
+            output += type.substr(5); // any following array modifiers
+        } else {
+            output += type;
+        }
+    }
+
+    output += ")";
+
+    return output;
+}
+
+
+/// Big-endian value of the low 8 bytes of an ABI word (offsets and lengths)
+static inline uint64_t wordToUnsigned(std::string_view word) {
+    uint64_t v = 0;
+    for (size_t i = word.size() - 8; i < word.size(); i++) v = (v << 8) | static_cast<uint8_t>(word[i]);
+    return v;
+}
+
+/// Writes v as a 32-byte big-endian word at pos, which must already be within out
+static inline void writeWord(std::string &out, size_t pos, const uint256 &v) {
+    v.toBigEndian(reinterpret_cast<uint8_t*>(out.data() + pos));
+}
+
+/// Appends the encoding of a bytes or string value: its length, then the data zero-padded to a word boundary
+static inline void appendLengthPrefixed(std::string &out, std::string_view data) {
+    size_t pos = out.size();
+    out.resize(pos + 32 + (data.size() + 31) / 32 * 32);
+    writeWord(out, pos, uint256(data.size()));
+    memcpy(out.data() + pos + 32, data.data(), data.size());
+}
+
+/// Hash for string-keyed unordered_maps that can be searched by string_view without building a key
+struct AbiStringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+/// Name-keyed lookup table, searchable by string_view
+template<typename T>
+using AbiNameMap = std::unordered_map<std::string, T, AbiStringHash, std::equal_to<>>;
+
+/// The member of the JSON object item for a tuple component. Looked up by string_view, since tao's
+/// object map has a transparent comparator, so encoding structs doesn't allocate a key per component.
+static inline const tao::json::value &abiJsonMember(const AbiPlan &plan, const AbiNode &component, const tao::json::value &item) {
+    auto &object = item.get_object();
+    auto it = object.find(plan.name(component));
+    if (it == object.end()) throw hoytech::error("missing value for ", plan.name(component));
+    return it->second;
+}
+
+/// Writes the word for a JSON value of a static, non-composite type (uintN, intN, address, bool,
+/// bytesN) to word, which must be 32 zero bytes. Integers can be JSON numbers or decimal strings,
+/// and byte values are hex.
+static inline void abiWordFromJson(const AbiPlan &plan, const AbiNode &node, const tao::json::value &item, char *word) {
+    auto stripHexPrefix = [](std::string_view str){
+        if (str.size() >= 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) str = str.substr(2);
+        return str;
+    };
+
+    auto store = [&](const uint256 &v){ v.toBigEndian(reinterpret_cast<uint8_t*>(word)); };
+
+    switch (node.kind) {
+        case AbiKind::Address: {
+            auto &str = item.get_string();
+            if (str.size() != 42 || !str.starts_with("0x")) throw hoytech::error("bad length for address: ", str);
+            if (!hexDecode(std::string_view(str).substr(2), word + 12)) throw hoytech::error("invalid hex string");
+            break;
+        }
+
+        case AbiKind::FixedBytes: {
+            auto hex = stripHexPrefix(item.get_string());
+            if (hex.size() != node.byteWidth * 2u) throw hoytech::error("bad length for bytesN: ", item.get_string());
+            if (!hexDecode(hex, word)) throw hoytech::error("invalid hex string");
+            break;
+        }
+
+        case AbiKind::Bool:
+            word[31] = item.get_boolean() ? 1 : 0;
+            break;
+
+        case AbiKind::Uint:
+            if (item.is_integer()) {
+                store(uint256(item.get_unsigned()));
+            } else {
+                auto &str = item.get_string();
+                if (str.starts_with("-")) throw hoytech::error("value for uint is negative: ", str);
+                uint256 n;
+                if (!uint256::parse(str, n)) throw hoytech::error("invalid value for uint: ", str);
+                store(n);
+            }
+            break;
+
+        case AbiKind::Int:
+            if (item.is_unsigned()) {
+                store(uint256(item.get_unsigned()));
+            } else if (item.is_signed()) {
+                store(int256(item.get_signed()).bits);
+            } else {
+                auto &str = item.get_string();
+                int256 n;
+                if (!int256::parse(str, n)) throw hoytech::error("invalid value for int: ", str);
+                store(n.bits);
+            }
+            break;
+
+        default:
+            throw hoytech::error("unexpected type: ", plan.type(node));
+    }
+}
+
+/// Reads an ABI-encoded buffer. Offsets of dynamic data are relative to the start of the
+/// enclosing tuple or array body, which newOffsetBasis() establishes.
+struct AbiDecodeCursor {
+    std::string_view buffer;
+    size_t currOffset = 0;
+
+    std::string_view consume(size_t n = 32) {
+        if (currOffset > buffer.size() || buffer.size() - currOffset < n) throw hoytech::error("buffer underrun");
+        auto slice = buffer.substr(currOffset, n);
+        currOffset += n;
+        return slice;
+    }
+
+    size_t remaining() const {
+        return currOffset > buffer.size() ? 0 : buffer.size() - currOffset;
+    }
+
+    AbiDecodeCursor followPointer() {
+        auto ptr = wordToUnsigned(consume());
+        return AbiDecodeCursor{ buffer, ptr };
+    }
+
+    AbiDecodeCursor newOffsetBasis() const {
+        if (currOffset > buffer.size()) throw hoytech::error("buffer underrun");
+        return AbiDecodeCursor{ buffer.substr(currOffset) };
+    }
+};
+
+}
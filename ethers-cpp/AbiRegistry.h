@@ -0,0 +1,350 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <optional>
+#include <cstring>
+#include <algorithm>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/keccak.h"
+#include "ethers-cpp/keccakConstexpr.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/parallel.h"
+#include "ethers-cpp/AbiPlan.h"
+#include "ethers-cpp/AbiVisitor.h"
+#include "ethers-cpp/LogFilter.h"
+#include "ethers-cpp/SelectorTable.h"
+#include "ethers-cpp/AbiFile.h"
+
+
+// Decodes the logs and calldata of many contracts, each using one of many ABIs:
+//
+//     AbiRegistry registry;
+//     auto erc20 = registry.addAbi(erc20Abi);
+//     for (auto &token : tokens) registry.addContract(token, erc20);
+//     for (auto &log : logs) if (auto v = registry.decodeLog(log); !v.is_null()) ...
+//
+// Events and functions that appear in several ABIs, with the same signature and parameter
+// names, are compiled once and shared. Every (address, topic0) and (address, selector) pair
+// has an entry in a single flat table, so demultiplexing a log or transaction costs one lookup
+// however many contracts are registered.
+
+
+namespace EthersCpp {
+
+class AbiRegistry {
+  public:
+    /// A JSON ABI, as accepted by SolidityAbi. Returns the id to pass to addContract().
+    uint32_t addAbi(tao::json::value &abi) {
+        tao::json::value *items = abi.is_object() ? abi.find("abi") : &abi;
+        if (!items || !items->is_array()) throw hoytech::error("SolidityAbi specification not in expected format");
+
+        Abi entry;
+
+        for (auto &item : items->get_array()) {
+            if (!item.optional<std::string>("name")) continue; // constructor, etc
+
+            auto &type = item.at("type").get_string();
+
+            if (type == "event") entry.events.push_back(_addEventJson(item));
+            else if (type == "function") entry.functions.push_back(_addFunctionJson(item));
+        }
+
+        return _pushAbi(std::move(entry));
+    }
+
+    uint32_t addAbi(std::string_view abiJson) {
+        auto json = tao::json::from_string(abiJson);
+        return addAbi(json);
+    }
+
+    /// A binary ABI (see AbiFile.h). Its plans are used in place, and it's kept mapped.
+    uint32_t addAbi(std::shared_ptr<const AbiFile> file) {
+        Abi entry;
+
+        for (auto &rec : file->events()) {
+            Event e;
+
+            e.name = file->string(rec.name);
+            memcpy(e.topic0.data(), rec.topic0, 32);
+            e.indexedItems = file->plan(rec.indexedItems);
+            e.nonIndexedItems = file->plan(rec.nonIndexedItems);
+
+            auto isIndexed = file->string(rec.isIndexed);
+            entry.events.push_back(_addEvent(file->string(rec.signature), { reinterpret_cast<const uint8_t*>(isIndexed.data()), isIndexed.size() }, std::move(e)));
+        }
+
+        for (auto &rec : file->functions()) {
+            Function f;
+
+            f.name = file->string(rec.name);
+            f.signature = file->string(rec.signature);
+            f.selector = rec.selector;
+            f.inputs = file->plan(rec.inputs);
+
+            entry.functions.push_back(_addFunction(std::move(f)));
+        }
+
+        uint32_t abiId = _pushAbi(std::move(entry));
+        files.push_back(std::move(file));
+        return abiId;
+    }
+
+    /// Logs emitted by address, and calls to it, will be decoded with the given ABI
+    void addContract(const Address &address, uint32_t abiId) {
+        if (abiId >= abis.size()) throw hoytech::error("unknown ABI id: ", abiId);
+        if (!contracts.insert(address).second) throw hoytech::error("contract already added: ", toHex(address, true));
+
+        for (auto i : abis[abiId].events) {
+            if (!logDecoders.insert({ address, events[i].topic0 }, i)) throw hoytech::error("event topic0 clash in ABI: ", events[i].name);
+        }
+
+        for (auto i : abis[abiId].functions) {
+            if (!callDecoders.insert({ address, functions[i].selector }, i)) throw hoytech::error("function selector clash in ABI: ", functions[i].signature);
+        }
+    }
+
+    /// Decode untrusted data with these limits (see AbiDecodeLimits), or without any if nullopt
+    void setDecodeLimits(std::optional<AbiDecodeLimits> limits) {
+        decodeLimits = limits;
+    }
+
+    /// Distinct events and functions across all the ABIs added
+    size_t numEvents() const { return events.size(); }
+    size_t numFunctions() const { return functions.size(); }
+
+
+    /// {name, args, address}, or null if the log's address isn't registered or its topic0 isn't
+    /// an event in that contract's ABI. Throws if the log matches an event but fails to decode.
+    tao::json::value decodeLog(const RawLog &log) const {
+        if (log.topics.empty()) return tao::json::null;
+
+        auto *i = logDecoders.find({ log.address, log.topics[0] });
+        if (!i) return tao::json::null;
+        auto &event = events[*i];
+
+        std::string_view indexedTopics(reinterpret_cast<const char*>(log.topics.data() + 1), (log.topics.size() - 1) * 32);
+
+        tao::json::value args = _abiDecode(event.indexedItems, indexedTopics);
+        tao::json::value args2 = _abiDecode(event.nonIndexedItems, log.data);
+
+        for (auto &pair : args2.get_object()) args[pair.first] = pair.second;
+
+        return { { "name", event.name }, { "args", args }, { "address", toHex(log.address, true) } };
+    }
+
+    /// Decodes a batch of logs on pool's threads, in the same order (see decodeLog())
+    std::vector<tao::json::value> decodeLogs(std::span<const RawLog> logs, ThreadPool &pool) const {
+        std::vector<tao::json::value> output(logs.size());
+
+        pool.parallelFor(logs.size(), [&](size_t i){
+            output[i] = decodeLog(logs[i]);
+        }, 64);
+
+        return output;
+    }
+
+    /// numThreads of 0 means one per hardware thread
+    std::vector<tao::json::value> decodeLogs(std::span<const RawLog> logs, size_t numThreads = 0) const {
+        ThreadPool pool(numThreads);
+        return decodeLogs(logs, pool);
+    }
+
+    /// {name, signature, args} for a transaction's input, or null if to isn't registered or the
+    /// selector isn't a function in that contract's ABI
+    tao::json::value decodeFunctionData(const Address &to, std::string_view calldata) const {
+        if (calldata.size() < 4) return tao::json::null;
+
+        auto *i = callDecoders.find({ to, selectorOf(calldata) });
+        if (!i) return tao::json::null;
+        auto &function = functions[*i];
+
+        return { { "name", function.name }, { "signature", function.signature }, { "args", _abiDecode(function.inputs, calldata.substr(4)) } };
+    }
+
+
+  private:
+    struct Event {
+        std::string name;
+        Bytes32 topic0;
+        AbiPlan indexedItems;
+        AbiPlan nonIndexedItems;
+    };
+
+    struct Function {
+        std::string name;
+        std::string signature;
+        uint32_t selector;
+        AbiPlan inputs;
+    };
+
+    struct Abi {
+        std::vector<uint32_t> events; // indices into the shared events and functions
+        std::vector<uint32_t> functions;
+    };
+
+    struct LogKey {
+        Address address;
+        Bytes32 topic0;
+        bool operator==(const LogKey &) const = default;
+    };
+
+    struct CallKey {
+        Address address;
+        uint32_t selector;
+        bool operator==(const CallKey &) const = default;
+    };
+
+    // Low bytes of the address, since vanity and CREATE2-mined addresses often have leading zeros
+    static uint64_t addressBits(const Address &a) {
+        uint64_t h;
+        memcpy(&h, a.data() + 12, sizeof(h));
+        return h;
+    }
+
+    struct LogKeyHash {
+        size_t operator()(const LogKey &k) const { return addressBits(k.address) ^ FixedBytesHash{}(k.topic0); }
+    };
+
+    struct CallKeyHash {
+        size_t operator()(const CallKey &k) const { return addressBits(k.address) ^ k.selector; }
+    };
+
+    std::vector<Event> events;
+    std::vector<Function> functions;
+    std::vector<Abi> abis;
+
+    std::vector<std::shared_ptr<const AbiFile>> files; // Binary ABIs that plans point into
+
+    // Signature plus parameter names (see _planKey()) to index in events/functions
+    std::unordered_map<std::string, uint32_t> eventsByKey;
+    std::unordered_map<std::string, uint32_t> functionsByKey;
+
+    std::unordered_set<Address, FixedBytesHash> contracts;
+    FlatTable<LogKey, uint32_t, LogKeyHash> logDecoders;
+    FlatTable<CallKey, uint32_t, CallKeyHash> callDecoders;
+
+    std::optional<AbiDecodeLimits> decodeLimits;
+
+
+    uint32_t _addEventJson(const tao::json::value &item) {
+        auto &name = item.at("name").get_string();
+        auto &inputs = item.at("inputs");
+        auto signature = abiSignature(name, inputs);
+
+        Event e;
+
+        e.name = name;
+        e.topic0 = fixedBytesFromRaw<32>(keccak256(signature));
+
+        std::vector<tao::json::value> indexedItems, nonIndexedItems;
+        std::vector<uint8_t> isIndexed;
+
+        for (auto &input : inputs.get_array()) {
+            bool indexed = input.at("indexed").get_boolean();
+            if (indexed) indexedItems.push_back(input);
+            else nonIndexedItems.push_back(input);
+            isIndexed.push_back(indexed);
+        }
+
+        e.indexedItems = AbiPlan(indexedItems);
+        e.nonIndexedItems = AbiPlan(nonIndexedItems);
+
+        return _addEvent(signature, isIndexed, std::move(e));
+    }
+
+    uint32_t _addFunctionJson(const tao::json::value &item) {
+        auto &name = item.at("name").get_string();
+        auto &inputs = item.at("inputs");
+
+        Function f;
+
+        f.name = name;
+        f.signature = abiSignature(name, inputs);
+        f.selector = selectorOf(keccak256(f.signature));
+        f.inputs = AbiPlan(inputs.get_array());
+
+        return _addFunction(std::move(f));
+    }
+
+    // Logs and calls are looked up by topic0 and selector alone, so these have to be unique within
+    // an ABI. This is checked here, rather than when adding contracts, so that a clash can't leave
+    // a contract half added. Entries listed more than once are kept once.
+    uint32_t _pushAbi(Abi &&entry) {
+        for (auto *indices : { &entry.events, &entry.functions }) {
+            std::sort(indices->begin(), indices->end());
+            indices->erase(std::unique(indices->begin(), indices->end()), indices->end());
+        }
+
+        auto byTopic = entry.events;
+        std::stable_sort(byTopic.begin(), byTopic.end(), [&](uint32_t a, uint32_t b){ return events[a].topic0 < events[b].topic0; });
+        for (size_t i = 1; i < byTopic.size(); i++) {
+            if (events[byTopic[i - 1]].topic0 == events[byTopic[i]].topic0) throw hoytech::error("event topic0 clash in ABI: ", events[byTopic[i]].name);
+        }
+
+        auto bySelector = entry.functions;
+        std::stable_sort(bySelector.begin(), bySelector.end(), [&](uint32_t a, uint32_t b){ return functions[a].selector < functions[b].selector; });
+        for (size_t i = 1; i < bySelector.size(); i++) {
+            auto &prev = functions[bySelector[i - 1]], &curr = functions[bySelector[i]];
+            if (prev.selector == curr.selector) throw hoytech::error("function selector clash in ABI: ", prev.signature, " and ", curr.signature);
+        }
+
+        abis.push_back(std::move(entry));
+        return abis.size() - 1;
+    }
+
+    uint32_t _addEvent(std::string_view signature, std::span<const uint8_t> isIndexed, Event &&e) {
+        std::string key(signature);
+        for (auto b : isIndexed) key += b ? 'i' : '-';
+        _planKey(e.indexedItems, key);
+        _planKey(e.nonIndexedItems, key);
+
+        if (auto it = eventsByKey.find(key); it != eventsByKey.end()) return it->second;
+
+        events.push_back(std::move(e));
+        eventsByKey.emplace(std::move(key), events.size() - 1);
+        return events.size() - 1;
+    }
+
+    uint32_t _addFunction(Function &&f) {
+        std::string key = f.signature;
+        _planKey(f.inputs, key);
+
+        if (auto it = functionsByKey.find(key); it != functionsByKey.end()) return it->second;
+
+        functions.push_back(std::move(f));
+        functionsByKey.emplace(std::move(key), functions.size() - 1);
+        return functions.size() - 1;
+    }
+
+    // The parts of a parameter list that affect decoding but aren't in the signature: parameter
+    // names, and for events, which are indexed. For example ERC-20 and ERC-721 Transfer events
+    // have the same signature, but not the same indexing.
+    static void _planKey(const AbiPlan &plan, std::string &out) {
+        out += "[";
+
+        for (auto &node : plan.allNodes()) {
+            out += plan.name(node);
+            out += ",";
+        }
+
+        out += "]";
+    }
+
+    tao::json::value _abiDecode(const AbiPlan &plan, std::string_view buffer) const {
+        AbiJsonBuilder builder;
+        if (decodeLimits) abiVisit(plan, buffer, builder, *decodeLimits);
+        else abiVisit(plan, buffer, builder);
+        return std::move(builder.result);
+    }
+};
+
+}
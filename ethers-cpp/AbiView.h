@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/AbiPlan.h"
+#include "ethers-cpp/AbiCodec.h"
+#include "ethers-cpp/AbiVisitor.h"
+
+
+// Lazy access to ABI-encoded data. An AbiView is a position in the buffer plus the plan node
+// describing what's there. Indexing only follows the offsets needed to reach the requested
+// value, and nothing is decoded until as<T>() (or toJson()) is called:
+//
+//     auto view = abi.functionResultView("getReserves", result);
+//     auto amount = view["reserves"][3]["amount"].as<uint256>();
+//
+// Views don't copy: the buffer and the plan (ie the SolidityAbi) must outlive them. With
+// AbiDecodeLimits, every offset and length followed is checked, and each as<T>(), visit() or
+// toJson() is bounded by the limits on its own.
+
+
+namespace EthersCpp {
+
+class AbiView {
+  public:
+    /// A view of the plan's root tuple
+    AbiView(const AbiPlan &plan, std::string_view buffer, std::optional<AbiDecodeLimits> limits = std::nullopt)
+        : plan(&plan), node(&plan.root()), head{ buffer }, buffer(buffer), limits(limits) {}
+
+    const AbiNode &abiNode() const { return *node; }
+    std::string_view name() const { return plan->name(*node); }
+    std::string_view type() const { return plan->type(*node); }
+
+    /// Number of tuple components or array elements (reads the length of dynamic arrays)
+    size_t size() const {
+        if (node->kind == AbiKind::Tuple) return node->numChildren;
+        if (node->kind == AbiKind::StaticArray) return node->arraySize;
+        if (node->kind == AbiKind::DynamicArray) return arrayBody().second;
+        throw hoytech::error("ABI type ", type(), " (", name(), ") has no elements");
+    }
+
+    /// Tuple component or array element
+    AbiView operator[](size_t i) const {
+        if (node->kind == AbiKind::Tuple) {
+            if (i >= node->numChildren) throw hoytech::error("tuple index out of range: ", i);
+            auto &component = plan->child(*node, i);
+            auto body = tupleBody();
+            body.currOffset += component.headOffset;
+            return AbiView(*this, &component, body);
+        }
+
+        if (node->kind == AbiKind::StaticArray || node->kind == AbiKind::DynamicArray) {
+            auto [body, len] = arrayBody();
+            if (i >= len) throw hoytech::error("array index out of range: ", i);
+            auto &elem = plan->child(*node, 0);
+            body.currOffset += i * elem.headSize;
+            return AbiView(*this, &elem, body);
+        }
+
+        throw hoytech::error("ABI type ", type(), " (", name(), ") can't be indexed");
+    }
+
+    /// Tuple component by name
+    AbiView operator[](std::string_view componentName) const {
+        if (node->kind != AbiKind::Tuple) throw hoytech::error("ABI type ", type(), " (", name(), ") has no named components");
+
+        for (size_t i = 0; i < node->numChildren; i++) {
+            if (plan->name(plan->child(*node, i)) == componentName) return (*this)[i];
+        }
+
+        throw hoytech::error("no such ABI component: ", componentName);
+    }
+
+    AbiView operator[](const char *componentName) const { return (*this)[std::string_view(componentName)]; }
+
+    /// Decodes this value (see AbiCodec.h for the supported types). std::string_views point into the buffer.
+    template<typename T>
+    T as() const {
+        AbiCodec<T>::check(*plan, *node);
+        T out{};
+        withGuard([&](AbiDecodeCursor &c, auto &g){ AbiCodec<T>::decode(*plan, *node, c, out, g); });
+        return out;
+    }
+
+    /// Streams this value to a visitor (see AbiVisitor.h)
+    template<typename V>
+    void visit(V &visitor) const {
+        withGuard([&](AbiDecodeCursor &c, auto &g){ abiVisitNode(*plan, *node, c, visitor, g); });
+    }
+
+    tao::json::value toJson() const {
+        AbiJsonBuilder builder;
+        visit(builder);
+        return std::move(builder.result);
+    }
+
+  private:
+    const AbiPlan *plan;
+    const AbiNode *node;
+    AbiDecodeCursor head; // positioned at this value's head, relative to the enclosing offset basis
+    std::string_view buffer; // the whole buffer, which the limits' word tracking is relative to
+    std::optional<AbiDecodeLimits> limits;
+
+    AbiView(const AbiView &parent, const AbiNode *node, AbiDecodeCursor head)
+        : plan(parent.plan), node(node), head(head), buffer(parent.buffer), limits(parent.limits) {}
+
+    template<typename F>
+    void withGuard(F &&f) const {
+        auto c = head;
+
+        if (limits) {
+            abiVisitorDetail::Bounded g(*limits, buffer);
+            f(c, g);
+        } else {
+            abiVisitorDetail::NoLimits g;
+            f(c, g);
+        }
+    }
+
+    AbiDecodeCursor follow(AbiDecodeCursor &c) const {
+        if (!limits) return c.followPointer();
+        return AbiDecodeCursor{ c.buffer, abiVisitorDetail::checkedOffset(c.consume(), *limits) };
+    }
+
+    AbiDecodeCursor tupleBody() const {
+        auto c = head;
+        if (node->dynamic) return follow(c).newOffsetBasis();
+        return c;
+    }
+
+    std::pair<AbiDecodeCursor, size_t> arrayBody() const {
+        auto c = head;
+        if (!node->dynamic) return { c, node->arraySize };
+
+        auto target = follow(c);
+        if (node->kind == AbiKind::StaticArray) return { target.newOffsetBasis(), node->arraySize };
+
+        auto word = target.consume();
+        size_t len = limits ? abiVisitorDetail::checkedLength(word, *limits) : wordToUnsigned(word);
+        return { target.newOffsetBasis(), len };
+    }
+};
+
+}
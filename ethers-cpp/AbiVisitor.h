@@ -0,0 +1,366 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/uint256.h"
+#include "ethers-cpp/AbiPlan.h"
+
+
+// Streaming ABI decoding. abiVisit() walks an encoded buffer and calls a visitor as it goes,
+// so nothing is materialised unless the visitor wants it:
+//
+//   beginTuple, then key() before each component's value, then endTuple
+//   beginArray(len), then each element's value, then endArray(len)
+//   uintValue, intValue, address, boolean, fixedBytes, bytes, string
+//
+// AbiJsonEvents adapts these callbacks to the tao::json events interface, so for example
+// tao::json::events::to_stream writes JSON straight to an ostream. AbiJsonBuilder builds the
+// tao::json::value that SolidityAbi's decode functions return.
+
+
+namespace EthersCpp {
+
+/// No-op callbacks. Derive from this and hide the ones you need.
+struct AbiVisitor {
+    void beginTuple(const AbiPlan &, const AbiNode &) {}
+    void key(const AbiPlan &, const AbiNode &) {} // argument is the component about to be visited
+    void endTuple(const AbiPlan &, const AbiNode &) {}
+    void beginArray(const AbiPlan &, const AbiNode &, size_t) {}
+    void endArray(const AbiPlan &, const AbiNode &, size_t) {}
+
+    void uintValue(const AbiPlan &, const AbiNode &, const uint256 &) {}
+    void intValue(const AbiPlan &, const AbiNode &, const int256 &) {}
+    void address(const AbiPlan &, const AbiNode &, const Address &) {}
+    void boolean(const AbiPlan &, const AbiNode &, bool) {}
+    void fixedBytes(const AbiPlan &, const AbiNode &, std::string_view) {}
+    void bytes(const AbiPlan &, const AbiNode &, std::string_view) {} // string_views point into the input
+    void string(const AbiPlan &, const AbiNode &, std::string_view) {}
+};
+
+
+/// Limits for decoding untrusted data, eg return data and logs from arbitrary contracts. Offsets
+/// in ABI-encoded data can point anywhere, including at data that has already been decoded, so
+/// without limits a few hundred bytes can decode into exponentially many values. With
+/// strictOffsets, each word of input is read at most once, so decoding is O(input size).
+struct AbiDecodeLimits {
+    size_t maxElements = 100'000; // array elements and tuple components, at any depth
+    size_t maxBytes = 16 * 1024 * 1024; // materialized: 32 per word value, plus the length of each bytes and string
+    size_t maxDepth = 32; // nested arrays and tuples, counting the outermost tuple
+    bool strictOffsets = true; // offsets must be word-aligned, and no data can be read twice
+};
+
+namespace abiVisitorDetail {
+    // The checks on every offset and length word, also used by AbiView when indexing
+    static inline size_t checkedLength(std::string_view word, const AbiDecodeLimits &limits) {
+        if (limits.strictOffsets && word.find_first_not_of('\0') < 24) throw hoytech::error("ABI offset or length too large");
+        return wordToUnsigned(word);
+    }
+
+    static inline size_t checkedOffset(std::string_view word, const AbiDecodeLimits &limits) {
+        size_t ptr = checkedLength(word, limits);
+        if (limits.strictOffsets && ptr % 32) throw hoytech::error("ABI offset not word-aligned");
+        return ptr;
+    }
+
+    // Hooks called by abiVisitNode() and AbiCodec<T>::decode(). With no limits, these compile away.
+    struct NoLimits {
+        std::string_view consume(AbiDecodeCursor &c, size_t n = 32) { return c.consume(n); }
+        AbiDecodeCursor follow(AbiDecodeCursor &c) { return c.followPointer(); }
+        size_t length(AbiDecodeCursor &c) { return wordToUnsigned(c.consume()); }
+        void elements(size_t) {}
+        void materialize(size_t) {}
+        void enter() {}
+        void leave() {}
+    };
+
+    class Bounded {
+      public:
+        Bounded(const AbiDecodeLimits &limits, std::string_view buffer) : limits(limits), base(buffer.data()) {
+            if (limits.strictOffsets) wordsRead.resize((buffer.size() + 31) / 32);
+        }
+
+        std::string_view consume(AbiDecodeCursor &c, size_t n = 32) {
+            auto slice = c.consume(n);
+            if (!limits.strictOffsets) return slice;
+
+            // Positions are word-aligned since offsets are, and a partial last word is taken whole
+            size_t first = (slice.data() - base) / 32, last = (slice.data() - base + slice.size() + 31) / 32;
+            for (size_t i = first; i < last; i++) {
+                if (wordsRead[i]) throw hoytech::error("ABI offset overlaps other data");
+                wordsRead[i] = true;
+            }
+
+            return slice;
+        }
+
+        AbiDecodeCursor follow(AbiDecodeCursor &c) {
+            return AbiDecodeCursor{ c.buffer, checkedOffset(consume(c), limits) };
+        }
+
+        size_t length(AbiDecodeCursor &c) {
+            return checkedLength(consume(c), limits);
+        }
+
+        void elements(size_t n) {
+            if (n > limits.maxElements - numElements) throw hoytech::error("ABI decode limit exceeded: too many elements");
+            numElements += n;
+        }
+
+        void materialize(size_t n) {
+            if (n > limits.maxBytes - numBytes) throw hoytech::error("ABI decode limit exceeded: too many bytes");
+            numBytes += n;
+        }
+
+        void enter() {
+            if (++depth > limits.maxDepth) throw hoytech::error("ABI decode limit exceeded: nested too deeply");
+        }
+
+        void leave() { depth--; }
+
+      private:
+        const AbiDecodeLimits &limits;
+        const char *base;
+        size_t numElements = 0;
+        size_t numBytes = 0;
+        size_t depth = 0;
+        std::vector<bool> wordsRead;
+    };
+}
+
+
+template<typename V, typename G>
+static inline void abiVisitNode(const AbiPlan &plan, const AbiNode &node, AbiDecodeCursor &c, V &v, G &g) {
+    switch (node.kind) {
+        case AbiKind::DynamicArray:
+        case AbiKind::StaticArray: {
+            auto &elem = plan.child(node, 0);
+            g.enter();
+
+            if (node.dynamic) {
+                auto target = g.follow(c);
+                size_t len = node.kind == AbiKind::StaticArray ? node.arraySize : g.length(target);
+                // Every element has a head, so visitors can size their output by len without trusting it blindly
+                if (elem.headSize && len > target.remaining() / elem.headSize) throw hoytech::error("array length exceeds data");
+                g.elements(len);
+                auto body = target.newOffsetBasis();
+                v.beginArray(plan, node, len);
+                for (size_t i = 0; i < len; i++) abiVisitNode(plan, elem, body, v, g);
+                v.endArray(plan, node, len);
+            } else {
+                g.elements(node.arraySize);
+                v.beginArray(plan, node, node.arraySize);
+                for (size_t i = 0; i < node.arraySize; i++) abiVisitNode(plan, elem, c, v, g);
+                v.endArray(plan, node, node.arraySize);
+            }
+
+            g.leave();
+            return;
+        }
+
+        case AbiKind::Tuple: {
+            g.enter();
+            g.elements(node.numChildren);
+
+            auto visitComponents = [&](AbiDecodeCursor &body){
+                v.beginTuple(plan, node);
+                for (size_t i = 0; i < node.numChildren; i++) {
+                    auto &component = plan.child(node, i);
+                    v.key(plan, component);
+                    abiVisitNode(plan, component, body, v, g);
+                }
+                v.endTuple(plan, node);
+            };
+
+            if (node.dynamic) {
+                auto body = g.follow(c).newOffsetBasis();
+                visitComponents(body);
+            } else {
+                visitComponents(c);
+            }
+
+            g.leave();
+            return;
+        }
+
+        case AbiKind::Address:
+            g.materialize(32);
+            v.address(plan, node, fixedBytesFromRaw<20>(g.consume(c).substr(12)));
+            return;
+
+        case AbiKind::Uint:
+            g.materialize(32);
+            v.uintValue(plan, node, uint256::fromBigEndian(g.consume(c)));
+            return;
+
+        case AbiKind::Int:
+            g.materialize(32);
+            v.intValue(plan, node, int256::fromBigEndian(g.consume(c)));
+            return;
+
+        case AbiKind::Bool:
+            g.materialize(32);
+            v.boolean(plan, node, g.consume(c).find_first_not_of('\0') != std::string_view::npos);
+            return;
+
+        case AbiKind::String:
+        case AbiKind::Bytes: {
+            auto target = g.follow(c);
+            size_t len = g.length(target);
+            auto str = g.consume(target, len);
+            g.materialize(len);
+
+            if (node.kind == AbiKind::String) v.string(plan, node, str);
+            else v.bytes(plan, node, str);
+            return;
+        }
+
+        case AbiKind::FixedBytes:
+            g.materialize(32);
+            v.fixedBytes(plan, node, g.consume(c).substr(0, node.byteWidth));
+            return;
+
+        default:
+            throw hoytech::error("unrecognized type: ", plan.type(node));
+    }
+}
+
+template<typename V>
+static inline void abiVisitNode(const AbiPlan &plan, const AbiNode &node, AbiDecodeCursor &c, V &v) {
+    abiVisitorDetail::NoLimits g;
+    abiVisitNode(plan, node, c, v, g);
+}
+
+/// Visits the plan's root tuple, encoded in buffer
+template<typename V>
+static inline void abiVisit(const AbiPlan &plan, std::string_view buffer, V &visitor) {
+    AbiDecodeCursor c{ buffer };
+    abiVisitNode(plan, plan.root(), c, visitor);
+}
+
+/// Same, but throws as soon as the data breaks one of the limits
+template<typename V>
+static inline void abiVisit(const AbiPlan &plan, std::string_view buffer, V &visitor, const AbiDecodeLimits &limits) {
+    AbiDecodeCursor c{ buffer };
+    abiVisitorDetail::Bounded g(limits, buffer);
+    abiVisitNode(plan, plan.root(), c, visitor, g);
+}
+
+
+/// Forwards to a tao::json events consumer, producing the same JSON as SolidityAbi's
+/// decoders: tuples are objects, integers are decimal strings and byte values are 0x hex.
+/// Object members come out in declaration order, and repeated names (eg unnamed outputs) are
+/// all emitted.
+template<typename Consumer>
+class AbiJsonEvents : public AbiVisitor {
+  public:
+    AbiJsonEvents(Consumer &consumer) : consumer(consumer) {}
+
+    void beginTuple(const AbiPlan &, const AbiNode &node) {
+        consumer.begin_object(node.numChildren);
+        inArray.push_back(false);
+    }
+
+    void key(const AbiPlan &plan, const AbiNode &component) {
+        consumer.key(plan.name(component));
+    }
+
+    void endTuple(const AbiPlan &, const AbiNode &node) {
+        inArray.pop_back();
+        consumer.end_object(node.numChildren);
+        valueDone();
+    }
+
+    void beginArray(const AbiPlan &, const AbiNode &, size_t len) {
+        consumer.begin_array(len);
+        inArray.push_back(true);
+    }
+
+    void endArray(const AbiPlan &, const AbiNode &, size_t len) {
+        inArray.pop_back();
+        consumer.end_array(len);
+        valueDone();
+    }
+
+    void uintValue(const AbiPlan &, const AbiNode &, const uint256 &v) { emitString(v.toString()); }
+    void intValue(const AbiPlan &, const AbiNode &, const int256 &v) { emitString(v.toString()); }
+    void address(const AbiPlan &, const AbiNode &, const Address &v) { emitString(toHex(v, true)); }
+    void fixedBytes(const AbiPlan &, const AbiNode &, std::string_view v) { emitString(toHex(v, true)); }
+    void bytes(const AbiPlan &, const AbiNode &, std::string_view v) { emitString(toHex(v, true)); }
+    void string(const AbiPlan &, const AbiNode &, std::string_view v) { emitString(v); }
+
+    void boolean(const AbiPlan &, const AbiNode &, bool v) {
+        consumer.boolean(v);
+        valueDone();
+    }
+
+  private:
+    Consumer &consumer;
+    std::vector<bool> inArray;
+
+    void emitString(std::string_view v) {
+        consumer.string(v);
+        valueDone();
+    }
+
+    void valueDone() {
+        if (inArray.empty()) return;
+        if (inArray.back()) consumer.element();
+        else consumer.member();
+    }
+};
+
+
+/// Builds a tao::json::value. Unlike AbiJsonEvents, a repeated name replaces the earlier member.
+class AbiJsonBuilder : public AbiVisitor {
+  public:
+    tao::json::value result;
+
+    void beginTuple(const AbiPlan &, const AbiNode &) {
+        auto &v = slot();
+        v = tao::json::empty_object;
+        stack.push_back(&v);
+    }
+
+    void key(const AbiPlan &plan, const AbiNode &component) {
+        currKey = plan.name(component);
+    }
+
+    void endTuple(const AbiPlan &, const AbiNode &) { stack.pop_back(); }
+
+    void beginArray(const AbiPlan &, const AbiNode &, size_t) {
+        auto &v = slot();
+        v = tao::json::empty_array;
+        stack.push_back(&v);
+    }
+
+    void endArray(const AbiPlan &, const AbiNode &, size_t) { stack.pop_back(); }
+
+    void uintValue(const AbiPlan &, const AbiNode &, const uint256 &v) { slot() = v.toString(); }
+    void intValue(const AbiPlan &, const AbiNode &, const int256 &v) { slot() = v.toString(); }
+    void address(const AbiPlan &, const AbiNode &, const Address &v) { slot() = toHex(v, true); }
+    void boolean(const AbiPlan &, const AbiNode &, bool v) { slot() = v; }
+    void fixedBytes(const AbiPlan &, const AbiNode &, std::string_view v) { slot() = toHex(v, true); }
+    void bytes(const AbiPlan &, const AbiNode &, std::string_view v) { slot() = toHex(v, true); }
+    void string(const AbiPlan &, const AbiNode &, std::string_view v) { slot() = std::string(v); }
+
+  private:
+    // Containers are only appended to while they're on top of the stack, so these stay valid
+    std::vector<tao::json::value*> stack;
+    std::string_view currKey;
+
+    tao::json::value &slot() {
+        if (stack.empty()) return result;
+        auto &top = *stack.back();
+        if (top.is_array()) return top.get_array().emplace_back();
+        return top[std::string(currKey)];
+    }
+};
+
+}
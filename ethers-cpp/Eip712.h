@@ -0,0 +1,405 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <set>
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include <type_traits>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/keccak.h"
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/parallel.h"
+#include "ethers-cpp/ecrecover.h"
+#include "ethers-cpp/AbiPlan.h"
+#include "ethers-cpp/AbiCodec.h"
+
+
+// EIP-712 typed structured data hashing. The types are given as for eth_signTypedData_v4:
+//
+//     EthersCpp::Eip712 eip712(types, { { "name", "Exchange" }, { "chainId", 1 }, { "verifyingContract", exchange } });
+//     auto digest = eip712.hash("Order", orderJson);
+//
+// Each struct type's encodeType() string, typeHash and member plan (see AbiPlan.h, with
+// referenced structs as tuples) are computed once, as is the domain separator. For hot paths,
+// hasher<T>() hashes native C++ values (the same types as AbiCodec.h, eg structs with
+// abiFields()) without JSON, and can recover the signers of a batch of signed messages:
+//
+//     auto hasher = eip712.hasher<Order>("Order");
+//     auto signers = hasher.recoverSigners(orders, signatures, pool); // nullopt for bad signatures
+//
+// The Eip712 must outlive its hashers.
+
+
+namespace EthersCpp {
+
+namespace eip712Detail {
+    // Replaces the bytes from start to the end of out with their keccak256 hash
+    static inline void hashTail(std::string &out, size_t start) {
+        Keccak k;
+        k.add(out.data() + start, out.size() - start);
+        uint8_t hash[32];
+        k.getHash(hash);
+        out.resize(start);
+        out.append(reinterpret_cast<const char*>(hash), 32);
+    }
+
+    template<typename T>
+    struct ArrayElem { using type = void; };
+
+    template<typename T>
+    struct ArrayElem<std::vector<T>> { using type = T; };
+
+    template<typename T>
+    struct ArrayElem<std::span<const T>> { using type = T; };
+
+    template<typename T, size_t N> requires (!std::is_same_v<T, uint8_t>)
+    struct ArrayElem<std::array<T, N>> { using type = T; };
+}
+
+
+/// The digest that's signed: keccak256("\x19\x01" || domainSeparator || structHash)
+static inline Bytes32 eip712Digest(const Bytes32 &domainSeparator, const Bytes32 &structHash) {
+    Keccak k;
+    k.add("\x19\x01", 2);
+    k.add(domainSeparator.data(), 32);
+    k.add(structHash.data(), 32);
+
+    Bytes32 output;
+    k.getHash(output.data());
+    return output;
+}
+
+
+template<typename T>
+class Eip712Hasher;
+
+class Eip712 {
+  public:
+    /// types maps struct names to their members ({"Order": [{"name": "maker", "type": "address"}, ...], ...}).
+    /// If it has no EIP712Domain, one is made from the standard fields present in domain.
+    Eip712(const tao::json::value &types, const tao::json::value &domain) {
+        for (auto &[name, members] : types.get_object()) {
+            Type t;
+            t.name = name;
+            for (auto &m : members.get_array()) t.members.emplace_back(m.at("name").get_string(), m.at("type").get_string());
+            _addType(std::move(t));
+        }
+
+        if (!typesByName.contains("EIP712Domain")) {
+            Type t;
+            t.name = "EIP712Domain";
+
+            static const std::pair<const char*, const char*> domainFields[] = {
+                { "name", "string" }, { "version", "string" }, { "chainId", "uint256" }, { "verifyingContract", "address" }, { "salt", "bytes32" },
+            };
+
+            for (auto &[name, type] : domainFields) {
+                if (domain.find(name)) t.members.emplace_back(name, type);
+            }
+
+            _addType(std::move(t));
+        }
+
+        for (auto &t : typeList) {
+            t.encoding = _encodeType(t);
+            t.typeHash = fixedBytesFromRaw<32>(keccak256(t.encoding));
+        }
+
+        for (size_t i = 0; i < typeList.size(); i++) _compile(i);
+
+        domainSep = hashStruct("EIP712Domain", domain);
+    }
+
+    const Bytes32 &domainSeparator() const { return domainSep; }
+
+    /// eg "Mail(Person from,Person to,string contents)Person(string name,address wallet)"
+    const std::string &encodeType(std::string_view typeName) const { return _getType(typeName).encoding; }
+
+    const Bytes32 &typeHash(std::string_view typeName) const { return _getType(typeName).typeHash; }
+
+    /// Integers can be JSON numbers or decimal strings, and bytes values are hex
+    Bytes32 hashStruct(std::string_view typeName, const tao::json::value &value) const {
+        auto &t = _getType(typeName);
+        std::string buffer;
+        _encodeJson(t, t.plan.root(), value, buffer);
+        return fixedBytesFromRaw<32>(buffer);
+    }
+
+    /// The digest to sign or recover from
+    Bytes32 hash(std::string_view typeName, const tao::json::value &value) const {
+        return eip712Digest(domainSep, hashStruct(typeName, value));
+    }
+
+    /// T is checked against the type's members once, here
+    template<typename T>
+    Eip712Hasher<T> hasher(std::string_view typeName) const {
+        auto &t = _getType(typeName);
+        return Eip712Hasher<T>(t.plan, t.tupleTypeHashes, domainSep);
+    }
+
+  private:
+    struct Type {
+        std::string name;
+        std::vector<std::pair<std::string, std::string>> members; // name, type
+        std::string encoding;
+        Bytes32 typeHash;
+        AbiPlan plan; // members, with referenced structs as tuples
+        std::vector<Bytes32> tupleTypeHashes; // by plan node index, for the plan's tuples
+    };
+
+    std::vector<Type> typeList;
+    AbiNameMap<size_t> typesByName;
+    Bytes32 domainSep;
+
+    static std::string_view _baseType(std::string_view type) {
+        return type.substr(0, type.find('['));
+    }
+
+    void _addType(Type &&t) {
+        if (!typesByName.emplace(t.name, typeList.size()).second) throw hoytech::error("duplicate EIP-712 type: ", t.name);
+        typeList.push_back(std::move(t));
+    }
+
+    const Type *_findType(std::string_view name) const {
+        auto it = typesByName.find(name);
+        return it == typesByName.end() ? nullptr : &typeList[it->second];
+    }
+
+    const Type &_getType(std::string_view name) const {
+        auto *t = _findType(name);
+        if (!t) throw hoytech::error("unknown EIP-712 type: ", name);
+        return *t;
+    }
+
+    void _collectDeps(const Type &t, std::set<std::string> &deps) const {
+        for (auto &[name, type] : t.members) {
+            auto *dep = _findType(_baseType(type));
+            if (dep && deps.insert(dep->name).second) _collectDeps(*dep, deps);
+        }
+    }
+
+    // The type itself, then the structs it references (directly or not) in alphabetical order
+    std::string _encodeType(const Type &t) const {
+        std::set<std::string> deps;
+        _collectDeps(t, deps);
+        deps.erase(t.name);
+
+        std::string output;
+
+        auto append = [&](const Type &s){
+            output += s.name;
+            output += "(";
+            for (size_t i = 0; i < s.members.size(); i++) {
+                if (i) output += ",";
+                output += s.members[i].second;
+                output += " ";
+                output += s.members[i].first;
+            }
+            output += ")";
+        };
+
+        append(t);
+        for (auto &d : deps) append(_getType(d));
+
+        return output;
+    }
+
+    // Members as JSON ABI parameters, with struct references expanded into tuples
+    tao::json::value _abiParams(const Type &t, std::vector<const Type*> &stack) const {
+        for (auto *s : stack) {
+            if (s == &t) throw hoytech::error("recursive EIP-712 types are not supported: ", t.name);
+        }
+        stack.push_back(&t);
+
+        tao::json::value output = tao::json::empty_array;
+
+        for (auto &[name, type] : t.members) {
+            tao::json::value param = { { "name", name } };
+
+            if (auto *s = _findType(_baseType(type))) {
+                param["type"] = "tuple" + type.substr(_baseType(type).size());
+                param["components"] = _abiParams(*s, stack);
+            } else {
+                param["type"] = type;
+            }
+
+            output.get_array().push_back(std::move(param));
+        }
+
+        stack.pop_back();
+        return output;
+    }
+
+    void _compile(size_t i) {
+        auto &t = typeList[i];
+
+        std::vector<const Type*> stack;
+        auto params = _abiParams(t, stack);
+        t.plan = AbiPlan(params.get_array());
+
+        for (auto &node : t.plan.allNodes()) {
+            if (node.kind == AbiKind::Unknown) throw hoytech::error("unsupported EIP-712 type: ", t.plan.type(node));
+        }
+
+        t.tupleTypeHashes.resize(t.plan.allNodes().size());
+        _assignTypeHashes(t, t.plan.root(), t);
+    }
+
+    void _assignTypeHashes(Type &t, const AbiNode &tuple, const Type &s) {
+        t.tupleTypeHashes[&tuple - t.plan.allNodes().data()] = s.typeHash;
+
+        for (size_t i = 0; i < s.members.size(); i++) {
+            auto *member = _findType(_baseType(s.members[i].second));
+            if (!member) continue;
+
+            auto *node = &t.plan.child(tuple, i);
+            while (node->kind == AbiKind::DynamicArray || node->kind == AbiKind::StaticArray) node = &t.plan.child(*node, 0);
+            _assignTypeHashes(t, *node, *member);
+        }
+    }
+
+    // Appends the 32-byte encodeData() word for item
+    void _encodeJson(const Type &t, const AbiNode &node, const tao::json::value &item, std::string &out) const {
+        auto &plan = t.plan;
+        size_t start = out.size();
+
+        switch (node.kind) {
+            case AbiKind::Tuple:
+                out += asStringView(t.tupleTypeHashes[&node - plan.allNodes().data()]);
+                for (size_t i = 0; i < node.numChildren; i++) {
+                    auto &member = plan.child(node, i);
+                    _encodeJson(t, member, abiJsonMember(plan, member, item), out);
+                }
+                break;
+
+            case AbiKind::DynamicArray:
+            case AbiKind::StaticArray: {
+                auto &arr = item.get_array();
+                if (node.kind == AbiKind::StaticArray && arr.size() != node.arraySize) throw hoytech::error("wrong number of elements for ", plan.type(node), ": ", arr.size());
+                for (auto &e : arr) _encodeJson(t, plan.child(node, 0), e, out);
+                break;
+            }
+
+            case AbiKind::String:
+                out += item.get_string();
+                break;
+
+            case AbiKind::Bytes: {
+                std::string_view hex = item.get_string();
+                if (hex.starts_with("0x")) hex = hex.substr(2);
+                out.resize(start + hex.size() / 2);
+                if (!hexDecode(hex, out.data() + start)) throw hoytech::error("invalid hex string");
+                break;
+            }
+
+            default:
+                out.append(32, '\0');
+                abiWordFromJson(plan, node, item, out.data() + start);
+                return;
+        }
+
+        eip712Detail::hashTail(out, start);
+    }
+};
+
+
+/// Hashes T values (see AbiCodec.h) as one EIP-712 struct type. Create with Eip712::hasher().
+template<typename T>
+class Eip712Hasher {
+  public:
+    static_assert(abiCodecDetail::IsTuple<T>::value || AbiStruct<T>, "EIP-712 hashing needs a tuple or struct");
+
+    Eip712Hasher(const AbiPlan &plan, std::span<const Bytes32> tupleTypeHashes, const Bytes32 &domainSeparator)
+        : plan(&plan), tupleTypeHashes(tupleTypeHashes), domainSeparator(domainSeparator) {
+        AbiCodec<T>::check(plan, plan.root());
+    }
+
+    /// scratch is reused between calls to avoid allocating
+    Bytes32 hashStruct(const T &v, std::string &scratch) const {
+        scratch.clear();
+        encode(plan->root(), v, scratch);
+        return fixedBytesFromRaw<32>(scratch);
+    }
+
+    Bytes32 hashStruct(const T &v) const {
+        std::string scratch;
+        return hashStruct(v, scratch);
+    }
+
+    /// The digest to sign or recover from
+    Bytes32 hash(const T &v, std::string &scratch) const {
+        return eip712Digest(domainSeparator, hashStruct(v, scratch));
+    }
+
+    Bytes32 hash(const T &v) const {
+        std::string scratch;
+        return hash(v, scratch);
+    }
+
+    /// See recoverAddress() (ecrecover.h) for the signature formats
+    std::optional<Address> recoverSigner(const T &v, std::string_view signature) const {
+        return recoverAddress(asStringView(hash(v)), signature);
+    }
+
+    /// Hashes each message and recovers the signer of the matching signature, on pool's threads.
+    /// Signatures that are malformed or don't recover give nullopt.
+    std::vector<std::optional<Address>> recoverSigners(std::span<const T> messages, std::span<const std::string_view> signatures, ThreadPool &pool) const {
+        if (messages.size() != signatures.size()) throw hoytech::error("need one signature per message");
+
+        std::vector<std::optional<Address>> output(messages.size());
+
+        pool.parallelFor(messages.size(), [&](size_t i){
+            thread_local std::string scratch;
+            Address signer;
+            if (ecrecoverDetail::recoverSignature(ecrecoverDetail::threadContext(), hash(messages[i], scratch).data(), signatures[i], signer.data())) output[i] = signer;
+        }, 16);
+
+        return output;
+    }
+
+    /// numThreads of 0 means one per hardware thread
+    std::vector<std::optional<Address>> recoverSigners(std::span<const T> messages, std::span<const std::string_view> signatures, size_t numThreads = 0) const {
+        ThreadPool pool(numThreads);
+        return recoverSigners(messages, signatures, pool);
+    }
+
+  private:
+    const AbiPlan *plan;
+    std::span<const Bytes32> tupleTypeHashes;
+    Bytes32 domainSeparator;
+
+    // Appends the 32-byte encodeData() word for v
+    template<typename F>
+    void encode(const AbiNode &node, const F &v, std::string &out) const {
+        size_t start = out.size();
+
+        if constexpr (abiCodecDetail::IsTuple<F>::value || AbiStruct<F>) {
+            out += asStringView(tupleTypeHashes[&node - plan->allNodes().data()]);
+            AbiCodec<F>::forEachField(v, [&]<typename G>(size_t i, const G &field){
+                encode(plan->child(node, i), field, out);
+            });
+        } else if constexpr (std::is_same_v<F, std::string> || std::is_same_v<F, std::string_view> || std::is_same_v<F, const char*>) {
+            out += std::string_view(v);
+        } else if constexpr (!std::is_void_v<typename eip712Detail::ArrayElem<F>::type>) {
+            using E = typename eip712Detail::ArrayElem<F>::type;
+            if (node.kind == AbiKind::StaticArray && std::size(v) != node.arraySize) throw hoytech::error("wrong number of elements for ", plan->type(node), ": ", std::size(v));
+            for (auto &&e : v) encode<E>(plan->child(node, 0), e, out);
+        } else {
+            out.append(32, '\0');
+            AbiCodec<F>::encode(*plan, node, v, out, start, start);
+            return;
+        }
+
+        eip712Detail::hashTail(out, start);
+    }
+};
+
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <unordered_set>
+#include <type_traits>
+#include <algorithm>
+#include <cstring>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/uint256.h"
+#include "ethers-cpp/AbiPlan.h"
+
+
+// Selects logs of one event by comparing raw 32-byte words, before anything is decoded. Each
+// condition names an event parameter, and is compiled to the topic or data word it reads:
+//
+//     auto filter = abi.logFilter("Transfer").in("to", watched).greaterEq("value", uint256(1000));
+//     for (auto &log : logs) if (filter.matches(log)) ...
+//
+// Conditions are ANDed. matches() doesn't allocate. Only parameters that occupy a single word
+// (indexed parameters, and static non-indexed value types) can be filtered on.
+
+
+namespace EthersCpp {
+
+/// A log as returned by eth_getLogs. Doesn't own its topics or data.
+struct RawLog {
+    Address address;
+    std::span<const Bytes32> topics; // topics[0] is the event's signature hash
+    std::string_view data;
+};
+
+static_assert(sizeof(Bytes32) == 32, "topics must be contiguous");
+
+
+class LogFilter {
+  public:
+    using AddressSet = std::unordered_set<Address, FixedBytesHash>;
+    using Bytes32Set = std::unordered_set<Bytes32, FixedBytesHash>;
+
+    /// The plans must outlive any calls that add conditions
+    LogFilter(const AbiPlan &indexed, const AbiPlan &nonIndexed, const Bytes32 &topic0)
+        : indexed(&indexed), nonIndexed(&nonIndexed), topic0(topic0), numIndexed(indexed.root().numChildren) {}
+
+    template<typename V> LogFilter &equals(std::string_view name, const V &v) { return add(name, Op::Eq, v); }
+    template<typename V> LogFilter &notEquals(std::string_view name, const V &v) { return add(name, Op::Ne, v); }
+    template<typename V> LogFilter &less(std::string_view name, const V &v) { return add(name, Op::Lt, v); }
+    template<typename V> LogFilter &lessEq(std::string_view name, const V &v) { return add(name, Op::Le, v); }
+    template<typename V> LogFilter &greater(std::string_view name, const V &v) { return add(name, Op::Gt, v); }
+    template<typename V> LogFilter &greaterEq(std::string_view name, const V &v) { return add(name, Op::Ge, v); }
+
+    /// Membership in a set owned by the caller, which must outlive the filter
+    LogFilter &in(std::string_view name, const AddressSet &set) {
+        auto &c = addCondition(name);
+        if (c.node->kind != AbiKind::Address) throw hoytech::error("address set used with ", typeOf(c), " parameter: ", name);
+        c.op = Op::InAddressSet;
+        c.addressSet = &set;
+        return *this;
+    }
+
+    LogFilter &in(std::string_view name, const Bytes32Set &set) {
+        auto &c = addCondition(name);
+        c.op = Op::InBytes32Set;
+        c.bytes32Set = &set;
+        return *this;
+    }
+
+    /// topics is the concatenation of the log's topics, starting with topic0
+    bool matches(std::string_view topics, std::string_view data) const {
+        if (topics.size() != (1 + numIndexed) * 32 || memcmp(topics.data(), topic0.data(), 32) != 0) return false;
+        if (data.size() < minDataSize) return false;
+
+        for (const auto &c : conditions) {
+            auto *word = reinterpret_cast<const uint8_t*>(c.indexed ? topics.data() + c.offset : data.data() + c.offset);
+            if (!test(c, word)) return false;
+        }
+
+        return true;
+    }
+
+    bool matches(const RawLog &log) const {
+        return matches(std::string_view(reinterpret_cast<const char*>(log.topics.data()), log.topics.size() * 32), log.data);
+    }
+
+  private:
+    enum class Op : uint8_t { Eq, Ne, Lt, Le, Gt, Ge, InAddressSet, InBytes32Set };
+
+    struct Condition {
+        bool indexed;
+        Op op = Op::Eq;
+        bool isSigned = false;
+        uint32_t offset; // into the concatenated topics, or into data
+        const AbiNode *node = nullptr; // only used while building
+        Bytes32 operand{};
+        const AddressSet *addressSet = nullptr;
+        const Bytes32Set *bytes32Set = nullptr;
+    };
+
+    const AbiPlan *indexed;
+    const AbiPlan *nonIndexed;
+    Bytes32 topic0;
+    size_t numIndexed;
+    size_t minDataSize = 0;
+    std::vector<Condition> conditions;
+
+    std::string_view typeOf(const Condition &c) const {
+        return (c.indexed ? indexed : nonIndexed)->type(*c.node);
+    }
+
+    Condition &addCondition(std::string_view name) {
+        Condition c;
+
+        if (auto *node = findParam(*indexed, name)) {
+            c.indexed = true;
+            c.node = node;
+            c.offset = 32 * (1 + (node - &indexed->child(indexed->root(), 0)));
+        } else if (auto *node = findParam(*nonIndexed, name)) {
+            if (node->dynamic || node->headSize != 32) throw hoytech::error("can't filter on non-indexed parameter of type ", nonIndexed->type(*node), ": ", name);
+            c.indexed = false;
+            c.node = node;
+            c.offset = node->headOffset;
+            minDataSize = std::max(minDataSize, size_t(c.offset) + 32);
+        } else {
+            throw hoytech::error("no such event parameter: ", name);
+        }
+
+        c.isSigned = c.node->kind == AbiKind::Int;
+        return conditions.emplace_back(c);
+    }
+
+    static const AbiNode *findParam(const AbiPlan &plan, std::string_view name) {
+        auto &root = plan.root();
+        for (size_t i = 0; i < root.numChildren; i++) {
+            auto &child = plan.child(root, i);
+            if (plan.name(child) == name) return &child;
+        }
+        return nullptr;
+    }
+
+    template<typename V>
+    LogFilter &add(std::string_view name, Op op, const V &v) {
+        auto &c = addCondition(name);
+        c.op = op;
+        c.operand = toWord(c, v);
+
+        if (op != Op::Eq && op != Op::Ne && c.node->kind != AbiKind::Uint && c.node->kind != AbiKind::Int) {
+            throw hoytech::error("ordering comparison on ", typeOf(c), " parameter: ", name);
+        }
+
+        return *this;
+    }
+
+    // Operands are converted to the word the parameter would be encoded as
+
+    Bytes32 toWord(const Condition &c, const uint256 &v) const { return integerWord(c, v, false); }
+    Bytes32 toWord(const Condition &c, const int256 &v) const { return integerWord(c, v.bits, true); }
+
+    template<typename T> requires (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    Bytes32 toWord(const Condition &c, T v) const {
+        if constexpr (std::is_signed_v<T>) return toWord(c, int256(static_cast<int64_t>(v)));
+        else return toWord(c, uint256(static_cast<uint64_t>(v)));
+    }
+
+    // bits is two's complement when isSigned
+    Bytes32 integerWord(const Condition &c, const uint256 &bits, bool isSigned) const {
+        if (c.node->kind != AbiKind::Uint && c.node->kind != AbiKind::Int) throw hoytech::error("integer compared with ", typeOf(c), " parameter");
+        if (bits.bit(255) && (c.node->kind == AbiKind::Int) != isSigned) throw hoytech::error("value out of range for ", typeOf(c));
+        Bytes32 w;
+        bits.toBigEndian(w.data());
+        return w;
+    }
+
+    Bytes32 toWord(const Condition &c, bool v) const {
+        if (c.node->kind != AbiKind::Bool) throw hoytech::error("bool compared with ", typeOf(c), " parameter");
+        Bytes32 w{};
+        w[31] = v;
+        return w;
+    }
+
+    /// Address for address parameters, otherwise bytesN (right-padded). Indexed dynamic
+    /// parameters are topics holding the keccak256 of the value, so compare them with a Bytes32.
+    template<size_t N>
+    Bytes32 toWord(const Condition &c, const FixedBytes<N> &v) const {
+        Bytes32 w{};
+        if (c.node->kind == AbiKind::Address && N == 20) memcpy(w.data() + 12, v.data(), N);
+        else if (c.node->kind == AbiKind::FixedBytes && N == c.node->byteWidth) memcpy(w.data(), v.data(), N);
+        else if (N == 32 && c.indexed) memcpy(w.data(), v.data(), N);
+        else throw hoytech::error(N, "-byte value compared with ", typeOf(c), " parameter");
+        return w;
+    }
+
+    static bool test(const Condition &c, const uint8_t *word) {
+        switch (c.op) {
+            case Op::Eq: return memcmp(word, c.operand.data(), 32) == 0;
+            case Op::Ne: return memcmp(word, c.operand.data(), 32) != 0;
+            case Op::Lt: return compare(c, word) < 0;
+            case Op::Le: return compare(c, word) <= 0;
+            case Op::Gt: return compare(c, word) > 0;
+            case Op::Ge: return compare(c, word) >= 0;
+
+            case Op::InAddressSet: {
+                Address a;
+                memcpy(a.data(), word + 12, 20);
+                return c.addressSet->contains(a);
+            }
+
+            case Op::InBytes32Set: {
+                Bytes32 b;
+                memcpy(b.data(), word, 32);
+                return c.bytes32Set->contains(b);
+            }
+        }
+
+        return false;
+    }
+
+    // Big-endian words compare like unsigned integers. For two's complement, flip the sign bits first.
+    static int compare(const Condition &c, const uint8_t *word) {
+        if (c.isSigned) {
+            uint8_t a = word[0] ^ 0x80, b = c.operand[0] ^ 0x80;
+            if (a != b) return a < b ? -1 : 1;
+            return memcmp(word + 1, c.operand.data() + 1, 31);
+        }
+
+        return memcmp(word, c.operand.data(), 32);
+    }
+};
+
+}
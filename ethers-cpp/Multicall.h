@@ -0,0 +1,212 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <exception>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/SolidityAbi.h"
+
+
+// Batches read-only calls to many contracts, each with its own ABI, into Multicall3
+// aggregate3() calls (https://github.com/mds1/multicall). Every call is made with
+// allowFailure, so a reverting call or a result that doesn't decode only fails that call:
+//
+//     Multicall3 multicall;
+//     auto batch = multicall.prepare(calls);
+//     for (size_t i = 0; i < batch.chunks.size(); i++) {
+//         ... eth_call(multicallAddress, batch.chunks[i].calldata) ...
+//         multicall.decodeChunk(calls, batch, i, returnData);  // or failChunk() if the eth_call failed
+//     }
+//     ... batch.results[i] for calls[i] ...
+//
+// Calls are split into chunks to keep each eth_call within a node's calldata and gas limits.
+// RpcConnection::multicallSync() sends the chunks concurrently.
+
+
+namespace EthersCpp {
+
+class Multicall3 {
+  public:
+    /// Deployed at the same address on most chains
+    static constexpr std::string_view defaultAddress = "0xcA11bde05977b3631167028862bE2a173976CA11";
+
+    struct Call {
+        Address target;
+        const SolidityAbi *abi; // must outlive the batch
+        std::string function;
+        tao::json::value args;
+        uint64_t gas = 50'000; // estimate, only used for chunking
+    };
+
+    struct Result {
+        bool success = false;
+        tao::json::value result; // as from SolidityAbi::decodeFunctionResult()
+        std::string error;
+    };
+
+    struct Limits {
+        size_t maxCalls = 1'000;
+        size_t maxBytes = 256 * 1024; // aggregate3() calldata size
+        uint64_t maxGas = 30'000'000; // sum of the calls' gas estimates
+    };
+
+    struct Chunk {
+        std::vector<size_t> calls; // indices into the calls
+        std::string calldata; // of aggregate3()
+    };
+
+    struct Batch {
+        std::vector<Chunk> chunks;
+        std::vector<Result> results; // one per call. Calls that couldn't be encoded have already failed.
+    };
+
+    /// aggregate3()'s result comes from the node, so it's decoded with the default AbiDecodeLimits
+    Multicall3() : abi(abiJson) {
+        abi.setDecodeLimits(AbiDecodeLimits());
+    }
+
+    Batch prepare(std::span<const Call> calls) const {
+        return prepare(calls, Limits());
+    }
+
+    /// Encodes the calls into chunks. A call bigger than the limits on its own gets its own chunk.
+    Batch prepare(std::span<const Call> calls, const Limits &limits) const {
+        Batch batch;
+        batch.results.resize(calls.size());
+
+        std::vector<std::string> encoded(calls.size());
+        Chunk curr;
+        size_t currBytes = aggregate3Overhead;
+        uint64_t currGas = 0;
+        std::vector<Call3> call3s;
+        auto encoder = abi.functionDataEncoder<std::vector<Call3>>("aggregate3");
+
+        auto flush = [&]{
+            if (curr.calls.empty()) return;
+
+            call3s.clear();
+            for (auto i : curr.calls) call3s.push_back({ calls[i].target, true, encoded[i] });
+            encoder.encode(curr.calldata, call3s);
+
+            batch.chunks.push_back(std::move(curr));
+            curr = Chunk();
+            currBytes = aggregate3Overhead;
+            currGas = 0;
+        };
+
+        for (size_t i = 0; i < calls.size(); i++) {
+            auto &call = calls[i];
+
+            try {
+                if (!call.abi) throw hoytech::error("no ABI");
+                encoded[i] = call.abi->encodeFunctionData(call.function, call.args);
+            } catch (std::exception &e) {
+                batch.results[i].error = std::string("encoding failed: ") + e.what();
+                continue;
+            }
+
+            // The Call3 tuple: its pointer, target, allowFailure, callData pointer, length and padded data
+            size_t bytes = 5 * 32 + (encoded[i].size() + 31) / 32 * 32;
+
+            if (curr.calls.size() && (curr.calls.size() + 1 > limits.maxCalls || currBytes + bytes > limits.maxBytes || currGas + call.gas > limits.maxGas)) flush();
+
+            curr.calls.push_back(i);
+            currBytes += bytes;
+            currGas += call.gas;
+        }
+
+        flush();
+
+        return batch;
+    }
+
+    /// Decodes the return data of a chunk's eth_call into its calls' results
+    void decodeChunk(std::span<const Call> calls, Batch &batch, size_t chunkIndex, std::string_view returnData) const {
+        auto &chunk = batch.chunks.at(chunkIndex);
+        std::vector<Result3> results;
+
+        try {
+            results = abi.functionResultDecoder<std::vector<Result3>>("aggregate3")(returnData);
+        } catch (std::exception &e) {
+            failChunk(batch, chunkIndex, std::string("bad aggregate3 result: ") + e.what());
+            return;
+        }
+
+        if (results.size() != chunk.calls.size()) {
+            failChunk(batch, chunkIndex, "bad aggregate3 result: wrong number of results");
+            return;
+        }
+
+        for (size_t j = 0; j < results.size(); j++) {
+            auto &call = calls[chunk.calls[j]];
+            auto &output = batch.results[chunk.calls[j]];
+
+            if (!results[j].success) {
+                output = { false, tao::json::null, revertReason(results[j].returnData) };
+                continue;
+            }
+
+            try {
+                output = { true, call.abi->decodeFunctionResult(call.function, results[j].returnData), "" };
+            } catch (std::exception &e) {
+                output = { false, tao::json::null, std::string("decoding failed: ") + e.what() };
+            }
+        }
+    }
+
+    /// Fails all of a chunk's calls, eg when its eth_call failed
+    void failChunk(Batch &batch, size_t chunkIndex, std::string_view error) const {
+        for (auto i : batch.chunks.at(chunkIndex).calls) batch.results[i] = { false, tao::json::null, std::string(error) };
+    }
+
+    /// Error(string) reasons and Panic(uint256) codes, otherwise the raw revert data
+    std::string revertReason(std::string_view returnData) const {
+        if (returnData.size() >= 4) {
+            try {
+                auto decoded = abi.decodeFunctionData(returnData);
+                auto &name = decoded.at("name").get_string();
+                if (name == "Error") return "reverted: " + decoded.at("args").at("reason").get_string();
+                if (name == "Panic") return "panic: " + decoded.at("args").at("code").get_string();
+            } catch (std::exception &) {}
+        }
+
+        return returnData.empty() ? "reverted" : "reverted: " + toHex(returnData, true);
+    }
+
+  private:
+    // aggregate3()'s selector, then its array's offset and length
+    static constexpr size_t aggregate3Overhead = 4 + 2 * 32;
+
+    struct Call3 {
+        Address target;
+        bool allowFailure;
+        std::string_view callData;
+        static constexpr auto abiFields() { return std::make_tuple(&Call3::target, &Call3::allowFailure, &Call3::callData); }
+    };
+
+    struct Result3 {
+        bool success;
+        std::string_view returnData;
+        static constexpr auto abiFields() { return std::make_tuple(&Result3::success, &Result3::returnData); }
+    };
+
+    // Error and Panic aren't functions, but their revert data is laid out like calldata
+    static constexpr std::string_view abiJson = R"([
+        {"type":"function","name":"aggregate3","stateMutability":"payable",
+         "inputs":[{"name":"calls","type":"tuple[]","components":[{"name":"target","type":"address"},{"name":"allowFailure","type":"bool"},{"name":"callData","type":"bytes"}]}],
+         "outputs":[{"name":"returnData","type":"tuple[]","components":[{"name":"success","type":"bool"},{"name":"returnData","type":"bytes"}]}]},
+        {"type":"function","name":"Error","inputs":[{"name":"reason","type":"string"}],"outputs":[]},
+        {"type":"function","name":"Panic","inputs":[{"name":"code","type":"uint256"}],"outputs":[]}
+    ])";
+
+    SolidityAbi abi;
+};
+
+}
@@ -13,6 +13,7 @@
 #include <tao/json.hpp>
 
 #include "ethers-cpp/SolidityAbi.h"
+#include "ethers-cpp/Multicall.h"
 
 
 namespace EthersCpp {
@@ -144,14 +145,92 @@ class RpcConnection {
         auto r = sendSync("eth_call", tao::json::value::array({
             {
                 { "to", to },
-                { "data", hoytech::to_hex(encodedData, true) },
+                { "data", toHex(encodedData, true) },
             },
             "latest"
         }));
 
         if (r.is_object()) return r;
 
-        return { { "result", abi.decodeFunctionResult(func, hoytech::from_hex(r.get_string())) } };
+        return { { "result", abi.decodeFunctionResult(func, fromHex(r.get_string())) } };
+    }
+
+    /// Makes the calls through Multicall3 (see Multicall.h), sending the chunks concurrently.
+    /// Returns one result per call: a call fails on its own if it reverts or its result doesn't
+    /// decode, and all the calls in a chunk fail if that chunk's eth_call does. block is a tag or
+    /// 0x-prefixed number, as for eth_call. "latest" is resolved to a number first when there
+    /// are several chunks, so that every chunk reads the same state.
+    std::vector<Multicall3::Result> multicallSync(std::span<const Multicall3::Call> calls, const tao::json::value &block = "latest",
+                                                  const Multicall3::Limits &limits = Multicall3::Limits(),
+                                                  const std::string &multicallAddress = std::string(Multicall3::defaultAddress)) {
+        Multicall3 multicall;
+        auto batch = multicall.prepare(calls, limits);
+
+        tao::json::value blockParam = block;
+
+        if (batch.chunks.size() > 1 && block.is_string() && block.get_string() == "latest") {
+            auto r = sendSync("eth_blockNumber", tao::json::empty_array);
+
+            if (!r.is_string()) {
+                for (size_t i = 0; i < batch.chunks.size(); i++) multicall.failChunk(batch, i, "eth_blockNumber failed: " + tao::json::to_string(r));
+                return std::move(batch.results);
+            }
+
+            blockParam = r;
+        }
+
+        std::mutex m;
+        std::condition_variable cv;
+        size_t pending = batch.chunks.size();
+        std::vector<tao::json::value> responses(pending);
+        std::vector<bool> ok(pending);
+
+        for (size_t i = 0; i < batch.chunks.size(); i++) {
+            auto done = [&, i](const tao::json::value &r, bool success){
+                std::lock_guard<std::mutex> lock(m);
+                responses[i] = r;
+                ok[i] = success;
+                if (--pending == 0) cv.notify_one();
+            };
+
+            send(RpcQueryMsg{
+                "eth_call",
+                tao::json::value::array({
+                    {
+                        { "to", multicallAddress },
+                        { "data", toHex(batch.chunks[i].calldata, true) },
+                    },
+                    blockParam
+                }),
+                [done](const tao::json::value &r){ done(r, true); },
+                [done](const tao::json::value &r){ done(r, false); }
+            });
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&]{ return pending == 0; });
+        }
+
+        for (size_t i = 0; i < batch.chunks.size(); i++) {
+            if (!ok[i] || !responses[i].is_string()) {
+                multicall.failChunk(batch, i, "eth_call failed: " + tao::json::to_string(responses[i]));
+                continue;
+            }
+
+            std::string returnData;
+
+            try {
+                returnData = fromHex(responses[i].get_string());
+            } catch (std::exception &e) {
+                multicall.failChunk(batch, i, std::string("bad eth_call result: ") + e.what());
+                continue;
+            }
+
+            multicall.decodeChunk(calls, batch, i, returnData);
+        }
+
+        return std::move(batch.results);
     }
 
     void trigger() {
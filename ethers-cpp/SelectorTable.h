@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+
+// Flat open-addressing hash tables, for the lookups done once per transaction or log. Keys are
+// selectors, hashes and addresses, which are already uniformly distributed, so Hash only has to
+// pick out some of their bits: the low bits index the table directly, and lookups are a few
+// sequential probes in one contiguous array.
+//
+// SelectorTable is keyed by 4-byte function selectors. Get them with selectorOf() (see
+// keccakConstexpr.h).
+
+
+namespace EthersCpp {
+
+template<typename K, typename V, typename Hash>
+class FlatTable {
+  public:
+    /// Returns false (leaving the existing value) if key is already present
+    bool insert(const K &key, const V &value) {
+        if ((numUsed + 1) * 2 > slots.size()) grow();
+        return insertSlot(key, value);
+    }
+
+    const V *find(const K &key) const {
+        if (slots.empty()) return nullptr;
+
+        size_t mask = slots.size() - 1;
+
+        for (size_t i = Hash{}(key) & mask; ; i = (i + 1) & mask) {
+            auto &slot = slots[i];
+            if (!slot.used) return nullptr;
+            if (slot.key == key) return &slot.value;
+        }
+    }
+
+    size_t size() const { return numUsed; }
+
+  private:
+    struct Slot {
+        K key{};
+        bool used = false;
+        V value{};
+    };
+
+    std::vector<Slot> slots; // power of 2 size, at most half full
+    size_t numUsed = 0;
+
+    bool insertSlot(const K &key, const V &value) {
+        size_t mask = slots.size() - 1;
+
+        for (size_t i = Hash{}(key) & mask; ; i = (i + 1) & mask) {
+            auto &slot = slots[i];
+
+            if (!slot.used) {
+                slot = { key, true, value };
+                numUsed++;
+                return true;
+            }
+
+            if (slot.key == key) return false;
+        }
+    }
+
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(old.empty() ? 16 : old.size() * 2);
+        numUsed = 0;
+
+        for (auto &slot : old) {
+            if (slot.used) insertSlot(slot.key, slot.value);
+        }
+    }
+};
+
+
+struct SelectorHash {
+    size_t operator()(uint32_t selector) const { return selector; }
+};
+
+template<typename V>
+using SelectorTable = FlatTable<uint32_t, V, SelectorHash>;
+
+}
@@ -4,16 +4,30 @@
 #include <string>
 #include <string_view>
 #include <vector>
-#include <queue>
+#include <functional>
+#include <cstring>
 #include <memory>
-
-#include <gmpxx.h>
+#include <optional>
+#include <span>
+#include <memory_resource>
 
 #include <tao/json.hpp>
 #include "hoytech/error.h"
-#include "hoytech/hex.h"
 
 #include "ethers-cpp/keccak.h"
+#include "ethers-cpp/keccakConstexpr.h"
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/parallel.h"
+#include "ethers-cpp/uint256.h"
+#include "ethers-cpp/AbiPlan.h"
+#include "ethers-cpp/AbiCodec.h"
+#include "ethers-cpp/AbiVisitor.h"
+#include "ethers-cpp/AbiView.h"
+#include "ethers-cpp/AbiArena.h"
+#include "ethers-cpp/LogFilter.h"
+#include "ethers-cpp/SelectorTable.h"
+#include "ethers-cpp/AbiFile.h"
 
 
 namespace EthersCpp {
@@ -26,100 +40,302 @@ static inline std::string normaliseStr(std::string_view str, size_t numBytes = 3
     return std::string(numBytes - str.length(), '\0') + std::string(str);
 }
 
-static std::string normaliseHexStr(std::string_view hexStr, size_t numBytes = 32) {
+static inline std::string normaliseHexStr(std::string_view hexStr, size_t numBytes = 32) {
     std::string str(hexStr);
     if (str.substr(0, 2) == "0x") str = str.substr(2);
     str.replace(0, 0, std::string(numBytes*2 - str.length(), '0'));
-    return hoytech::from_hex(str);
+    return fromHex(str);
 }
 
-static std::string normaliseMpz(mpz_class &num, size_t numBytes = 32) {
-    auto str = num.get_str(16);
-    if (str.length() > numBytes*2) throw hoytech::error("input exceeds numBytes");
-    return normaliseHexStr(str, numBytes);
+static inline std::string normaliseUnsigned(uint64_t num, size_t numBytes = 32) {
+    return uint256(num).toBytes(numBytes);
 }
 
-static std::string normaliseUnsigned(uint64_t num, size_t numBytes = 32) {
-    mpz_class numMpz{num};
-    return normaliseMpz(numMpz, numBytes);
+static inline std::string normaliseSigned(int64_t num, size_t numBytes = 32) {
+    return int256(num).bits.toBytes(numBytes);
 }
 
-static mpz_class twoToThe256 = mpz_class("115792089237316195423570985008687907853269984665640564039457584007913129639936");
 
-static std::string normaliseSignedMpz(mpz_class &numMpz, size_t numBytes = 32) {
-    if (numMpz < 0) numMpz += twoToThe256;
 
-    return normaliseMpz(numMpz, numBytes);
-}
+class SolidityAbi {
+  public:
+    SolidityAbi(std::string_view abi) {
+        auto json = tao::json::from_string(abi);
+        _init(json);
+    }
+
+    SolidityAbi(tao::json::value &abi) {
+        _init(abi);
+    }
 
-static std::string normaliseSigned(int64_t num, size_t numBytes = 32) {
-    mpz_class numMpz{num};
+    /// From a binary ABI written by toBinary(). The plans are used in place, and the file is kept
+    /// mapped for as long as this SolidityAbi (or a copy of it) exists.
+    SolidityAbi(std::shared_ptr<const AbiFile> abiFile) : file(std::move(abiFile)) {
+        for (auto &rec : file->functions()) {
+            Function f;
 
-    if (numMpz < 0) numMpz += twoToThe256;
+            f.name = file->string(rec.name);
+            f.signature = file->string(rec.signature);
+            f.sigHash = { char(rec.selector >> 24), char(rec.selector >> 16), char(rec.selector >> 8), char(rec.selector) };
+            f.inputs = file->plan(rec.inputs);
+            f.outputs = file->plan(rec.outputs);
 
-    return normaliseMpz(numMpz, numBytes);
-}
+            _addFunction(std::move(f));
+        }
 
-static mpz_class convertToMpz(std::string_view str) {
-    if (str.size() == 0) return mpz_class(0);
-    std::string s = hoytech::to_hex(str);
-    return mpz_class{s, 16};
-}
+        for (auto &rec : file->events()) {
+            Event e;
 
-static mpz_class convertToMpzSigned(std::string_view str) {
-    auto num = convertToMpz(str);
+            e.name = file->string(rec.name);
+            e.signature = file->string(rec.signature);
+            auto isIndexed = file->string(rec.isIndexed);
+            e.isIndexed.assign(isIndexed.begin(), isIndexed.end());
+            e.indexedItems = file->plan(rec.indexedItems);
+            e.nonIndexedItems = file->plan(rec.nonIndexedItems);
 
-    if (mpz_tstbit(num.get_mpz_t(), 255)) {
-        return -(twoToThe256 - num);
+            Bytes32 topic0;
+            memcpy(topic0.data(), rec.topic0, 32);
+            _addEvent(topic0, std::move(e));
+        }
     }
 
-    return num;
-}
+    /// Serialises the processed ABI, to be loaded with AbiFile::open() instead of re-parsing the JSON
+    std::string toBinary() const {
+        AbiFileWriter writer;
 
+        for (auto &f : functions) writer.addFunction(f.name, f.signature, selectorOf(f.sigHash), f.inputs, f.outputs);
+        for (auto &[topic0, e] : events) writer.addEvent(e.name, e.signature, topic0, e.isIndexed, e.indexedItems, e.nonIndexedItems);
 
+        return writer.finish();
+    }
 
-class SolidityAbi {
-  public:
-    SolidityAbi(std::string_view abi) {
-        auto json = tao::json::from_string(abi);
-        _init(json);
+    /// Decode untrusted data with these limits (see AbiDecodeLimits) from now on, or without any
+    /// if nullopt. Applies to every decoder. Typed decoders and views keep the limits that were
+    /// set when they were created.
+    void setDecodeLimits(std::optional<AbiDecodeLimits> limits) {
+        decodeLimits = limits;
     }
 
-    SolidityAbi(tao::json::value &abi) {
-        _init(abi);
+    std::string encodeFunctionData(std::string_view funcName, const tao::json::value &input) const {
+        std::string output;
+        encodeFunctionData(funcName, input, output);
+        return output;
     }
 
-    std::string encodeFunctionData(std::string_view funcName, const tao::json::value &input) {
-        auto it = functions.find(std::string(funcName));
-        if (it == functions.end()) throw hoytech::error("unable to encode unknown solidity abi function: ", funcName);
-        auto &function = it->second;
+    /// Appends to out, which can be reused between calls to avoid allocating
+    void encodeFunctionData(std::string_view funcName, const tao::json::value &input, std::string &out) const {
+        auto *function = _findFunction(funcName);
+        if (!function) throw hoytech::error("unable to encode unknown solidity abi function: ", funcName);
 
-        return function.sigHash + _abiEncode(function.item.at("inputs").get_array(), input);
+        out += function->sigHash;
+        _abiEncode(function->inputs, input, out);
     }
 
-    tao::json::value decodeFunctionResult(std::string_view funcName, std::string_view result) {
-        auto it = functions.find(std::string(funcName));
-        if (it == functions.end()) throw hoytech::error("unable to decode unknown solidity abi function: ", funcName);
-        auto &function = it->second;
+    tao::json::value decodeFunctionResult(std::string_view funcName, std::string_view result) const {
+        auto *function = _findFunction(funcName);
+        if (!function) throw hoytech::error("unable to decode unknown solidity abi function: ", funcName);
 
-        return _abiDecode(function.item.at("outputs").get_array(), result);
+        return _abiDecode(function->outputs, result);
     }
 
-    tao::json::value decodeEvent(std::string_view topics, std::string_view data) {
-        auto it = events.find(std::string(topics.substr(0, 32)));
-        if (it == events.end()) throw hoytech::error("unable to decode solidity abi event");
-        auto &event = it->second;
+    /// Decodes a transaction's input to {name, signature, args}, dispatching on its 4-byte selector
+    tao::json::value decodeFunctionData(std::string_view calldata) const {
+        auto *function = _findFunctionBySelector(calldata);
+        if (!function) throw hoytech::error("unable to decode calldata for unknown solidity abi function");
 
-        tao::json::value output = _abiDecode(event.indexedItems, topics.substr(32));
-        tao::json::value output2 = _abiDecode(event.nonIndexedItems, data);
+        return _decodeFunctionData(*function, calldata);
+    }
 
-        for (auto &pair : output2.get_object()) output[pair.first] = pair.second;
+    /// Decodes a batch of calldata (eg the inputs of a block's transactions) on pool's threads, in
+    /// the same order. Calldata whose selector isn't a function in this ABI (or that is shorter than
+    /// a selector, such as plain ether transfers) gives null, while calldata that matches a function
+    /// but fails to decode throws.
+    std::vector<tao::json::value> decodeFunctionDataBatch(std::span<const std::string_view> calldatas, ThreadPool &pool) const {
+        std::vector<tao::json::value> output(calldatas.size());
 
-        return { { "name", event.name }, { "args", output } };
+        pool.parallelFor(calldatas.size(), [&](size_t i){
+            auto *function = _findFunctionBySelector(calldatas[i]);
+            if (function) output[i] = _decodeFunctionData(*function, calldatas[i]);
+        }, 64);
+
+        return output;
+    }
+
+    /// numThreads of 0 means one per hardware thread
+    std::vector<tao::json::value> decodeFunctionDataBatch(std::span<const std::string_view> calldatas, size_t numThreads = 0) const {
+        ThreadPool pool(numThreads);
+        return decodeFunctionDataBatch(calldatas, pool);
+    }
+
+    tao::json::value decodeEvent(std::string_view topics, std::string_view data) const {
+        auto *event = _findEvent(topics);
+        if (!event) throw hoytech::error("unable to decode solidity abi event");
+
+        return _decodeEvent(*event, topics.substr(32), data);
+    }
+
+    /// Decodes a batch of logs on pool's threads. The output is in the same order as logs, with
+    /// {name, args, address} for each log. Logs whose topic0 isn't an event in this ABI (or that
+    /// have no topics) give null, while logs that match an event but fail to decode throw.
+    std::vector<tao::json::value> decodeLogs(std::span<const RawLog> logs, ThreadPool &pool) const {
+        std::vector<tao::json::value> output(logs.size());
+
+        pool.parallelFor(logs.size(), [&](size_t i){
+            auto &log = logs[i];
+            std::string_view topics(reinterpret_cast<const char*>(log.topics.data()), log.topics.size() * 32);
+
+            auto *event = _findEvent(topics);
+            if (!event) return;
+
+            output[i] = _decodeEvent(*event, topics.substr(32), log.data);
+            output[i]["address"] = toHex(log.address, true);
+        }, 64);
+
+        return output;
+    }
+
+    /// numThreads of 0 means one per hardware thread
+    std::vector<tao::json::value> decodeLogs(std::span<const RawLog> logs, size_t numThreads = 0) const {
+        ThreadPool pool(numThreads);
+        return decodeLogs(logs, pool);
+    }
+
+    /// Add conditions to the returned filter, then test logs with matches() before decoding them
+    LogFilter logFilter(std::string_view eventName) const {
+        auto it = eventNameToHash.find(std::string(eventName));
+        if (it == eventNameToHash.end()) throw hoytech::error("unknown solidity abi event: ", eventName);
+        auto &event = events.at(it->second);
+
+        return LogFilter(event.indexedItems, event.nonIndexedItems, it->second);
+    }
+
+    std::string getEventHash(const std::string &eventName) const {
+        return std::string(asStringView(eventNameToHash.at(eventName)));
+    }
+
+
+    // Lazy decoding (see AbiView.h), for reading a few values out of a large result or log
+
+    AbiView functionResultView(std::string_view funcName, std::string_view result) const {
+        return AbiView(_getFunction(funcName).outputs, result, decodeLimits);
+    }
+
+    /// The log's non-indexed items
+    AbiView eventDataView(std::string_view topics, std::string_view data) const {
+        auto *event = _findEvent(topics);
+        if (!event) throw hoytech::error("unable to decode solidity abi event");
+        return AbiView(event->nonIndexedItems, data, decodeLimits);
+    }
+
+
+    // Streaming decoding (see AbiVisitor.h), for results too large to want as a tao::json::value
+
+    template<typename Visitor>
+    void visitFunctionResult(std::string_view funcName, std::string_view result, Visitor &visitor) const {
+        _visit(_getFunction(funcName).outputs, result, visitor);
+    }
+
+    /// Sends what decodeFunctionResult() would return to a tao::json events consumer, such as
+    /// tao::json::events::to_stream
+    template<typename Consumer> requires (!std::is_base_of_v<std::pmr::memory_resource, Consumer>)
+    void decodeFunctionResult(std::string_view funcName, std::string_view result, Consumer &consumer) const {
+        AbiJsonEvents<Consumer> events(consumer);
+        visitFunctionResult(funcName, result, events);
+    }
+
+
+    // Decoding into a memory_resource (see AbiArena.h), so a result's allocations can be freed
+    // all at once, eg by monotonic_buffer_resource::release()
+
+    AbiArenaValue decodeFunctionResult(std::string_view funcName, std::string_view result, std::pmr::memory_resource &mr) const {
+        return _decodeArena(_getFunction(funcName).outputs, result, mr);
+    }
+
+    /// {name, args}, with args in declaration order
+    AbiArenaValue decodeEvent(std::string_view topics, std::string_view data, std::pmr::memory_resource &mr) const {
+        auto *event = _findEvent(topics);
+        if (!event) throw hoytech::error("unable to decode solidity abi event");
+
+        AbiArenaBuilder builder(mr);
+        auto indexed = _decodeArena(event->indexedItems, topics.substr(32), mr);
+        auto nonIndexed = _decodeArena(event->nonIndexedItems, data, mr);
+
+        std::pmr::vector<std::pair<std::string_view, AbiArenaValue>> args(&mr);
+        args.reserve(event->isIndexed.size());
+        size_t nextIndexed = 0, nextNonIndexed = 0;
+
+        for (auto isIndexed : event->isIndexed) {
+            auto &from = isIndexed ? indexed : nonIndexed;
+            size_t i = isIndexed ? nextIndexed++ : nextNonIndexed++;
+            args.emplace_back(from.key(i), from[i]);
+        }
+
+        std::pair<std::string_view, AbiArenaValue> output[] = {
+            { "name", AbiArenaBuilder::makeString(event->name) },
+            { "args", builder.makeObject(args) },
+        };
+
+        return builder.makeObject(output);
+    }
+
+    /// {name, signature, args}
+    AbiArenaValue decodeFunctionData(std::string_view calldata, std::pmr::memory_resource &mr) const {
+        auto *function = _findFunctionBySelector(calldata);
+        if (!function) throw hoytech::error("unable to decode calldata for unknown solidity abi function");
+
+        AbiArenaBuilder builder(mr);
+
+        std::pair<std::string_view, AbiArenaValue> output[] = {
+            { "name", AbiArenaBuilder::makeString(function->name) },
+            { "signature", AbiArenaBuilder::makeString(function->signature) },
+            { "args", _decodeArena(function->inputs, calldata.substr(4), mr) },
+        };
+
+        return builder.makeObject(output);
+    }
+
+
+    // Typed encoding and decoding (see AbiCodec.h). The encoder and decoder objects check their
+    // types against the ABI when they are created, so create them once and reuse them for hot
+    // loops. They refer to this SolidityAbi, which must outlive them.
+
+    template<typename... Args>
+    AbiEncoder<Args...> functionDataEncoder(std::string_view funcName) const {
+        auto &function = _getFunction(funcName);
+        return AbiEncoder<Args...>(function.inputs, function.sigHash);
+    }
+
+    /// encodeFunctionData("transfer", to, uint256(100)) for example. String literals encode as string/bytes.
+    template<typename... Args> requires (!(std::is_same_v<std::decay_t<Args>, tao::json::value> || ...))
+    std::string encodeFunctionData(std::string_view funcName, const Args &...args) const {
+        return functionDataEncoder<std::decay_t<const Args&>...>(funcName)(args...);
     }
 
-    std::string getEventHash(const std::string &eventName) {
-        return eventNameToHash.at(eventName);
+    template<typename T>
+    AbiDecoder<T> functionResultDecoder(std::string_view funcName) const {
+        return AbiDecoder<T>(_getFunction(funcName).outputs, decodeLimits);
+    }
+
+    template<typename T>
+    T decodeFunctionResult(std::string_view funcName, std::string_view result) const {
+        return functionResultDecoder<T>(funcName)(result);
+    }
+
+    template<typename T>
+    AbiEventDecoder<T> eventDecoder(std::string_view eventName) const {
+        auto it = eventNameToHash.find(std::string(eventName));
+        if (it == eventNameToHash.end()) throw hoytech::error("unknown solidity abi event: ", eventName);
+        auto &event = events.at(it->second);
+
+        return AbiEventDecoder<T>(event.indexedItems, event.nonIndexedItems, event.isIndexed, asStringView(it->second), decodeLimits);
+    }
+
+    template<typename T>
+    T decodeEvent(std::string_view topics, std::string_view data) const {
+        auto *event = _findEvent(topics);
+        if (!event) throw hoytech::error("unable to decode solidity abi event");
+
+        return AbiEventDecoder<T>(event->indexedItems, event->nonIndexedItems, event->isIndexed, topics.substr(0, 32), decodeLimits)(topics, data);
     }
 
 
@@ -127,22 +343,87 @@ class SolidityAbi {
   private:
     struct Event {
         std::string name;
-        std::vector<tao::json::value> indexedItems;
-        std::vector<tao::json::value> nonIndexedItems;
+        std::string signature;
+        AbiPlan indexedItems;
+        AbiPlan nonIndexedItems;
+        std::vector<uint8_t> isIndexed; // per input, in declaration order
     };
 
-    std::unordered_map<std::string, Event> events;
-    std::unordered_map<std::string, std::string> eventNameToHash;
+    std::shared_ptr<const AbiFile> file; // If loaded from a binary ABI, which the plans point into
+    std::optional<AbiDecodeLimits> decodeLimits;
+    std::unordered_map<Bytes32, Event, FixedBytesHash> events;
+    std::unordered_map<std::string, Bytes32> eventNameToHash;
+
+    // topics is the concatenated topics of a log, starting with topic0
+    const Event *_findEvent(std::string_view topics) const {
+        if (topics.size() < 32) return nullptr;
+        auto it = events.find(fixedBytesFromRaw<32>(topics.substr(0, 32)));
+        return it == events.end() ? nullptr : &it->second;
+    }
+
+    tao::json::value _decodeEvent(const Event &event, std::string_view indexedTopics, std::string_view data) const {
+        tao::json::value output = _abiDecode(event.indexedItems, indexedTopics);
+        tao::json::value output2 = _abiDecode(event.nonIndexedItems, data);
+
+        for (auto &pair : output2.get_object()) output[pair.first] = pair.second;
+
+        return { { "name", event.name }, { "args", output } };
+    }
 
 
     struct Function {
-        tao::json::value item;
-        std::string sigHash;
+        std::string name;
+        std::string signature; // canonical, eg "transfer(address,uint256)"
+        std::string sigHash; // 4-byte selector
+        AbiPlan inputs;
+        AbiPlan outputs;
     };
 
-    std::unordered_map<std::string, Function> functions;
+    // Overloaded functions share a name, so they're stored in declaration order and looked up by
+    // index: by name (which gives the first overload) or full signature, and by selector
+    std::vector<Function> functions;
+    AbiNameMap<uint32_t> functionsByName;
+    SelectorTable<uint32_t> functionsBySelector;
 
 
+    const Function *_findFunction(std::string_view funcName) const {
+        auto it = functionsByName.find(funcName);
+        return it == functionsByName.end() ? nullptr : &functions[it->second];
+    }
+
+    const Function &_getFunction(std::string_view funcName) const {
+        auto *function = _findFunction(funcName);
+        if (!function) throw hoytech::error("unknown solidity abi function: ", funcName);
+        return *function;
+    }
+
+    const Function *_findFunctionBySelector(std::string_view calldata) const {
+        if (calldata.size() < 4) return nullptr;
+        auto *index = functionsBySelector.find(selectorOf(calldata));
+        return index ? &functions[*index] : nullptr;
+    }
+
+    tao::json::value _decodeFunctionData(const Function &function, std::string_view calldata) const {
+        return { { "name", function.name }, { "signature", function.signature }, { "args", _abiDecode(function.inputs, calldata.substr(4)) } };
+    }
+
+    void _addFunction(Function &&f) {
+        uint32_t index = functions.size();
+
+        // On a selector clash between different signatures, calldata decodes as the first one, but
+        // both can still be encoded by name or signature
+        functionsBySelector.insert(selectorOf(f.sigHash), index);
+
+        functionsByName.emplace(f.name, index);
+        functionsByName.emplace(f.signature, index);
+        functions.push_back(std::move(f));
+    }
+
+    void _addEvent(const Bytes32 &topic0, Event &&e) {
+        eventNameToHash.emplace(e.name, topic0);
+        events.emplace(topic0, std::move(e));
+    }
+
     void _init(tao::json::value &abi) {
         if (abi.is_array()) {
             _init2(abi);
@@ -159,335 +440,176 @@ class SolidityAbi {
 
             auto name = item.at("name").get_string();
             auto type = item.at("type").get_string();
-            auto format = _getFormat(name, item.at("inputs"));
+            auto format = abiSignature(name, item.at("inputs"));
             auto formatHash = keccak256(format);
 
             if (type == "event") {
                 Event e;
 
                 e.name = name;
+                e.signature = format;
+
+                std::vector<tao::json::value> indexedItems, nonIndexedItems;
 
                 for (auto &input : item.at("inputs").get_array()) {
-                    if (input.at("indexed").get_boolean()) e.indexedItems.push_back(input);
-                    else e.nonIndexedItems.push_back(input);
+                    bool indexed = input.at("indexed").get_boolean();
+                    if (indexed) indexedItems.push_back(input);
+                    else nonIndexedItems.push_back(input);
+                    e.isIndexed.push_back(indexed);
                 }
 
-                eventNameToHash.emplace(name, formatHash);
-                events.emplace(formatHash, std::move(e));
+                e.indexedItems = AbiPlan(indexedItems);
+                e.nonIndexedItems = AbiPlan(nonIndexedItems);
+
+                _addEvent(fixedBytesFromRaw<32>(formatHash), std::move(e));
             } else if (type == "function") {
                 Function f;
 
-                f.item = item;
+                f.name = name;
+                f.signature = format;
                 f.sigHash = formatHash.substr(0, 4);
+                f.inputs = AbiPlan(item.at("inputs").get_array());
+                if (auto *outputs = item.find("outputs")) f.outputs = AbiPlan(outputs->get_array());
 
-                if (functions.find(name) != functions.end()) {
-                    std::cerr << "WARNING: Duplicate solidity function name: " << name << std::endl;
-                    continue;
-                }
-
-                functions.emplace(name, std::move(f));
+                _addFunction(std::move(f));
             }
         }
     }
 
-    std::string _getFormat(std::string &name, tao::json::value &inputs) {
-        auto output = name;
-
-        output += "(";
-
-        bool first = true;
-
-        for (auto &input : inputs.get_array()) {
-            if (!first) output += ",";
-            first = false;
-
-            auto type = input.at("type").get_string();
-
-            if (type.substr(0, 5) == "tuple") {
-                std::string empty;
-                output += _getFormat(empty, input.at("components"));
-                output += type.substr(5); // any following array modifiers
-            } else {
-                output += type;
-            }
-        }
-
-        output += ")";
+    tao::json::value _abiDecode(const AbiPlan &plan, std::string_view buffer) const {
+        AbiJsonBuilder builder;
+        _visit(plan, buffer, builder);
+        return std::move(builder.result);
+    }
 
-        return output;
+    template<typename Visitor>
+    void _visit(const AbiPlan &plan, std::string_view buffer, Visitor &visitor) const {
+        if (decodeLimits) abiVisit(plan, buffer, visitor, *decodeLimits);
+        else abiVisit(plan, buffer, visitor);
     }
 
-    struct ParseNode {
-        std::string fieldName;
-        std::string base;
-        int byteWidth = -1;
-        bool dynamic = false;
-        std::unique_ptr<ParseNode> arrayOf;
-        long fixedArraySize = -1;
-        std::vector<ParseNode> components;
+    AbiArenaValue _decodeArena(const AbiPlan &plan, std::string_view buffer, std::pmr::memory_resource &mr) const {
+        if (decodeLimits) return abiDecodeArena(plan, buffer, mr, *decodeLimits);
+        return abiDecodeArena(plan, buffer, mr);
+    }
 
-        ParseNode(std::vector<tao::json::value> &items) {
-            tao::json::value root({ { "name", "" }, { "components", items } });
-            _init(root, "tuple");
-            dynamic = false; // root tuple doesn't need indirection
-        }
+    // Appends the encoding of input to out. The exact size is computed first, so out is grown
+    // at most once, and then every value is written in place with the same layout as solc: the
+    // data of each dynamic value follows the heads of the tuple or array that contains it.
+    void _abiEncode(const AbiPlan &plan, const tao::json::value &input, std::string &out) const {
+        auto &root = plan.root();
 
-        // Interior node constructor
-        ParseNode(tao::json::value &field, std::string type) {
-            _init(field, type);
-        }
+        out.reserve(out.size() + root.headSize + _encodedTailSize(plan, root, input));
 
-      private:
-        void _init(tao::json::value &field, std::string type) {
-            fieldName = field.at("name").get_string();
+        size_t basis = out.size();
+        out.resize(basis + root.headSize);
+        _encodeNode(plan, root, input, out, basis, basis);
+    }
 
-            if (type.ends_with("]")) {
-                auto pos = type.find_last_of('[');
-                if (pos == std::string::npos) throw hoytech::error("unbalanced array brackets in type: ", type);
-                auto arrayLenSpec = type.substr(pos + 1, type.size() - pos - 2);
+    // Bytes that item's encoding takes outside of its head
+    size_t _encodedTailSize(const AbiPlan &plan, const AbiNode &node, const tao::json::value &item) const {
+        auto padded = [](size_t n){ return (n + 31) / 32 * 32; };
 
-                if (arrayLenSpec == "") dynamic = true;
-                else fixedArraySize = stol(arrayLenSpec);
+        switch (node.kind) {
+            case AbiKind::String:
+                return 32 + padded(item.get_string().size());
 
-                arrayOf = make_unique<ParseNode>(field, type.substr(0, pos));
-                if (arrayOf->dynamic) dynamic = true;
+            case AbiKind::Bytes:
+                return 32 + padded(_stripHexPrefix(item.get_string()).size() / 2);
 
-                return;
-            }
+            case AbiKind::DynamicArray:
+            case AbiKind::StaticArray: {
+                if (!node.dynamic) return 0;
 
-            std::size_t curr = type.find_first_not_of("abcdefghijklmnopqrstuvwxyz");
-            if (curr == std::string::npos) curr = type.size();
-            base = type.substr(0, curr);
-            type = type.substr(curr);
-
-            curr = type.find_first_not_of("0123456789");
-            if (curr == std::string::npos) curr = type.size();
-            if (curr > 0) {
-                byteWidth = stoi(type.substr(0, curr));
-                if (base == "uint" || base == "int") byteWidth /= 8;
-                type = type.substr(curr);
+                auto &arr = item.get_array();
+                auto &elem = plan.child(node, 0);
+                size_t size = (node.kind == AbiKind::DynamicArray ? 32 : 0) + arr.size() * elem.headSize;
+                if (elem.dynamic) {
+                    for (const auto &e : arr) size += _encodedTailSize(plan, elem, e);
+                }
+                return size;
             }
 
-            if (base == "tuple") {
-                for (auto &c : field.at("components").get_array()) {
-                    components.push_back(ParseNode(c, c.at("type").get_string()));
-                    if (components.back().dynamic) dynamic = true;
+            case AbiKind::Tuple: {
+                size_t size = node.dynamic ? _tupleHeadSize(plan, node) : 0;
+                for (size_t i = 0; i < node.numChildren; i++) {
+                    auto &component = plan.child(node, i);
+                    if (component.dynamic) size += _encodedTailSize(plan, component, abiJsonMember(plan, component, item));
                 }
-            } else if (base == "string" || (base == "bytes" && byteWidth == -1)) {
-                dynamic = true;
+                return size;
             }
-        }
-    };
 
+            default:
+                return 0;
+        }
+    }
 
-    tao::json::value _abiDecode(std::vector<tao::json::value> &items, std::string_view buffer) {
-        size_t currOffset = 0;
-
-        auto consume = [&](size_t n = 32){
-            auto slice = buffer.substr(currOffset, n);
-            if (slice.size() != n) throw hoytech::error("buffer underrun");
-            currOffset += n;
-            return slice;
-        };
-
-        auto followPointer = [&](std::function<void()> cb){
-            auto ptr = convertToMpz(consume()).get_ui();
-            auto savedOffset = currOffset;
-            currOffset = ptr;
-
-            cb();
-
-            currOffset = savedOffset;
-        };
-
-        auto newOffsetBasis = [&](std::function<void()> cb){
-            auto savedBuffer = buffer;
-            buffer = buffer.substr(currOffset);
-            currOffset = 0;
+    static size_t _tupleHeadSize(const AbiPlan &plan, const AbiNode &node) {
+        if (node.numChildren == 0) return 0;
+        auto &last = plan.child(node, node.numChildren - 1);
+        return last.headOffset + last.headSize;
+    }
 
-            cb();
+    static std::string_view _stripHexPrefix(std::string_view str) {
+        if (str.size() >= 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) str = str.substr(2);
+        return str;
+    }
 
-            buffer = savedBuffer;
-        };
+    // Writes item's head at headPos, and appends its body if it's dynamic. Pointers are relative to basis.
+    void _encodeNode(const AbiPlan &plan, const AbiNode &node, const tao::json::value &item, std::string &out, size_t basis, size_t headPos) const {
+        if (node.dynamic) {
+            writeWord(out, headPos, uint256(out.size() - basis));
+            basis = headPos = out.size();
+        }
 
-        std::function<tao::json::value(ParseNode &)> process = [&](ParseNode &node) -> tao::json::value {
-            if (node.arrayOf) {
-                tao::json::value arr = tao::json::empty_array;
-
-                if (node.dynamic) {
-                    followPointer([&]{
-                        size_t len = node.fixedArraySize > -1 ? node.fixedArraySize : convertToMpz(consume()).get_ui();
-                        newOffsetBasis([&]{
-                            for (size_t i = 0; i < len; i++) {
-                                arr.push_back(process(*node.arrayOf));
-                            }
-                        });
-                    });
-                } else {
-                    for (auto i = 0; i < node.fixedArraySize; i++) {
-                        arr.push_back(process(*node.arrayOf));
-                    }
+        switch (node.kind) {
+            case AbiKind::DynamicArray:
+            case AbiKind::StaticArray: {
+                auto &arr = item.get_array();
+                auto &elem = plan.child(node, 0);
+
+                if (node.kind == AbiKind::DynamicArray) {
+                    out.resize(out.size() + 32);
+                    writeWord(out, headPos, uint256(arr.size()));
+                    basis = headPos = out.size();
+                } else if (arr.size() != node.arraySize) {
+                    throw hoytech::error("wrong number of elements for ", plan.type(node), ": ", arr.size());
                 }
 
-                return arr;
-            } else if (node.base == "tuple") {
-                tao::json::value o = tao::json::empty_object;
-
-                if (node.dynamic) {
-                    followPointer([&]{
-                        newOffsetBasis([&]{
-                            for (auto &component : node.components) {
-                                o[component.fieldName] = process(component);
-                            }
-                        });
-                    });
-                } else {
-                    for (auto &component : node.components) {
-                        o[component.fieldName] = process(component);
-                    }
-                }
+                if (node.dynamic) out.resize(out.size() + arr.size() * elem.headSize);
 
-                return o;
-            } else if (node.base == "address") {
-                return hoytech::to_hex(consume().substr(12), true);
-            } else if (node.base == "uint") {
-                return convertToMpz(consume()).get_str();
-            } else if (node.base == "int") {
-                return convertToMpzSigned(consume()).get_str();
-            } else if (node.base == "bool") {
-                return convertToMpz(consume()) != 0;
-            } else if (node.base == "string") {
-                std::string str;
-
-                followPointer([&]{
-                    size_t len = convertToMpz(consume()).get_ui();
-                    str = consume(len);
-                });
-
-                return str;
-            } else if (node.base == "bytes" && node.byteWidth == -1) {
-                std::string str;
-
-                followPointer([&]{
-                    size_t len = convertToMpz(consume()).get_ui();
-                    str = consume(len);
-                });
-
-                return hoytech::to_hex(str, true);
-            } else if (node.base == "bytes") {
-                auto v = consume();
-                return hoytech::to_hex(v.substr(0, node.byteWidth), true);
-            } else {
-                throw hoytech::error("unrecognized type: ", node.base);
+                for (const auto &e : arr) {
+                    _encodeNode(plan, elem, e, out, basis, headPos);
+                    headPos += elem.headSize;
+                }
+                break;
             }
-        };
 
-        ParseNode tree(items);
+            case AbiKind::Tuple:
+                if (node.dynamic) out.resize(out.size() + _tupleHeadSize(plan, node));
 
-        return process(tree);
-    }
-
-    std::string _abiEncode(std::vector<tao::json::value> &rootItems, const tao::json::value &input) {
-        std::string output;
-        std::queue<std::function<void()>> pending;
-
-        auto append = [&](std::string_view data){
-            output += data;
-
-            size_t partialSize = data.size() % 32;
-
-            if (partialSize) {
-                size_t paddingSize = 32 - partialSize;
-                output += std::string(paddingSize, '\0');
-            }
-        };
-
-        std::function<void(ParseNode &, const tao::json::value &, uint64_t)> process = [&](ParseNode &node, const tao::json::value &item, uint64_t offset){
-            if (node.dynamic) {
-                auto slotLocation = output.size();
-                append("X"); // slot for pointer, will be padded to 32 bytes
-
-                pending.push([&, offset, slotLocation]{
-                    output.replace(slotLocation, 32, normaliseUnsigned(output.size() - offset));
-
-                    if (node.arrayOf) {
-                        if (node.fixedArraySize == -1) append(normaliseUnsigned(item.get_array().size()));
-                        uint64_t newOffset = output.size();
-                        for (const auto &i : item.get_array()) {
-                            process(*node.arrayOf, i, newOffset);
-                        }
-                    } else if (node.base == "tuple") {
-                        uint64_t newOffset = output.size();
-                        for (auto &component : node.components) {
-                            process(component, item.at(component.fieldName), newOffset);
-                        }
-                    } else if (node.base == "string") {
-                        auto &str = item.get_string();
-                        append(normaliseUnsigned(str.size()));
-                        append(str);
-                    } else if (node.base == "bytes" && node.byteWidth == -1) {
-                        auto str = hoytech::from_hex(item.get_string());
-                        append(normaliseUnsigned(str.size()));
-                        append(str);
-                    } else {
-                        throw hoytech::error("unexpected type: ", node.base);
-                    }
-                });
-            } else {
-                if (node.arrayOf) {
-                    for (const auto &i : item.get_array()) {
-                        process(*node.arrayOf, i, offset);
-                    }
-                } else if (node.base == "tuple") {
-                    for (auto &component : node.components) {
-                        process(component, item.at(component.fieldName), offset);
-                    }
-                } else if (node.base == "address") {
-                    auto str = item.get_string();
-                    if (str.size() != 42) throw hoytech::error("bad length for address: ", item.get_string());
-                    append(normaliseHexStr(str));
-                } else if (node.base == "bytes" && node.byteWidth > -1) {
-                    auto str = hoytech::from_hex(item.get_string());
-                    if (str.size() != static_cast<size_t>(node.byteWidth)) throw hoytech::error("bad length for bytesN: ", item.get_string());
-                    append(str);
-                } else if (node.base == "bool") {
-                    append(normaliseUnsigned(item.get_boolean() ? 1 : 0));
-                } else if (node.base == "uint") {
-                    if (item.is_integer()) {
-                        uint64_t v = item.get_unsigned();
-                        append(normaliseUnsigned(v));
-                    } else {
-                        mpz_class n(item.get_string());
-                        if (n < 0) throw hoytech::error("value for uint is negative: ", item.get_string());
-                        append(normaliseMpz(n));
-                    }
-                } else if (node.base == "int") {
-                    if (item.is_unsigned()) {
-                        uint64_t v = item.get_unsigned();
-                        append(normaliseUnsigned(v));
-                    } else if (item.is_signed()) {
-                        int64_t v = item.get_signed();
-                        append(normaliseSigned(v));
-                    } else {
-                        mpz_class n(item.get_string());
-                        append(normaliseSignedMpz(n));
-                    }
-                } else {
-                    throw hoytech::error("unexpected type: ", node.base);
+                for (size_t i = 0; i < node.numChildren; i++) {
+                    auto &component = plan.child(node, i);
+                    _encodeNode(plan, component, abiJsonMember(plan, component, item), out, basis, headPos + component.headOffset);
                 }
+                break;
+
+            case AbiKind::String:
+                appendLengthPrefixed(out, item.get_string());
+                break;
+
+            case AbiKind::Bytes: {
+                auto hex = _stripHexPrefix(item.get_string());
+                size_t len = hex.size() / 2;
+                out.resize(out.size() + 32 + (len + 31) / 32 * 32);
+                writeWord(out, headPos, uint256(len));
+                if (!hexDecode(hex, out.data() + headPos + 32)) throw hoytech::error("invalid hex string");
+                break;
             }
-        };
-
-        ParseNode tree(rootItems);
-        process(tree, input, 0);
 
-        while (!pending.empty()) {
-            auto cb = pending.front();
-            pending.pop();
-            cb();
+            default:
+                abiWordFromJson(plan, node, item, out.data() + headPos);
         }
-
-        return output;
     }
 };
 
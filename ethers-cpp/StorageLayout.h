@@ -0,0 +1,415 @@
+#pragma once
+
+#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <cstring>
+
+#include <tao/json.hpp>
+#include "hoytech/error.h"
+
+#include "ethers-cpp/keccak.h"
+#include "ethers-cpp/keccakBatch.h"
+#include "ethers-cpp/hex.h"
+#include "ethers-cpp/uint256.h"
+#include "ethers-cpp/SolidityAbi.h"
+
+
+namespace EthersCpp {
+
+using StorageSlot = std::array<uint8_t, 32>;
+
+
+/// Locates and decodes contract state variables, given the output of solc --storage-layout
+/** Usage:
+
+    EthersCpp::StorageLayout layout(storageLayoutJson);
+
+    // balances[addr] in `mapping(address => uint) balances`
+    auto loc = layout.locate("balances", { "0x1111111111111111111111111111111111111111" });
+    // ... eth_getStorageAt(contract, loc.slot) ...
+    tao::json::value balance = layout.decode(loc, { word });
+
+    Path elements are mapping keys, array indices, or struct member names, depending on the
+    type being indexed into. Mapping keys use the same JSON representation as encodeFunctionData.
+  */
+class StorageLayout {
+  public:
+    struct Location {
+        StorageSlot slot;
+        uint32_t offset = 0; // byte offset of the value inside the slot, counted from the least significant end
+        uint32_t type; // opaque type id
+    };
+
+    StorageLayout(std::string_view json) {
+        auto parsed = tao::json::from_string(json);
+        _init(parsed);
+    }
+
+    StorageLayout(const tao::json::value &json) {
+        _init(json);
+    }
+
+    Location locate(std::string_view variable, const std::vector<tao::json::value> &path = {}) const {
+        auto it = variables.find(std::string(variable));
+        if (it == variables.end()) throw hoytech::error("unknown storage variable: ", variable);
+
+        Location loc = it->second;
+
+        for (const auto &elem : path) {
+            auto &t = types[loc.type];
+
+            if (t.kind == Kind::Mapping) {
+                std::string preimage = encodeMappingKey(t.keyType, elem);
+                preimage.append(reinterpret_cast<const char*>(loc.slot.data()), 32);
+                loc = Location{ hashSlot(preimage), 0, t.valueType };
+            } else if (t.kind == Kind::DynamicArray) {
+                std::string_view base(reinterpret_cast<const char*>(loc.slot.data()), 32);
+                loc = arrayElement(hashSlot(base), t.valueType, elem.as<uint64_t>());
+            } else if (t.kind == Kind::StaticArray) {
+                uint64_t index = elem.as<uint64_t>();
+                if (index >= t.arrayLength) throw hoytech::error("static array index out of bounds: ", index);
+                loc = arrayElement(loc.slot, t.valueType, index);
+            } else if (t.kind == Kind::Struct) {
+                auto &memberName = elem.get_string();
+                const Member *member = nullptr;
+                for (auto &m : t.members) {
+                    if (m.name == memberName) member = &m;
+                }
+                if (!member) throw hoytech::error("unknown struct member: ", memberName);
+                loc = Location{ slotAdd(loc.slot, member->slot), member->offset, member->type };
+            } else {
+                throw hoytech::error("can't index into storage type: ", t.label);
+            }
+        }
+
+        return loc;
+    }
+
+    /// Locations of mapping[keys[i]] for the mapping at `mapping`, hashed in one batch
+    void mappingLocations(const Location &mapping, std::span<const tao::json::value> keys, std::span<Location> out) const {
+        auto &t = types[mapping.type];
+        if (t.kind != Kind::Mapping) throw hoytech::error("storage location is not a mapping: ", t.label);
+
+        std::vector<std::string> encodedKeys;
+        encodedKeys.reserve(keys.size());
+        for (const auto &k : keys) encodedKeys.push_back(encodeMappingKey(t.keyType, k));
+
+        std::vector<std::string_view> views(encodedKeys.begin(), encodedKeys.end());
+        mappingLocationsRaw(mapping, views, out);
+    }
+
+    /// Same as mappingLocations, but keys are already encoded (32-byte padded for value types,
+    /// raw bytes for string and bytes keys)
+    void mappingLocationsRaw(const Location &mapping, std::span<const std::string_view> encodedKeys, std::span<Location> out) const {
+        auto &t = types[mapping.type];
+        if (t.kind != Kind::Mapping) throw hoytech::error("storage location is not a mapping: ", t.label);
+        if (encodedKeys.size() != out.size()) throw hoytech::error("mappingLocations: keys and out have different sizes");
+
+        std::string preimages;
+        std::vector<size_t> offsets;
+        offsets.reserve(encodedKeys.size() + 1);
+
+        size_t total = 0;
+        for (auto k : encodedKeys) total += k.size() + 32;
+        preimages.reserve(total);
+
+        for (auto k : encodedKeys) {
+            offsets.push_back(preimages.size());
+            preimages += k;
+            preimages.append(reinterpret_cast<const char*>(mapping.slot.data()), 32);
+        }
+        offsets.push_back(preimages.size());
+
+        std::vector<std::string_view> views;
+        views.reserve(encodedKeys.size());
+        for (size_t i = 0; i < encodedKeys.size(); i++) views.emplace_back(preimages.data() + offsets[i], offsets[i + 1] - offsets[i]);
+
+        std::vector<Keccak256Digest> hashes(views.size());
+        keccak256Batch(views, hashes);
+
+        for (size_t i = 0; i < hashes.size(); i++) out[i] = Location{ hashes[i], 0, t.valueType };
+    }
+
+    /// Number of consecutive slots, starting at loc.slot, that decode() needs
+    size_t numSlots(const Location &loc) const {
+        return (loc.offset + types[loc.type].numberOfBytes + 31) / 32;
+    }
+
+    /// Decodes the value at loc. words are the contents of numSlots(loc) consecutive slots starting at loc.slot.
+    /// Mappings can't be decoded, and dynamic arrays decode to their length.
+    tao::json::value decode(const Location &loc, std::span<const StorageSlot> words) const {
+        if (words.size() < numSlots(loc)) throw hoytech::error("not enough storage words to decode ", types[loc.type].label);
+        return _decode(loc.type, words, 0, loc.offset);
+    }
+
+    /// For string and bytes values: the slot where the data starts, if it doesn't fit inline
+    /// (in which case the length is returned by decode and the data is in the following
+    /// ceil(length/32) slots, see decodeLongBytes)
+    Location bytesDataLocation(const Location &loc) const {
+        std::string_view base(reinterpret_cast<const char*>(loc.slot.data()), 32);
+        return Location{ hashSlot(base), 0, loc.type };
+    }
+
+    tao::json::value decodeLongBytes(const Location &loc, size_t length, std::span<const StorageSlot> dataWords) const {
+        auto &t = types[loc.type];
+        if (t.kind != Kind::Bytes && t.kind != Kind::String) throw hoytech::error("not a bytes or string storage type: ", t.label);
+        if (dataWords.size() * 32 < length) throw hoytech::error("not enough storage words to decode ", t.label);
+
+        std::string data(reinterpret_cast<const char*>(dataWords.data()), length);
+        if (t.kind == Kind::String) return data;
+        return toHex(data, true);
+    }
+
+    const std::string &typeLabel(const Location &loc) const {
+        return types[loc.type].label;
+    }
+
+
+  private:
+    enum class Kind { Uint, Int, Address, Bool, FixedBytes, Bytes, String, Mapping, DynamicArray, StaticArray, Struct };
+
+    struct Member {
+        std::string name;
+        uint64_t slot;
+        uint32_t offset;
+        uint32_t type;
+    };
+
+    struct Type {
+        Kind kind;
+        std::string label;
+        uint32_t numberOfBytes = 32;
+        uint32_t keyType = 0;
+        uint32_t valueType = 0; // mapping value, or array base
+        uint64_t arrayLength = 0;
+        std::vector<Member> members;
+    };
+
+    std::vector<Type> types;
+    std::unordered_map<std::string, uint32_t> typeIds;
+    std::unordered_map<std::string, Location> variables;
+
+
+    void _init(const tao::json::value &json) {
+        const tao::json::value *layout = &json;
+        if (json.find("storageLayout")) layout = &json.at("storageLayout");
+
+        auto &typesJson = layout->at("types");
+
+        for (const auto &item : layout->at("storage").get_array()) {
+            Location loc;
+            loc.slot = parseSlot(item.at("slot"));
+            loc.offset = item.at("offset").as<uint64_t>();
+            loc.type = resolveType(typesJson, item.at("type").get_string());
+            variables.emplace(item.at("label").get_string(), loc);
+        }
+    }
+
+    uint32_t resolveType(const tao::json::value &typesJson, const std::string &typeId) {
+        auto found = typeIds.find(typeId);
+        if (found != typeIds.end()) return found->second;
+
+        auto &spec = typesJson.at(typeId);
+
+        Type t;
+        t.label = spec.at("label").get_string();
+        t.numberOfBytes = std::stoul(spec.at("numberOfBytes").get_string());
+
+        auto &encoding = spec.at("encoding").get_string();
+
+        if (encoding == "mapping") {
+            t.kind = Kind::Mapping;
+            t.keyType = resolveType(typesJson, spec.at("key").get_string());
+            t.valueType = resolveType(typesJson, spec.at("value").get_string());
+        } else if (encoding == "dynamic_array") {
+            t.kind = Kind::DynamicArray;
+            t.valueType = resolveType(typesJson, spec.at("base").get_string());
+        } else if (encoding == "bytes") {
+            t.kind = t.label == "string" ? Kind::String : Kind::Bytes;
+        } else if (encoding == "inplace") {
+            if (spec.find("members")) {
+                t.kind = Kind::Struct;
+                for (const auto &m : spec.at("members").get_array()) {
+                    Member member;
+                    member.name = m.at("label").get_string();
+                    member.slot = std::stoull(m.at("slot").get_string());
+                    member.offset = m.at("offset").as<uint64_t>();
+                    member.type = resolveType(typesJson, m.at("type").get_string());
+                    t.members.push_back(std::move(member));
+                }
+            } else if (spec.find("base")) {
+                t.kind = Kind::StaticArray;
+                t.valueType = resolveType(typesJson, spec.at("base").get_string());
+                auto pos = t.label.find_last_of('[');
+                if (pos == std::string::npos) throw hoytech::error("unable to determine static array length: ", t.label);
+                t.arrayLength = std::stoull(t.label.substr(pos + 1));
+            } else if (t.label == "bool") {
+                t.kind = Kind::Bool;
+            } else if (t.label.starts_with("address") || t.label.starts_with("contract ")) {
+                t.kind = Kind::Address;
+            } else if (t.label.starts_with("uint") || t.label.starts_with("enum ")) {
+                t.kind = Kind::Uint;
+            } else if (t.label.starts_with("int")) {
+                t.kind = Kind::Int;
+            } else if (t.label.starts_with("bytes")) {
+                t.kind = Kind::FixedBytes;
+            } else {
+                throw hoytech::error("unsupported storage type: ", t.label);
+            }
+        } else {
+            throw hoytech::error("unsupported storage encoding: ", encoding);
+        }
+
+        types.push_back(std::move(t));
+        uint32_t id = types.size() - 1;
+        typeIds.emplace(typeId, id);
+        return id;
+    }
+
+    static StorageSlot parseSlot(const tao::json::value &v) {
+        uint256 n = v.is_string() ? uint256::fromString(v.get_string()) : uint256(v.as<uint64_t>());
+        StorageSlot slot;
+        n.toBigEndian(slot.data());
+        return slot;
+    }
+
+    static StorageSlot slotAdd(StorageSlot slot, uint64_t n) {
+        uint64_t carry = n;
+        for (size_t i = 32; i > 0 && carry; i--) {
+            uint64_t sum = slot[i - 1] + (carry & 0xFF);
+            slot[i - 1] = sum & 0xFF;
+            carry = (carry >> 8) + (sum >> 8);
+        }
+        return slot;
+    }
+
+    static StorageSlot hashSlot(std::string_view preimage) {
+        auto h = keccak256(preimage);
+        StorageSlot slot;
+        memcpy(slot.data(), h.data(), 32);
+        return slot;
+    }
+
+    Location arrayElement(const StorageSlot &base, uint32_t elemType, uint64_t index) const {
+        uint32_t elemSize = types[elemType].numberOfBytes;
+
+        if (elemSize <= 16) {
+            uint64_t perSlot = 32 / elemSize;
+            return Location{ slotAdd(base, index / perSlot), static_cast<uint32_t>((index % perSlot) * elemSize), elemType };
+        }
+
+        uint64_t slotsPerElem = (elemSize + 31) / 32;
+        return Location{ slotAdd(base, index * slotsPerElem), 0, elemType };
+    }
+
+    std::string encodeMappingKey(uint32_t keyType, const tao::json::value &key) const {
+        auto &t = types[keyType];
+
+        switch (t.kind) {
+            case Kind::Address:
+                if (key.get_string().size() != 42) throw hoytech::error("bad length for address: ", key.get_string());
+                return normaliseHexStr(key.get_string());
+            case Kind::Uint:
+                if (key.is_integer()) return normaliseUnsigned(key.as<uint64_t>());
+                else {
+                    if (key.get_string().starts_with("-")) throw hoytech::error("value for uint is negative: ", key.get_string());
+                    return uint256::fromString(key.get_string()).toBytes();
+                }
+            case Kind::Int:
+                if (key.is_unsigned()) return normaliseUnsigned(key.get_unsigned());
+                else if (key.is_signed()) return normaliseSigned(key.get_signed());
+                else return int256::fromString(key.get_string()).bits.toBytes();
+            case Kind::Bool:
+                return normaliseUnsigned(key.get_boolean() ? 1 : 0);
+            case Kind::FixedBytes: {
+                auto str = fromHex(key.get_string());
+                if (str.size() != t.numberOfBytes) throw hoytech::error("bad length for ", t.label, ": ", key.get_string());
+                return str + std::string(32 - str.size(), '\0');
+            }
+            case Kind::String:
+                return key.get_string();
+            case Kind::Bytes:
+                return fromHex(key.get_string());
+            default:
+                throw hoytech::error("unsupported mapping key type: ", t.label);
+        }
+    }
+
+    // offset is counted from the least significant end of words[slotIndex]
+    tao::json::value _decode(uint32_t typeId, std::span<const StorageSlot> words, size_t slotIndex, uint32_t offset) const {
+        auto &t = types[typeId];
+
+        auto wordView = [&](size_t i){
+            if (i >= words.size()) throw hoytech::error("not enough storage words to decode ", t.label);
+            return std::string_view(reinterpret_cast<const char*>(words[i].data()), 32);
+        };
+
+        auto field = [&]{
+            if (offset + t.numberOfBytes > 32) throw hoytech::error("storage value crosses slot boundary: ", t.label);
+            return wordView(slotIndex).substr(32 - offset - t.numberOfBytes, t.numberOfBytes);
+        };
+
+        switch (t.kind) {
+            case Kind::Uint:
+                return uint256::fromBigEndian(field()).toString();
+            case Kind::Int:
+                return int256::fromBigEndian(field()).toString();
+            case Kind::Address:
+                return toHex(field(), true);
+            case Kind::Bool:
+                return field().find_first_not_of('\0') != std::string_view::npos;
+            case Kind::FixedBytes:
+                return toHex(field(), true);
+            case Kind::Bytes:
+            case Kind::String: {
+                auto w = wordView(slotIndex);
+                uint8_t last = static_cast<uint8_t>(w[31]);
+
+                if (last & 1) {
+                    // long form: slot holds length*2+1, data is at keccak256(slot)
+                    return { { "length", (uint256::fromBigEndian(w) >> 1).toString() } };
+                }
+
+                std::string data(w.substr(0, last / 2));
+                if (t.kind == Kind::String) return data;
+                return toHex(data, true);
+            }
+            case Kind::DynamicArray:
+                return uint256::fromBigEndian(wordView(slotIndex)).toString();
+            case Kind::StaticArray: {
+                tao::json::value arr = tao::json::empty_array;
+                uint32_t elemSize = types[t.valueType].numberOfBytes;
+
+                for (uint64_t i = 0; i < t.arrayLength; i++) {
+                    if (elemSize <= 16) {
+                        uint64_t perSlot = 32 / elemSize;
+                        arr.push_back(_decode(t.valueType, words, slotIndex + i / perSlot, (i % perSlot) * elemSize));
+                    } else {
+                        arr.push_back(_decode(t.valueType, words, slotIndex + i * ((elemSize + 31) / 32), 0));
+                    }
+                }
+
+                return arr;
+            }
+            case Kind::Struct: {
+                tao::json::value o = tao::json::empty_object;
+
+                for (auto &m : t.members) {
+                    if (types[m.type].kind == Kind::Mapping) continue;
+                    o[m.name] = _decode(m.type, words, slotIndex + m.slot, m.offset);
+                }
+
+                return o;
+            }
+            case Kind::Mapping:
+                throw hoytech::error("mappings have no value to decode");
+        }
+
+        throw hoytech::error("unrecognized storage type: ", t.label);
+    }
+};
+
+}
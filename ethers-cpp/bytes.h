@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/hex.h"
+
+
+// Fixed-size binary values (addresses, hashes, bytesN) that live on the stack instead of in std::strings
+
+
+namespace EthersCpp {
+
+template<size_t N>
+using FixedBytes = std::array<uint8_t, N>;
+
+using Address = FixedBytes<20>;
+using Bytes32 = FixedBytes<32>;
+
+
+template<size_t N>
+static inline std::string_view asStringView(const FixedBytes<N> &b) {
+    return std::string_view(reinterpret_cast<const char*>(b.data()), N);
+}
+
+/// From raw bytes, which must be exactly N long
+template<size_t N>
+static inline FixedBytes<N> fixedBytesFromRaw(std::string_view raw) {
+    if (raw.size() != N) throw hoytech::error("expected ", N, " bytes but got ", raw.size());
+    FixedBytes<N> output;
+    memcpy(output.data(), raw.data(), N);
+    return output;
+}
+
+/// From hex, with optional 0x prefix. Must decode to exactly N bytes.
+template<size_t N>
+static inline FixedBytes<N> fixedBytesFromHex(std::string_view hex) {
+    if (hex.size() >= 2 && hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X')) hex = hex.substr(2);
+    if (hex.size() != N * 2) throw hoytech::error("expected ", N, " hex-encoded bytes but got: ", hex);
+    FixedBytes<N> output;
+    if (!hexDecode(hex, reinterpret_cast<char*>(output.data()))) throw hoytech::error("invalid hex string: ", hex);
+    return output;
+}
+
+static inline Address addressFromHex(std::string_view hex) {
+    return fixedBytesFromHex<20>(hex);
+}
+
+template<size_t N>
+static inline std::string toHex(const FixedBytes<N> &b, bool prefixed = false) {
+    return toHex(asStringView(b), prefixed);
+}
+
+/// For unordered containers. Contents are usually hashes or addresses, so the leading bytes are already well mixed.
+struct FixedBytesHash {
+    template<size_t N>
+    size_t operator()(const FixedBytes<N> &b) const {
+        static_assert(N >= sizeof(size_t));
+        size_t h;
+        memcpy(&h, b.data(), sizeof(h));
+        return h;
+    }
+};
+
+}
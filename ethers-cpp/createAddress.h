@@ -0,0 +1,214 @@
+#pragma once
+
+#include <span>
+#include <optional>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/keccak.h"
+#include "ethers-cpp/keccakBatch.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/parallel.h"
+
+
+// Contract address prediction for CREATE and CREATE2. Everything works on fixed-size
+// byte arrays, so computing an address never allocates.
+
+
+namespace EthersCpp {
+
+/// keccak256(rlp([deployer, nonce]))[12:]
+static inline Address createAddress(const Address &deployer, uint64_t nonce) {
+    uint8_t buf[1 + 1 + 20 + 1 + 8];
+    size_t nonceLen = 0;
+    while (nonceLen < 8 && (nonce >> (nonceLen * 8))) nonceLen++;
+
+    // Payload is at most 30 bytes, so the list header is always the short form
+    size_t p = 1;
+    buf[p++] = 0x80 + 20;
+    memcpy(buf + p, deployer.data(), 20);
+    p += 20;
+
+    if (nonce == 0) {
+        buf[p++] = 0x80;
+    } else if (nonce < 0x80) {
+        buf[p++] = static_cast<uint8_t>(nonce);
+    } else {
+        buf[p++] = static_cast<uint8_t>(0x80 + nonceLen);
+        for (size_t i = nonceLen; i > 0; i--) buf[p++] = static_cast<uint8_t>(nonce >> ((i - 1) * 8));
+    }
+
+    buf[0] = static_cast<uint8_t>(0xc0 + (p - 1));
+
+    Keccak k;
+    k.add(buf, p);
+    uint8_t hash[32];
+    k.getHash(hash);
+
+    Address output;
+    memcpy(output.data(), hash + 12, 20);
+    return output;
+}
+
+
+/// Predicts CREATE2 addresses for a fixed deployer and init code. The 85-byte preimage fits
+/// in one keccak block, so each prediction is a single permutation of a stack buffer.
+class Create2 {
+  public:
+    /// Salts are hashed in groups of this many through keccak256Batch
+    static constexpr size_t BatchChunk = 64;
+
+    struct Match {
+        Bytes32 salt;
+        Address address;
+    };
+
+    Create2(const Address &deployer, const Bytes32 &initCodeHash) : initCodeHash(initCodeHash) {
+        prefix[0] = 0xff;
+        memcpy(prefix + 1, deployer.data(), 20);
+    }
+
+    /// Hashes the init code itself (ie, the contract creation bytecode plus constructor args)
+    static Create2 fromInitCode(const Address &deployer, std::string_view initCode) {
+        Keccak k;
+        k.add(initCode.data(), initCode.size());
+        Bytes32 h;
+        k.getHash(h.data());
+        return Create2(deployer, h);
+    }
+
+    Address operator()(const Bytes32 &salt) const {
+        uint8_t preimage[85];
+        memcpy(preimage, prefix, 21);
+        memcpy(preimage + 21, salt.data(), 32);
+        memcpy(preimage + 53, initCodeHash.data(), 32);
+
+        Keccak k;
+        k.add(preimage, sizeof(preimage));
+        uint8_t hash[32];
+        k.getHash(hash);
+
+        Address output;
+        memcpy(output.data(), hash + 12, 20);
+        return output;
+    }
+
+    /// outputs[i] = address for salts[i], hashed several at a time on SIMD lanes where available
+    void batch(std::span<const Bytes32> salts, std::span<Address> outputs) const {
+        if (salts.size() != outputs.size()) throw hoytech::error("Create2::batch: salts and outputs have different sizes");
+
+        Preimages pre(*this);
+
+        for (size_t i = 0; i < salts.size(); i += BatchChunk) {
+            size_t n = std::min(BatchChunk, salts.size() - i);
+            for (size_t j = 0; j < n; j++) pre.setSalt(j, salts[i + j]);
+            pre.hash(n, outputs.data() + i);
+        }
+    }
+
+    /// Finds the salt with the lowest counter such that pred(address) is true. Candidate salts
+    /// are saltBase with the last 8 bytes replaced by a big-endian counter from 0 to
+    /// maxAttempts-1. Each of pool's threads takes every pool.size()th chunk of counters, so
+    /// pred must be safe to call concurrently. The result is deterministic regardless of thread
+    /// count. If pred throws, the search stops and the exception is rethrown here.
+    template<typename Pred>
+    std::optional<Match> search(Pred pred, ThreadPool &pool, const Bytes32 &saltBase = {}, uint64_t maxAttempts = UINT64_MAX) const {
+        std::atomic<uint64_t> best = UINT64_MAX;
+        std::atomic<bool> failed = false;
+        uint64_t numChunks = maxAttempts / BatchChunk + (maxAttempts % BatchChunk ? 1 : 0);
+        size_t stride = pool.size();
+
+        pool.parallelFor(stride, [&](size_t firstChunk){
+            Preimages pre(*this);
+            Address addrs[BatchChunk];
+
+            try {
+                for (uint64_t c = firstChunk; c < numChunks; c += stride) {
+                    uint64_t start = c * BatchChunk;
+                    if (start >= best.load(std::memory_order_relaxed) || failed.load(std::memory_order_relaxed)) return;
+
+                    size_t n = static_cast<size_t>(std::min<uint64_t>(BatchChunk, maxAttempts - start));
+                    for (size_t j = 0; j < n; j++) pre.setSalt(j, saltBase, start + j);
+                    pre.hash(n, addrs);
+
+                    for (size_t j = 0; j < n; j++) {
+                        if (!pred(addrs[j])) continue;
+
+                        uint64_t counter = start + j;
+                        uint64_t cur = best.load();
+                        while (counter < cur && !best.compare_exchange_weak(cur, counter)) {}
+                        break;
+                    }
+                }
+            } catch (...) {
+                failed = true; // stop the other threads, and let parallelFor() rethrow
+                throw;
+            }
+        });
+
+        if (best == UINT64_MAX) return std::nullopt;
+
+        Match m;
+        m.salt = saltBase;
+        storeCounter(m.salt, best);
+        m.address = (*this)(m.salt);
+        return m;
+    }
+
+    /// numThreads of 0 means one per hardware thread
+    template<typename Pred>
+    std::optional<Match> search(Pred pred, const Bytes32 &saltBase = {}, uint64_t maxAttempts = UINT64_MAX, unsigned numThreads = 0) const {
+        ThreadPool pool(numThreads);
+        return search(pred, pool, saltBase, maxAttempts);
+    }
+
+  private:
+    uint8_t prefix[21];
+    Bytes32 initCodeHash;
+
+    static void storeCounter(Bytes32 &salt, uint64_t counter) {
+        for (size_t i = 0; i < 8; i++) salt[31 - i] = static_cast<uint8_t>(counter >> (i * 8));
+    }
+
+    // Fixed 85-byte preimages for one chunk, kept on the stack
+    struct Preimages {
+        uint8_t buf[BatchChunk][85];
+        std::string_view views[BatchChunk];
+        Keccak256Digest digests[BatchChunk];
+
+        Preimages(const Create2 &c) {
+            for (size_t j = 0; j < BatchChunk; j++) {
+                memcpy(buf[j], c.prefix, 21);
+                memcpy(buf[j] + 53, c.initCodeHash.data(), 32);
+                views[j] = std::string_view(reinterpret_cast<const char*>(buf[j]), 85);
+            }
+        }
+
+        void setSalt(size_t j, const Bytes32 &salt) {
+            memcpy(buf[j] + 21, salt.data(), 32);
+        }
+
+        void setSalt(size_t j, const Bytes32 &saltBase, uint64_t counter) {
+            Bytes32 salt = saltBase;
+            storeCounter(salt, counter);
+            setSalt(j, salt);
+        }
+
+        void hash(size_t n, Address *out) {
+            keccak256Batch(std::span(views, n), std::span(digests, n));
+            for (size_t j = 0; j < n; j++) memcpy(out[j].data(), digests[j].data() + 12, 20);
+        }
+    };
+};
+
+
+/// keccak256(0xff || deployer || salt || initCodeHash)[12:]
+static inline Address create2Address(const Address &deployer, const Bytes32 &salt, const Bytes32 &initCodeHash) {
+    return Create2(deployer, initCodeHash)(salt);
+}
+
+}
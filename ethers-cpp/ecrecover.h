@@ -1,6 +1,12 @@
 #pragma once
 
 #include <string_view>
+#include <optional>
+#include <span>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <cstring>
 
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
@@ -8,6 +14,8 @@
 #include "hoytech/error.h"
 
 #include "ethers-cpp/keccak.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/parallel.h"
 
 
 
@@ -15,34 +23,82 @@ namespace EthersCpp {
 
 static secp256k1_context *secp256k1ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
 
-static inline std::string ecrecover(std::string_view hash, int v, std::string_view r, std::string_view s) {
-    std::string signature;
-    signature += r;
-    signature += s;
+namespace ecrecoverDetail {
+    // Recovers into a 20-byte address without allocating. Returns nullptr on success, otherwise
+    // the name of the step that failed.
+    static inline const char *recover(const secp256k1_context *ctx, const uint8_t *hash, int v, const uint8_t *r, const uint8_t *s, uint8_t *address) {
+        uint8_t rs[64];
+        memcpy(rs, r, 32);
+        memcpy(rs + 32, s, 32);
+
+        secp256k1_ecdsa_recoverable_signature sig;
+        if (!secp256k1_ecdsa_recoverable_signature_parse_compact(ctx, &sig, rs, v)) return "secp256k1_ecdsa_recoverable_signature_parse_compact";
+
+        secp256k1_pubkey pub;
+        if (secp256k1_ecdsa_recover(ctx, &pub, &sig, hash) == 0) return "secp256k1_ecdsa_recover";
 
-    secp256k1_ecdsa_recoverable_signature sig;
-    if (!secp256k1_ecdsa_recoverable_signature_parse_compact(secp256k1ctx, &sig, reinterpret_cast<const unsigned char*>(signature.data()), v)) {
-        throw hoytech::error("secp256k1_ecdsa_recoverable_signature_parse_compact");
+        uint8_t pubKey[65];
+        size_t pubKeyLength = sizeof(pubKey);
+        if (!secp256k1_ec_pubkey_serialize(ctx, pubKey, &pubKeyLength, &pub, SECP256K1_EC_UNCOMPRESSED) || pubKeyLength != 65) return "secp256k1_ec_pubkey_serialize";
+
+        uint8_t pubKeyHash[32];
+        Keccak k;
+        k.add(pubKey + 1, 64);
+        k.getHash(pubKeyHash);
+        memcpy(address, pubKeyHash + 12, 20);
+
+        return nullptr;
     }
 
-    secp256k1_pubkey pub;
-    if (secp256k1_ecdsa_recover(secp256k1ctx, &pub, &sig, reinterpret_cast<const unsigned char*>(hash.data())) == 0) {
-        throw hoytech::error("secp256k1_ecdsa_recover");
+    // A 65-byte r,s,v signature (v is 0/1 or 27/28) or a 64-byte EIP-2098 compact one, whose
+    // recovery id is the top bit of s. Returns false if it's malformed or doesn't recover.
+    static inline bool recoverSignature(const secp256k1_context *ctx, const uint8_t *hash, std::string_view signature, uint8_t *address) {
+        auto *sig = reinterpret_cast<const uint8_t*>(signature.data());
+        uint8_t s[32];
+        int v;
+
+        if (signature.size() == 65) {
+            v = sig[64] >= 27 ? sig[64] - 27 : sig[64];
+            if (v > 1) return false;
+            memcpy(s, sig + 32, 32);
+        } else if (signature.size() == 64) {
+            v = sig[32] >> 7;
+            memcpy(s, sig + 32, 32);
+            s[0] &= 0x7F;
+        } else {
+            return false;
+        }
+
+        return !recover(ctx, hash, v, sig, s, address);
     }
 
-    char pubKeyBuffer[65];
-    size_t pubKeyBufferLength = 65;
+    // Each thread's own context, randomized when the thread first uses it
+    static inline const secp256k1_context *threadContext() {
+        thread_local std::unique_ptr<secp256k1_context, decltype(&secp256k1_context_destroy)> ctx = []{
+            std::unique_ptr<secp256k1_context, decltype(&secp256k1_context_destroy)> c(secp256k1_context_create(SECP256K1_CONTEXT_VERIFY), &secp256k1_context_destroy);
 
-    if (!secp256k1_ec_pubkey_serialize(secp256k1ctx, reinterpret_cast<unsigned char*>(&pubKeyBuffer[0]), &pubKeyBufferLength, &pub, SECP256K1_EC_UNCOMPRESSED)) {
-        throw hoytech::error("secp256k1_ec_pubkey_serialize");
-    }
+            std::random_device rd;
+            uint8_t seed[32];
+            for (size_t i = 0; i < sizeof(seed); i += 4) {
+                uint32_t r = rd();
+                memcpy(seed + i, &r, 4);
+            }
+            if (!secp256k1_context_randomize(c.get(), seed)) throw hoytech::error("secp256k1_context_randomize");
 
-    if (pubKeyBufferLength != 65) {
-        throw hoytech::error("secp256k1_ec_pubkey_serialize: returned bad length: ", pubKeyBufferLength);
+            return c;
+        }();
+
+        return ctx.get();
     }
+}
 
-    std::string pubKey(&pubKeyBuffer[1], pubKeyBufferLength-1);
-    std::string ethAddr = keccak256(pubKey).substr(12);
+static inline std::string ecrecover(std::string_view hash, int v, std::string_view r, std::string_view s) {
+    if (hash.size() != 32 || r.size() != 32 || s.size() != 32) throw hoytech::error("ecrecover: bad hash or signature length");
+
+    std::string ethAddr(20, '\0');
+    auto *err = ecrecoverDetail::recover(secp256k1ctx, reinterpret_cast<const uint8_t*>(hash.data()), v, reinterpret_cast<const uint8_t*>(r.data()),
+                                         reinterpret_cast<const uint8_t*>(s.data()), reinterpret_cast<uint8_t*>(ethAddr.data()));
+    if (err) throw hoytech::error(err);
 
     return ethAddr;
 }
@@ -57,4 +113,46 @@ static inline std::string ecrecoverPacked(std::string_view hash, std::string_vie
     return ecrecover(hash, v, r, s);
 }
 
+/// Signer of a 32-byte hash, from a 65-byte r,s,v signature (v is 0/1 or 27/28) or a 64-byte
+/// EIP-2098 compact one. Returns nullopt if the signature is malformed or doesn't recover.
+/// Uses the calling thread's context and doesn't allocate, so it's safe to call from many threads.
+static inline std::optional<Address> recoverAddress(std::string_view hash, std::string_view signature) {
+    if (hash.size() != 32) return std::nullopt;
+
+    Address address;
+    if (!ecrecoverDetail::recoverSignature(ecrecoverDetail::threadContext(), reinterpret_cast<const uint8_t*>(hash.data()), signature, address.data())) return std::nullopt;
+    return address;
+}
+
+/// Recovers the signer of each (hashes[i], vs[i], rs[i], ss[i]) into addresses[i], on pool's
+/// threads. v is the recovery id: 0/1, or 27/28. ok[i] is set to 1 if signature i recovered, else
+/// 0 and addresses[i] is zeroed. Returns the number that failed. Apart from parallelFor()
+/// itself, nothing is allocated.
+static inline size_t ecrecoverBatch(std::span<const Bytes32> hashes, std::span<const uint8_t> vs, std::span<const Bytes32> rs, std::span<const Bytes32> ss,
+                                    std::span<Address> addresses, std::span<uint8_t> ok, ThreadPool &pool) {
+    size_t n = hashes.size();
+    if (vs.size() != n || rs.size() != n || ss.size() != n || addresses.size() != n || ok.size() != n) throw hoytech::error("ecrecoverBatch: spans have different sizes");
+
+    std::atomic<size_t> numFailed = 0;
+
+    pool.parallelFor(n, [&](size_t i){
+        int v = vs[i] >= 27 ? vs[i] - 27 : vs[i];
+        ok[i] = v <= 1 && !ecrecoverDetail::recover(ecrecoverDetail::threadContext(), hashes[i].data(), v, rs[i].data(), ss[i].data(), addresses[i].data());
+
+        if (!ok[i]) {
+            addresses[i] = Address();
+            numFailed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }, 16);
+
+    return numFailed;
+}
+
+/// numThreads of 0 means one per hardware thread
+static inline size_t ecrecoverBatch(std::span<const Bytes32> hashes, std::span<const uint8_t> vs, std::span<const Bytes32> rs, std::span<const Bytes32> ss,
+                                    std::span<Address> addresses, std::span<uint8_t> ok, size_t numThreads = 0) {
+    ThreadPool pool(numThreads);
+    return ecrecoverBatch(hashes, vs, rs, ss, addresses, ok, pool);
+}
+
 }
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "hoytech/error.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define ETHERSCPP_HEX_SIMD 1
+#include <immintrin.h>
+#endif
+
+
+// Hex codec for the ABI and RPC paths. The core functions write into caller-provided
+// buffers; toHex()/fromHex() are drop-in replacements for hoytech::to_hex()/from_hex().
+
+
+namespace EthersCpp {
+
+namespace hexDetail {
+    static constexpr char digits[] = "0123456789abcdef";
+
+    struct DecodeTable {
+        int8_t v[256];
+
+        constexpr DecodeTable() : v() {
+            for (int i = 0; i < 256; i++) v[i] = -1;
+            for (int i = 0; i < 10; i++) v['0' + i] = i;
+            for (int i = 0; i < 6; i++) v['a' + i] = v['A' + i] = 10 + i;
+        }
+    };
+
+    static constexpr DecodeTable decodeTable;
+
+    static inline void encodeScalar(const uint8_t *in, size_t n, char *out) {
+        for (size_t i = 0; i < n; i++) {
+            out[i * 2] = digits[in[i] >> 4];
+            out[i * 2 + 1] = digits[in[i] & 0x0F];
+        }
+    }
+
+    static inline bool decodeScalar(const char *in, size_t n, uint8_t *out) {
+        int bad = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            int8_t hi = decodeTable.v[static_cast<uint8_t>(in[i * 2])];
+            int8_t lo = decodeTable.v[static_cast<uint8_t>(in[i * 2 + 1])];
+            bad |= hi | lo;
+            out[i] = static_cast<uint8_t>((hi << 4) | (lo & 0x0F));
+        }
+
+        return bad >= 0;
+    }
+
+#ifdef ETHERSCPP_HEX_SIMD
+    // Nibble -> ASCII through a pshufb lookup, then interleave high and low nibbles
+
+    __attribute__((target("ssse3")))
+    static void encodeSsse3(const uint8_t *in, size_t n, char *out) {
+        const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i*>(digits));
+        const __m128i mask = _mm_set1_epi8(0x0F);
+
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+            __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+        }
+
+        encodeScalar(in + i, n - i, out + i * 2);
+    }
+
+    __attribute__((target("avx2")))
+    static void encodeAvx2(const uint8_t *in, size_t n, char *out) {
+        const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(digits)));
+        const __m256i mask = _mm256_set1_epi8(0x0F);
+
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+            __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+            __m256i a = _mm256_unpacklo_epi8(hi, lo); // bytes 0-7 | 16-23
+            __m256i b = _mm256_unpackhi_epi8(hi, lo); // bytes 8-15 | 24-31
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 2), _mm256_permute2x128_si256(a, b, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 2 + 32), _mm256_permute2x128_si256(a, b, 0x31));
+        }
+
+        encodeSsse3(in + i, n - i, out + i * 2);
+    }
+
+    // ASCII -> nibble with range checks on '0'-'9' and (c | 0x20) in 'a'-'f', then
+    // pairs of nibbles are merged with maddubs (hi * 16 + lo) and packed to bytes
+
+    __attribute__((target("ssse3")))
+    static inline __m128i decodeNibblesSsse3(__m128i c, __m128i &valid) {
+        __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+        __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+        __m128i l = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i isAlpha = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+        valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isAlpha));
+        return _mm_or_si128(_mm_and_si128(isDigit, d), _mm_and_si128(isAlpha, _mm_add_epi8(l, _mm_set1_epi8(10))));
+    }
+
+    __attribute__((target("ssse3")))
+    static bool decodeSsse3(const char *in, size_t n, uint8_t *out) {
+        const __m128i weights = _mm_set1_epi16(0x0110);
+        __m128i valid = _mm_set1_epi8(-1);
+
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+            __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2 + 16));
+            __m128i v0 = _mm_maddubs_epi16(decodeNibblesSsse3(c0, valid), weights);
+            __m128i v1 = _mm_maddubs_epi16(decodeNibblesSsse3(c1, valid), weights);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(v0, v1));
+        }
+
+        if (_mm_movemask_epi8(valid) != 0xFFFF) return false;
+
+        return decodeScalar(in + i * 2, n - i, out + i);
+    }
+
+    __attribute__((target("avx2")))
+    static inline __m256i decodeNibblesAvx2(__m256i c, __m256i &valid) {
+        __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+        __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+        __m256i l = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        __m256i isAlpha = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+        valid = _mm256_and_si256(valid, _mm256_or_si256(isDigit, isAlpha));
+        return _mm256_or_si256(_mm256_and_si256(isDigit, d), _mm256_and_si256(isAlpha, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+    }
+
+    __attribute__((target("avx2")))
+    static bool decodeAvx2(const char *in, size_t n, uint8_t *out) {
+        const __m256i weights = _mm256_set1_epi16(0x0110);
+        __m256i valid = _mm256_set1_epi8(-1);
+
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 2));
+            __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 2 + 32));
+            __m256i v0 = _mm256_maddubs_epi16(decodeNibblesAvx2(c0, valid), weights);
+            __m256i v1 = _mm256_maddubs_epi16(decodeNibblesAvx2(c1, valid), weights);
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+        }
+
+        if (static_cast<uint32_t>(_mm256_movemask_epi8(valid)) != 0xFFFFFFFF) return false;
+
+        return decodeSsse3(in + i * 2, n - i, out + i);
+    }
+#endif
+}
+
+
+enum class HexImpl { Scalar, Ssse3, Avx2 }; // CPUs supporting one support the ones before it
+
+static inline HexImpl hexDetectImpl() {
+#ifdef ETHERSCPP_HEX_SIMD
+    static const HexImpl impl = []{
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return HexImpl::Avx2;
+        if (__builtin_cpu_supports("ssse3")) return HexImpl::Ssse3;
+        return HexImpl::Scalar;
+    }();
+    return impl;
+#else
+    return HexImpl::Scalar;
+#endif
+}
+
+/// Whether impl can run on this CPU and build
+static inline bool hexImplSupported(HexImpl impl) {
+    return impl <= hexDetectImpl();
+}
+
+/// Writes 2*in.size() lower-case hex characters to out (no prefix, no terminator). Uses the
+/// widest SIMD implementation supported by the running CPU unless impl is specified (for
+/// testing and benchmarking), which must then be supported.
+static inline void hexEncode(std::string_view in, char *out, HexImpl impl = hexDetectImpl()) {
+    auto *p = reinterpret_cast<const uint8_t*>(in.data());
+
+#ifdef ETHERSCPP_HEX_SIMD
+    if (impl == HexImpl::Avx2) return hexDetail::encodeAvx2(p, in.size(), out);
+    if (impl == HexImpl::Ssse3) return hexDetail::encodeSsse3(p, in.size(), out);
+#endif
+
+    hexDetail::encodeScalar(p, in.size(), out);
+}
+
+/// Writes in.size()/2 bytes to out. Returns false if in has odd length or contains a
+/// non-hex character (out contents are then unspecified). No 0x prefix is accepted.
+static inline bool hexDecode(std::string_view in, char *out, HexImpl impl = hexDetectImpl()) {
+    if (in.size() % 2) return false;
+
+    auto *p = reinterpret_cast<uint8_t*>(out);
+
+#ifdef ETHERSCPP_HEX_SIMD
+    if (impl == HexImpl::Avx2) return hexDetail::decodeAvx2(in.data(), in.size() / 2, p);
+    if (impl == HexImpl::Ssse3) return hexDetail::decodeSsse3(in.data(), in.size() / 2, p);
+#endif
+
+    return hexDetail::decodeScalar(in.data(), in.size() / 2, p);
+}
+
+static inline std::string toHex(std::string_view in, bool prefixed = false) {
+    size_t prefixLen = prefixed ? 2 : 0;
+    std::string output(prefixLen + in.size() * 2, '\0');
+
+    if (prefixed) {
+        output[0] = '0';
+        output[1] = 'x';
+    }
+
+    hexEncode(in, output.data() + prefixLen);
+
+    return output;
+}
+
+/// Accepts an optional 0x prefix. Throws on invalid input.
+static inline std::string fromHex(std::string_view in) {
+    if (in.size() >= 2 && in[0] == '0' && (in[1] == 'x' || in[1] == 'X')) in = in.substr(2);
+
+    std::string output(in.size() / 2, '\0');
+    if (!hexDecode(in, output.data())) throw hoytech::error("invalid hex string");
+
+    return output;
+}
+
+}
@@ -9,6 +9,7 @@
 
 #include <string>
 #include <string_view>
+#include <array>
 
 // big endian architectures need #define __BYTE_ORDER __BIG_ENDIAN
 #ifndef _MSC_VER
@@ -28,6 +29,88 @@ typedef unsigned __int64 uint64_t;
 
 namespace EthersCpp {
 
+#if defined(__GNUC__) || defined(__clang__)
+#define ETHERSCPP_KECCAK_INLINE __attribute__((always_inline)) inline
+#define ETHERSCPP_KECCAK_UNROLL _Pragma("GCC unroll 24")
+#else
+#define ETHERSCPP_KECCAK_INLINE inline
+#define ETHERSCPP_KECCAK_UNROLL
+#endif
+
+/// Keccak-f[1600] permutation over a state of 25 lanes.
+/** T is either uint64_t or a vector of uint64_t (GCC vector extension), in which case
+    every vector element is an independent state. Always inlined so that vector
+    instantiations are compiled with the ISA of the caller.
+  */
+template<typename T>
+ETHERSCPP_KECCAK_INLINE constexpr void keccakF1600(T *s)
+{
+  constexpr uint64_t roundConstants[24] =
+  {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+  };
+  constexpr unsigned int rotations[24] =
+    { 1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44 };
+  constexpr unsigned int positions[24] =
+    { 10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1 };
+
+  for (unsigned int round = 0; round < 24; round++)
+  {
+    // Theta
+    T c[5];
+    ETHERSCPP_KECCAK_UNROLL
+    for (unsigned int i = 0; i < 5; i++)
+      c[i] = s[i] ^ s[i + 5] ^ s[i + 10] ^ s[i + 15] ^ s[i + 20];
+
+    ETHERSCPP_KECCAK_UNROLL
+    for (unsigned int i = 0; i < 5; i++)
+    {
+      T d = c[(i + 4) % 5] ^ ((c[(i + 1) % 5] << 1) | (c[(i + 1) % 5] >> 63));
+      ETHERSCPP_KECCAK_UNROLL
+      for (unsigned int j = 0; j < 25; j += 5)
+        s[i + j] ^= d;
+    }
+
+    // Rho Pi
+    T last = s[1];
+    ETHERSCPP_KECCAK_UNROLL
+    for (unsigned int i = 0; i < 24; i++)
+    {
+      T one = s[positions[i]];
+      s[positions[i]] = (last << rotations[i]) | (last >> (64 - rotations[i]));
+      last = one;
+    }
+
+    // Chi
+    ETHERSCPP_KECCAK_UNROLL
+    for (unsigned int j = 0; j < 25; j += 5)
+    {
+      T one = s[j];
+      T two = s[j + 1];
+
+      s[j]     ^= s[j + 2] & ~two;
+      s[j + 1] ^= s[j + 3] & ~s[j + 2];
+      s[j + 2] ^= s[j + 4] & ~s[j + 3];
+      s[j + 3] ^=    one   & ~s[j + 4];
+      s[j + 4] ^=    two   & ~one;
+    }
+
+    // Iota
+    s[0] ^= roundConstants[round];
+  }
+}
+
+
+/// raw 32-byte keccak256 output
+using Keccak256Digest = std::array<uint8_t, 32>;
+
 /// compute Keccak hash (designated SHA3)
 /** Usage:
     Keccak keccak;
@@ -40,6 +123,9 @@ namespace EthersCpp {
     while (more data available)
       keccak.add(pointer to fresh data, number of new bytes);
     std::string myHash3 = keccak.getHash();
+
+    Keccak is a plain value: copying it after add() snapshots the absorbed prefix,
+    so the copy can be finished with different suffixes without rehashing the prefix.
   */
 class Keccak //: public Hash
 {
@@ -145,6 +231,17 @@ public:
     return result;
   }
 
+  /// write latest hash in bytes to out (m_bits / 8 bytes), without allocating
+  void getHash(uint8_t* out)
+  {
+    // process remaining bytes
+    processBuffer();
+
+    unsigned int hashBytes = m_bits / 8;
+    for (unsigned int i = 0; i < hashBytes; i++)
+      out[i] = (unsigned char) (m_hash[i / 8] >> (8 * (i % 8)));
+  }
+
   /// restart
   void reset()
   {
@@ -156,25 +253,6 @@ public:
   }
 
 private:
-  static const unsigned int KeccakRounds = 24;
-  static constexpr uint64_t XorMasks[KeccakRounds] =
-  {
-    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
-    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
-    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
-    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
-    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
-    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
-    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
-    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
-  };
-
-  /// rotate left and wrap around to the right
-  inline uint64_t rotateLeft(uint64_t x, uint8_t numBits)
-  {
-    return (x << numBits) | (x >> (64 - numBits));
-  }
-
   /// convert litte vs big endian
   inline uint64_t swap(uint64_t x)
   {
@@ -196,17 +274,6 @@ private:
   }
 
 
-  /// return x % 5 for 0 <= x <= 9
-  unsigned int mod5(unsigned int x)
-  {
-    if (x < 5)
-      return x;
-
-    return x - 5;
-  }
-
-
-
   /// process a full block
   void processBlock(const void* data)
   {
@@ -221,71 +288,7 @@ private:
     for (unsigned int i = 0; i < m_blockSize / 8; i++)
       m_hash[i] ^= LITTLEENDIAN(data64[i]);
 
-    // re-compute state
-    for (unsigned int round = 0; round < KeccakRounds; round++)
-    {
-      // Theta
-      uint64_t coefficients[5];
-      for (unsigned int i = 0; i < 5; i++)
-        coefficients[i] = m_hash[i] ^ m_hash[i + 5] ^ m_hash[i + 10] ^ m_hash[i + 15] ^ m_hash[i + 20];
-
-      for (unsigned int i = 0; i < 5; i++)
-      {
-        uint64_t one = coefficients[mod5(i + 4)] ^ rotateLeft(coefficients[mod5(i + 1)], 1);
-        m_hash[i     ] ^= one;
-        m_hash[i +  5] ^= one;
-        m_hash[i + 10] ^= one;
-        m_hash[i + 15] ^= one;
-        m_hash[i + 20] ^= one;
-      }
-
-      // temporary
-      uint64_t one;
-
-      // Rho Pi
-      uint64_t last = m_hash[1];
-      one = m_hash[10]; m_hash[10] = rotateLeft(last,  1); last = one;
-      one = m_hash[ 7]; m_hash[ 7] = rotateLeft(last,  3); last = one;
-      one = m_hash[11]; m_hash[11] = rotateLeft(last,  6); last = one;
-      one = m_hash[17]; m_hash[17] = rotateLeft(last, 10); last = one;
-      one = m_hash[18]; m_hash[18] = rotateLeft(last, 15); last = one;
-      one = m_hash[ 3]; m_hash[ 3] = rotateLeft(last, 21); last = one;
-      one = m_hash[ 5]; m_hash[ 5] = rotateLeft(last, 28); last = one;
-      one = m_hash[16]; m_hash[16] = rotateLeft(last, 36); last = one;
-      one = m_hash[ 8]; m_hash[ 8] = rotateLeft(last, 45); last = one;
-      one = m_hash[21]; m_hash[21] = rotateLeft(last, 55); last = one;
-      one = m_hash[24]; m_hash[24] = rotateLeft(last,  2); last = one;
-      one = m_hash[ 4]; m_hash[ 4] = rotateLeft(last, 14); last = one;
-      one = m_hash[15]; m_hash[15] = rotateLeft(last, 27); last = one;
-      one = m_hash[23]; m_hash[23] = rotateLeft(last, 41); last = one;
-      one = m_hash[19]; m_hash[19] = rotateLeft(last, 56); last = one;
-      one = m_hash[13]; m_hash[13] = rotateLeft(last,  8); last = one;
-      one = m_hash[12]; m_hash[12] = rotateLeft(last, 25); last = one;
-      one = m_hash[ 2]; m_hash[ 2] = rotateLeft(last, 43); last = one;
-      one = m_hash[20]; m_hash[20] = rotateLeft(last, 62); last = one;
-      one = m_hash[14]; m_hash[14] = rotateLeft(last, 18); last = one;
-      one = m_hash[22]; m_hash[22] = rotateLeft(last, 39); last = one;
-      one = m_hash[ 9]; m_hash[ 9] = rotateLeft(last, 61); last = one;
-      one = m_hash[ 6]; m_hash[ 6] = rotateLeft(last, 20); last = one;
-                        m_hash[ 1] = rotateLeft(last, 44);
-
-      // Chi
-      for (unsigned int j = 0; j < 25; j += 5)
-      {
-        // temporaries
-        uint64_t one = m_hash[j];
-        uint64_t two = m_hash[j + 1];
-
-        m_hash[j]     ^= m_hash[j + 2] & ~two;
-        m_hash[j + 1] ^= m_hash[j + 3] & ~m_hash[j + 2];
-        m_hash[j + 2] ^= m_hash[j + 4] & ~m_hash[j + 3];
-        m_hash[j + 3] ^=      one      & ~m_hash[j + 4];
-        m_hash[j + 4] ^=      two      & ~one;
-      }
-
-      // Iota
-      m_hash[0] ^= XorMasks[round];
-    }
+    keccakF1600(m_hash);
   }
 
   /// process everything left in the internal buffer
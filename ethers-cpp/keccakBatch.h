@@ -0,0 +1,179 @@
+#pragma once
+
+#include <string_view>
+#include <span>
+#include <array>
+#include <cstring>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/keccak.h"
+
+
+namespace EthersCpp {
+
+// Hashes many independent inputs by running one sponge per SIMD lane. Each lane is
+// refilled with the next input as soon as its current one is finished, so inputs of
+// mixed lengths don't leave lanes idle.
+
+namespace keccakBatchDetail {
+    static constexpr size_t Rate = 136; // keccak256: 200 - 2*32
+
+    static ETHERSCPP_KECCAK_INLINE uint64_t loadLE64(const uint8_t *p) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+
+    template<typename V, size_t Lanes>
+    ETHERSCPP_KECCAK_INLINE void hashLanes(std::span<const std::string_view> inputs, std::span<Keccak256Digest> outputs) {
+        struct Lane {
+            const uint8_t *ptr;
+            size_t remaining;
+            size_t index;
+            bool active = false;
+        };
+
+        Lane lanes[Lanes];
+        alignas(64) uint8_t padded[Lanes][Rate];
+        const uint8_t *blocks[Lanes];
+        bool finalBlock[Lanes];
+
+        V state[25];
+        memset(state, 0, sizeof(state));
+
+        size_t next = 0;
+
+        while (true) {
+            size_t numActive = 0;
+
+            for (size_t l = 0; l < Lanes; l++) {
+                auto &lane = lanes[l];
+
+                if (!lane.active && next < inputs.size()) {
+                    lane.ptr = reinterpret_cast<const uint8_t*>(inputs[next].data());
+                    lane.remaining = inputs[next].size();
+                    lane.index = next++;
+                    lane.active = true;
+                    for (size_t i = 0; i < 25; i++) state[i][l] = 0;
+                }
+
+                if (!lane.active) {
+                    // idle lane: absorb zeros, output is discarded
+                    blocks[l] = padded[l];
+                    memset(padded[l], 0, Rate);
+                    finalBlock[l] = false;
+                    continue;
+                }
+
+                numActive++;
+
+                if (lane.remaining >= Rate) {
+                    blocks[l] = lane.ptr;
+                    lane.ptr += Rate;
+                    lane.remaining -= Rate;
+                    finalBlock[l] = false;
+                } else {
+                    memcpy(padded[l], lane.ptr, lane.remaining);
+                    memset(padded[l] + lane.remaining, 0, Rate - lane.remaining);
+                    padded[l][lane.remaining] = 0x01;
+                    padded[l][Rate - 1] |= 0x80;
+                    blocks[l] = padded[l];
+                    finalBlock[l] = true;
+                }
+            }
+
+            if (numActive == 0) break;
+
+            for (size_t i = 0; i < Rate / 8; i++) {
+                alignas(64) uint64_t words[Lanes];
+                for (size_t l = 0; l < Lanes; l++) words[l] = loadLE64(blocks[l] + i * 8);
+                V w;
+                memcpy(&w, words, sizeof(w));
+                state[i] ^= w;
+            }
+
+            keccakF1600(state);
+
+            for (size_t l = 0; l < Lanes; l++) {
+                if (!finalBlock[l]) continue;
+
+                auto &out = outputs[lanes[l].index];
+                for (size_t i = 0; i < 4; i++) {
+                    uint64_t v = state[i][l];
+                    memcpy(out.data() + i * 8, &v, 8);
+                }
+
+                lanes[l].active = false;
+            }
+        }
+    }
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && __BYTE_ORDER == __LITTLE_ENDIAN
+#define ETHERSCPP_KECCAK_BATCH_SIMD 1
+
+    typedef uint64_t Vec4x64 __attribute__((vector_size(32)));
+    typedef uint64_t Vec8x64 __attribute__((vector_size(64)));
+
+    __attribute__((target("avx2")))
+    static void hashAvx2(std::span<const std::string_view> inputs, std::span<Keccak256Digest> outputs) {
+        hashLanes<Vec4x64, 4>(inputs, outputs);
+    }
+
+    __attribute__((target("avx512f")))
+    static void hashAvx512(std::span<const std::string_view> inputs, std::span<Keccak256Digest> outputs) {
+        hashLanes<Vec8x64, 8>(inputs, outputs);
+    }
+#endif
+
+    static void hashScalar(std::span<const std::string_view> inputs, std::span<Keccak256Digest> outputs) {
+        Keccak keccak;
+
+        for (size_t i = 0; i < inputs.size(); i++) {
+            keccak.reset();
+            keccak.add(inputs[i].data(), inputs[i].size());
+            keccak.getHash(outputs[i].data());
+        }
+    }
+}
+
+
+enum class KeccakBatchImpl { Scalar, Avx2, Avx512 };
+
+static inline KeccakBatchImpl keccakBatchDetectImpl() {
+#ifdef ETHERSCPP_KECCAK_BATCH_SIMD
+    static const KeccakBatchImpl impl = []{
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return KeccakBatchImpl::Avx512;
+        if (__builtin_cpu_supports("avx2")) return KeccakBatchImpl::Avx2;
+        return KeccakBatchImpl::Scalar;
+    }();
+    return impl;
+#else
+    return KeccakBatchImpl::Scalar;
+#endif
+}
+
+/// Computes outputs[i] = keccak256(inputs[i]). Uses the widest SIMD implementation
+/// supported by the running CPU unless impl is specified (mostly useful for benchmarking).
+static inline void keccak256Batch(std::span<const std::string_view> inputs, std::span<Keccak256Digest> outputs, KeccakBatchImpl impl = keccakBatchDetectImpl()) {
+    if (inputs.size() != outputs.size()) throw hoytech::error("keccak256Batch: inputs and outputs have different sizes");
+
+#ifdef ETHERSCPP_KECCAK_BATCH_SIMD
+    if (impl == KeccakBatchImpl::Avx512) {
+        if (!__builtin_cpu_supports("avx512f")) throw hoytech::error("keccak256Batch: CPU doesn't support AVX-512");
+        keccakBatchDetail::hashAvx512(inputs, outputs);
+        return;
+    } else if (impl == KeccakBatchImpl::Avx2) {
+        if (!__builtin_cpu_supports("avx2")) throw hoytech::error("keccak256Batch: CPU doesn't support AVX2");
+        keccakBatchDetail::hashAvx2(inputs, outputs);
+        return;
+    }
+#else
+    if (impl != KeccakBatchImpl::Scalar) throw hoytech::error("keccak256Batch: SIMD not available in this build");
+#endif
+
+    keccakBatchDetail::hashScalar(inputs, outputs);
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string_view>
+#include <cstring>
+
+#include "ethers-cpp/keccak.h"
+
+
+// Compile-time keccak256, plus helpers for function selectors and event topics:
+//
+//     switch (EthersCpp::selectorOf(calldata)) {
+//         case EthersCpp::selector("transfer(address,uint256)"): ...
+//     }
+//
+//     if (EthersCpp::topicEquals(topic0, EthersCpp::eventTopic("Transfer(address,address,uint256)"))) ...
+
+
+namespace EthersCpp {
+
+/// keccak256 usable in constant expressions (also works at runtime, but the Keccak class is faster there)
+constexpr Keccak256Digest constexprKeccak256(std::string_view input) {
+    constexpr size_t rate = 136;
+    uint64_t state[25] = {};
+
+    auto absorbByte = [&](size_t pos, uint8_t b) {
+        state[pos / 8] ^= uint64_t(b) << (8 * (pos % 8));
+    };
+
+    size_t pos = 0;
+
+    for (char c : input) {
+        absorbByte(pos++, static_cast<uint8_t>(c));
+        if (pos == rate) {
+            keccakF1600(state);
+            pos = 0;
+        }
+    }
+
+    absorbByte(pos, 0x01);
+    absorbByte(rate - 1, 0x80);
+    keccakF1600(state);
+
+    Keccak256Digest output{};
+    for (size_t i = 0; i < 32; i++) output[i] = static_cast<uint8_t>(state[i / 8] >> (8 * (i % 8)));
+    return output;
+}
+
+/// 4-byte function selector as a big-endian integer, ie selector("transfer(address,uint256)") == 0xa9059cbb
+consteval uint32_t selector(std::string_view signature) {
+    auto h = constexprKeccak256(signature);
+    return (uint32_t(h[0]) << 24) | (uint32_t(h[1]) << 16) | (uint32_t(h[2]) << 8) | uint32_t(h[3]);
+}
+
+/// topic0 of a non-anonymous event
+consteval Keccak256Digest eventTopic(std::string_view signature) {
+    return constexprKeccak256(signature);
+}
+
+/// First 8 bytes of topic0 as a big-endian integer, for use as a switch label. Since this is
+/// only a prefix, confirm a match with topicEquals() if the input is untrusted.
+consteval uint64_t eventTopicPrefix(std::string_view signature) {
+    auto h = constexprKeccak256(signature);
+    uint64_t output = 0;
+    for (size_t i = 0; i < 8; i++) output = (output << 8) | h[i];
+    return output;
+}
+
+
+/// Selector of raw calldata, to compare against selector(). Returns 0 if calldata is too short.
+static inline uint32_t selectorOf(std::string_view calldata) {
+    if (calldata.size() < 4) return 0;
+    auto *p = reinterpret_cast<const uint8_t*>(calldata.data());
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+/// Prefix of a raw topic, to compare against eventTopicPrefix(). Returns 0 if topic is too short.
+static inline uint64_t topicPrefixOf(std::string_view topic) {
+    if (topic.size() < 8) return 0;
+    uint64_t output = 0;
+    for (size_t i = 0; i < 8; i++) output = (output << 8) | static_cast<uint8_t>(topic[i]);
+    return output;
+}
+
+static inline bool topicEquals(std::string_view topic, const Keccak256Digest &expected) {
+    return topic.size() >= 32 && memcmp(topic.data(), expected.data(), 32) == 0;
+}
+
+}
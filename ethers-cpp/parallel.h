@@ -0,0 +1,133 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <vector>
+
+
+// A small fixed-size thread pool for splitting batch work (log decoding, signature recovery,
+// etc) across cores. Threads are started once and reused by every parallelFor() call.
+
+
+namespace EthersCpp {
+
+class ThreadPool {
+  public:
+    /// numThreads includes the thread that calls parallelFor(). 0 means one per hardware thread.
+    ThreadPool(size_t numThreads = 0) {
+        if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (size_t i = 1; i < numThreads; i++) {
+            workers.emplace_back([this]{ workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCv.notify_all();
+        for (auto &t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers.size() + 1; }
+
+    /// Calls f(i) for each i in [0, n), handing out chunks of grainSize indices to the pool's
+    /// threads and the calling thread. Returns once every call has finished. If any call throws,
+    /// the remaining chunks are skipped and the first exception is rethrown here.
+    template<typename F>
+    void parallelFor(size_t n, F &&f, size_t grainSize = 1) {
+        grainSize = std::max(grainSize, size_t(1));
+
+        if (workers.empty() || n <= grainSize) {
+            for (size_t i = 0; i < n; i++) f(i);
+            return;
+        }
+
+        std::atomic<size_t> next = 0;
+        std::atomic<bool> failed = false;
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        std::function<void()> work = [&]{
+            while (!failed.load(std::memory_order_relaxed)) {
+                size_t begin = next.fetch_add(grainSize);
+                if (begin >= n) break;
+                size_t end = std::min(n, begin + grainSize);
+
+                try {
+                    for (size_t i = begin; i < end; i++) f(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        std::lock_guard<std::mutex> dispatchLock(dispatchMutex); // one job at a time
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &work;
+            pending = workers.size();
+            generation++;
+        }
+        wakeCv.notify_all();
+
+        work();
+
+        {
+            // Every worker has to finish with work before it goes out of scope
+            std::unique_lock<std::mutex> lock(mutex);
+            doneCv.wait(lock, [&]{ return pending == 0; });
+            job = nullptr;
+        }
+
+        if (error) std::rethrow_exception(error);
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::mutex dispatchMutex;
+    std::mutex mutex;
+    std::condition_variable wakeCv, doneCv;
+    std::function<void()> *job = nullptr;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    bool stopping = false;
+
+    void workerLoop() {
+        uint64_t seen = 0;
+
+        while (true) {
+            std::function<void()> *curr;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeCv.wait(lock, [&]{ return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                curr = job;
+            }
+
+            (*curr)();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) doneCv.notify_all();
+            }
+        }
+    }
+};
+
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "hoytech/error.h"
+
+
+// Recursive Length Prefix encoding. Output is appended to a caller-owned std::string
+// so that buffers can be reused across calls. RlpReader decodes without copying: items
+// are string_views into the input.
+
+
+namespace EthersCpp {
+
+/// number of bytes needed for the big-endian representation of n (0 for n == 0)
+static inline size_t rlpByteLength(uint64_t n) {
+    size_t len = 0;
+    while (n) {
+        len++;
+        n >>= 8;
+    }
+    return len;
+}
+
+static inline size_t rlpHeaderSize(size_t payloadSize) {
+    return payloadSize < 56 ? 1 : 1 + rlpByteLength(payloadSize);
+}
+
+/// total encoded size of a string item with this content
+static inline size_t rlpStringSize(std::string_view str) {
+    if (str.size() == 1 && static_cast<uint8_t>(str[0]) < 0x80) return 1;
+    return rlpHeaderSize(str.size()) + str.size();
+}
+
+static inline size_t rlpListSize(size_t payloadSize) {
+    return rlpHeaderSize(payloadSize) + payloadSize;
+}
+
+/// Writes the header of a string (offset 0x80) or list (0xc0) into out, which needs room for 9
+/// bytes. Returns the number written.
+static inline size_t rlpWriteHeader(char *out, size_t payloadSize, uint8_t offset) {
+    if (payloadSize < 56) {
+        out[0] = static_cast<char>(offset + payloadSize);
+        return 1;
+    }
+
+    size_t lenLen = rlpByteLength(payloadSize);
+    out[0] = static_cast<char>(offset + 55 + lenLen);
+    for (size_t i = lenLen; i > 0; i--) out[lenLen - i + 1] = static_cast<char>(payloadSize >> (8 * (i - 1)));
+    return 1 + lenLen;
+}
+
+static inline void rlpAppendHeader(std::string &out, size_t payloadSize, uint8_t offset) {
+    char buf[9];
+    out.append(buf, rlpWriteHeader(buf, payloadSize, offset));
+}
+
+static inline void rlpAppendString(std::string &out, std::string_view str) {
+    if (str.size() == 1 && static_cast<uint8_t>(str[0]) < 0x80) {
+        out += str[0];
+        return;
+    }
+
+    rlpAppendHeader(out, str.size(), 0x80);
+    out += str;
+}
+
+static inline void rlpAppendListHeader(std::string &out, size_t payloadSize) {
+    rlpAppendHeader(out, payloadSize, 0xc0);
+}
+
+/// Writes the encoding of an integer into out, which needs room for 9 bytes. Returns the number written.
+static inline size_t rlpWriteUint(char *out, uint64_t n) {
+    if (n > 0 && n < 0x80) {
+        out[0] = static_cast<char>(n);
+        return 1;
+    }
+
+    size_t len = rlpByteLength(n);
+    out[0] = static_cast<char>(0x80 + len);
+    for (size_t i = 0; i < len; i++) out[1 + i] = static_cast<char>(n >> (8 * (len - i - 1)));
+    return 1 + len;
+}
+
+/// integers are encoded as big-endian strings with no leading zeros
+static inline void rlpAppendUint(std::string &out, uint64_t n) {
+    char buf[9];
+    out.append(buf, rlpWriteUint(buf, n));
+}
+
+static inline std::string rlpEncodeUint(uint64_t n) {
+    std::string out;
+    rlpAppendUint(out, n);
+    return out;
+}
+
+
+
+struct RlpItem {
+    bool isList = false;
+    std::string_view payload; // a string's contents, or the encodings of a list's items
+    std::string_view encoded; // the whole item, including its header
+};
+
+/// Reads a sequence of items, such as a list's payload. Only canonical (minimal) encodings are
+/// accepted. The input must outlive the items.
+class RlpReader {
+  public:
+    explicit RlpReader(std::string_view input) : input(input) {}
+
+    bool empty() const { return input.empty(); }
+
+    /// Everything after the items read so far
+    std::string_view rest() const { return input; }
+
+    RlpItem next() {
+        if (input.empty()) throw hoytech::error("rlp: unexpected end of input");
+
+        uint8_t b = input[0];
+        RlpItem item;
+
+        if (b < 0x80) {
+            item.payload = item.encoded = input.substr(0, 1);
+            input.remove_prefix(1);
+            return item;
+        }
+
+        item.isList = b >= 0xc0;
+        uint8_t offset = item.isList ? 0xc0 : 0x80;
+        size_t headerSize = 1, payloadSize;
+
+        if (b < offset + 56) {
+            payloadSize = b - offset;
+        } else {
+            size_t lenLen = b - offset - 55;
+            if (input.size() < 1 + lenLen) throw hoytech::error("rlp: unexpected end of input");
+            if (input[1] == 0) throw hoytech::error("rlp: non-canonical length");
+
+            payloadSize = 0;
+            for (size_t i = 0; i < lenLen; i++) payloadSize = (payloadSize << 8) | static_cast<uint8_t>(input[1 + i]);
+            if (payloadSize < 56) throw hoytech::error("rlp: non-canonical length");
+            headerSize += lenLen;
+        }
+
+        if (payloadSize > input.size() - headerSize) throw hoytech::error("rlp: unexpected end of input");
+
+        item.payload = input.substr(headerSize, payloadSize);
+        item.encoded = input.substr(0, headerSize + payloadSize);
+        if (!item.isList && payloadSize == 1 && static_cast<uint8_t>(item.payload[0]) < 0x80) throw hoytech::error("rlp: non-canonical single byte");
+
+        input.remove_prefix(headerSize + payloadSize);
+        return item;
+    }
+
+    std::string_view string() {
+        auto item = next();
+        if (item.isList) throw hoytech::error("rlp: expected string, got list");
+        return item.payload;
+    }
+
+    /// Reader over the items of the next list
+    RlpReader list() {
+        auto item = next();
+        if (!item.isList) throw hoytech::error("rlp: expected list, got string");
+        return RlpReader(item.payload);
+    }
+
+    uint64_t uint() {
+        auto str = string();
+        if (str.size() > 8) throw hoytech::error("rlp: integer too large");
+        if (str.size() && str[0] == 0) throw hoytech::error("rlp: integer has leading zeros");
+
+        uint64_t n = 0;
+        for (auto c : str) n = (n << 8) | static_cast<uint8_t>(c);
+        return n;
+    }
+
+  private:
+    std::string_view input;
+};
+
+/// The single item that makes up the whole of input
+static inline RlpItem rlpDecode(std::string_view input) {
+    RlpReader reader(input);
+    auto item = reader.next();
+    if (!reader.empty()) throw hoytech::error("rlp: trailing data");
+    return item;
+}
+
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/keccak.h"
+#include "ethers-cpp/keccakBatch.h"
+#include "ethers-cpp/rlp.h"
+#include "ethers-cpp/parallel.h"
+
+
+namespace EthersCpp {
+
+/// Computes Merkle-Patricia trie roots, such as a block's transactionsRoot and receiptsRoot.
+/** The trie shape is built first, then nodes are encoded bottom-up one level at a time so
+    that all the nodes of a level can be hashed together with keccak256Batch. Nodes and
+    scratch buffers are kept between calls, so reuse one object per thread:
+
+    EthersCpp::TrieRoot trie;
+    auto txRoot = trie.ordered(rawTransactions);  // items are indexed by rlp(i)
+    auto receiptRoot = trie.ordered(rawReceipts);
+
+    Most of the time goes on hashing, mostly the leaves, so for large tries pass a
+    ThreadPool to hash each level's nodes across its threads.
+  */
+class TrieRoot {
+  public:
+    /// Root of a trie mapping rlp(i) -> items[i], as used for transactions, receipts and withdrawals
+    Keccak256Digest ordered(std::span<const std::string_view> items) {
+        return computeOrdered(items, nullptr);
+    }
+
+    Keccak256Digest ordered(std::span<const std::string_view> items, ThreadPool &pool) {
+        return computeOrdered(items, &pool);
+    }
+
+    /// Root of a trie with arbitrary (unique) keys
+    Keccak256Digest root(std::span<const std::string_view> keys_, std::span<const std::string_view> values) {
+        return computeRoot(keys_, values, nullptr);
+    }
+
+    Keccak256Digest root(std::span<const std::string_view> keys_, std::span<const std::string_view> values, ThreadPool &pool) {
+        return computeRoot(keys_, values, &pool);
+    }
+
+  private:
+    Keccak256Digest computeOrdered(std::span<const std::string_view> items, ThreadPool *pool) {
+        keyBuffer.clear();
+        std::vector<size_t> &keyOffsets = scratchOffsets;
+        keyOffsets.clear();
+
+        for (size_t i = 0; i < items.size(); i++) {
+            keyOffsets.push_back(keyBuffer.size());
+            rlpAppendUint(keyBuffer, i);
+        }
+        keyOffsets.push_back(keyBuffer.size());
+
+        keys.clear();
+        for (size_t i = 0; i < items.size(); i++) {
+            keys.emplace_back(keyBuffer.data() + keyOffsets[i], keyOffsets[i + 1] - keyOffsets[i]);
+        }
+
+        // rlp(i) sorts as 1..127, 0, 128..n-1: single-byte encodings are below the 0x80 of
+        // rlp(0), and longer ones are big-endian behind a length prefix that grows with i.
+        order.clear();
+        for (size_t i = 1; i < std::min<size_t>(items.size(), 128); i++) order.push_back(i);
+        if (items.size()) order.push_back(0);
+        for (size_t i = 128; i < items.size(); i++) order.push_back(i);
+
+        return compute(items, pool);
+    }
+
+    Keccak256Digest computeRoot(std::span<const std::string_view> keys_, std::span<const std::string_view> values, ThreadPool *pool) {
+        if (keys_.size() != values.size()) throw hoytech::error("TrieRoot: keys and values have different sizes");
+
+        keys.assign(keys_.begin(), keys_.end());
+
+        order.clear();
+        for (size_t i = 0; i < keys.size(); i++) order.push_back(i);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){ return keys[a] < keys[b]; });
+
+        for (size_t i = 1; i < order.size(); i++) {
+            if (keys[order[i - 1]] == keys[order[i]]) throw hoytech::error("TrieRoot: duplicate key");
+        }
+
+        return compute(values, pool);
+    }
+
+    static constexpr uint32_t None = 0xFFFFFFFF;
+    static constexpr size_t parallelHashChunk = 64; // nodes per keccak256Batch call when hashing on a ThreadPool
+
+    enum class NodeKind : uint8_t { Leaf, Extension, Branch };
+
+    struct Node {
+        NodeKind kind;
+        bool refIsHash = false;
+        uint8_t refLen = 0;
+        uint32_t entry; // leaf: key/value entry; extension: entry supplying the path; branch: value entry or None
+        uint32_t depth; // first nibble of the path
+        uint32_t pathLen; // leaf and extension only
+        uint32_t height;
+        uint32_t child; // extension: child node; branch: offset into branchChildren
+        uint8_t ref[32]; // hash, or the encoding itself when shorter than 32 bytes
+    };
+
+    std::vector<std::string_view> keys;
+    std::vector<uint32_t> order;
+    std::string keyBuffer;
+    std::vector<size_t> scratchOffsets;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> branchChildren;
+    std::vector<uint32_t> levelCounts;
+    std::vector<uint32_t> levelNodes;
+    std::vector<uint32_t> levelPos;
+
+    std::string encoded;
+    std::string hexPrefixScratch;
+    std::vector<uint32_t> hashNodes;
+    std::vector<std::string_view> hashInputs;
+    std::vector<Keccak256Digest> hashOutputs;
+
+
+    size_t numNibbles(uint32_t entry) const {
+        return keys[entry].size() * 2;
+    }
+
+    uint8_t nibble(uint32_t entry, size_t pos) const {
+        uint8_t b = static_cast<uint8_t>(keys[entry][pos / 2]);
+        return pos % 2 == 0 ? b >> 4 : b & 0x0F;
+    }
+
+    Keccak256Digest compute(std::span<const std::string_view> values, ThreadPool *pool) {
+        if (order.empty()) {
+            return keccak256Digest(std::string_view("\x80", 1));
+        }
+
+        nodes.clear();
+        branchChildren.clear();
+
+        uint32_t rootIndex = build(0, order.size(), 0);
+        uint32_t maxHeight = nodes[rootIndex].height;
+
+        // bucket nodes by height so each level can be encoded and hashed together
+
+        levelCounts.assign(maxHeight + 2, 0);
+        for (auto &n : nodes) levelCounts[n.height + 1]++;
+        for (size_t i = 1; i < levelCounts.size(); i++) levelCounts[i] += levelCounts[i - 1];
+
+        levelNodes.resize(nodes.size());
+        levelPos.assign(levelCounts.begin(), levelCounts.end());
+        for (uint32_t i = 0; i < nodes.size(); i++) levelNodes[levelPos[nodes[i].height]++] = i;
+
+        for (uint32_t h = 0; h <= maxHeight; h++) {
+            encoded.clear();
+            hashNodes.clear();
+            scratchOffsets.clear();
+
+            for (uint32_t i = levelCounts[h]; i < levelCounts[h + 1]; i++) {
+                uint32_t nodeIndex = levelNodes[i];
+                auto &node = nodes[nodeIndex];
+                size_t start = encoded.size();
+
+                encodeNode(node, values);
+
+                size_t len = encoded.size() - start;
+
+                if (len >= 32 || nodeIndex == rootIndex) {
+                    hashNodes.push_back(nodeIndex);
+                    scratchOffsets.push_back(start);
+                    scratchOffsets.push_back(len);
+                } else {
+                    memcpy(node.ref, encoded.data() + start, len);
+                    node.refLen = len;
+                    node.refIsHash = false;
+                }
+            }
+
+            hashInputs.clear();
+            for (size_t i = 0; i < hashNodes.size(); i++) {
+                hashInputs.emplace_back(encoded.data() + scratchOffsets[i * 2], scratchOffsets[i * 2 + 1]);
+            }
+
+            hashOutputs.resize(hashInputs.size());
+
+            if (pool && hashInputs.size() > parallelHashChunk) {
+                std::span<const std::string_view> inputs = hashInputs;
+                std::span<Keccak256Digest> outputs = hashOutputs;
+
+                pool->parallelFor((inputs.size() + parallelHashChunk - 1) / parallelHashChunk, [&](size_t chunk){
+                    size_t begin = chunk * parallelHashChunk;
+                    size_t n = std::min(parallelHashChunk, inputs.size() - begin);
+                    keccak256Batch(inputs.subspan(begin, n), outputs.subspan(begin, n));
+                });
+            } else {
+                keccak256Batch(hashInputs, hashOutputs);
+            }
+
+            for (size_t i = 0; i < hashNodes.size(); i++) {
+                auto &node = nodes[hashNodes[i]];
+                memcpy(node.ref, hashOutputs[i].data(), 32);
+                node.refLen = 32;
+                node.refIsHash = true;
+            }
+        }
+
+        Keccak256Digest output;
+        memcpy(output.data(), nodes[rootIndex].ref, 32);
+        return output;
+    }
+
+    static Keccak256Digest keccak256Digest(std::string_view input) {
+        auto h = keccak256(input);
+        Keccak256Digest output;
+        memcpy(output.data(), h.data(), 32);
+        return output;
+    }
+
+    uint32_t addNode(NodeKind kind, uint32_t entry, size_t depth, size_t pathLen) {
+        Node n;
+        n.kind = kind;
+        n.entry = entry;
+        n.depth = depth;
+        n.pathLen = pathLen;
+        n.height = 0;
+        n.child = None;
+        nodes.push_back(n);
+        return nodes.size() - 1;
+    }
+
+    // Builds the sub-trie for the sorted entries order[lo..hi), which share their first depth nibbles
+    uint32_t build(size_t lo, size_t hi, size_t depth) {
+        uint32_t first = order[lo];
+
+        if (hi - lo == 1) {
+            return addNode(NodeKind::Leaf, first, depth, numNibbles(first) - depth);
+        }
+
+        uint32_t last = order[hi - 1];
+
+        size_t maxCommon = std::min(numNibbles(first), numNibbles(last));
+        size_t common = depth;
+        while (common < maxCommon && nibble(first, common) == nibble(last, common)) common++;
+
+        if (common > depth) {
+            uint32_t index = addNode(NodeKind::Extension, first, depth, common - depth);
+            uint32_t child = build(lo, hi, common);
+            nodes[index].child = child;
+            nodes[index].height = nodes[child].height + 1;
+            return index;
+        }
+
+        uint32_t index = addNode(NodeKind::Branch, None, depth, 0);
+
+        if (numNibbles(first) == depth) {
+            nodes[index].entry = first; // key ends here, so its value lives in the branch
+            lo++;
+        }
+
+        uint32_t childrenOffset = branchChildren.size();
+        branchChildren.resize(childrenOffset + 16, None);
+        nodes[index].child = childrenOffset;
+
+        uint32_t height = 0;
+
+        while (lo < hi) {
+            uint8_t n = nibble(order[lo], depth);
+            size_t end = lo + 1;
+            while (end < hi && nibble(order[end], depth) == n) end++;
+
+            uint32_t child = build(lo, end, depth + 1);
+            branchChildren[childrenOffset + n] = child;
+            height = std::max(height, nodes[child].height);
+
+            lo = end;
+        }
+
+        nodes[index].height = height + 1;
+
+        return index;
+    }
+
+    std::string_view hexPrefix(const Node &node, bool leaf) {
+        hexPrefixScratch.clear();
+
+        size_t pos = node.depth;
+        size_t end = node.depth + node.pathLen;
+        uint8_t flag = leaf ? 2 : 0;
+
+        if (node.pathLen % 2) {
+            hexPrefixScratch += static_cast<char>(((flag + 1) << 4) | nibble(node.entry, pos++));
+        } else {
+            hexPrefixScratch += static_cast<char>(flag << 4);
+        }
+
+        for (; pos < end; pos += 2) {
+            hexPrefixScratch += static_cast<char>((nibble(node.entry, pos) << 4) | nibble(node.entry, pos + 1));
+        }
+
+        return hexPrefixScratch;
+    }
+
+    size_t refSize(uint32_t nodeIndex) const {
+        if (nodeIndex == None) return 1;
+        auto &n = nodes[nodeIndex];
+        return n.refIsHash ? 33 : n.refLen;
+    }
+
+    void appendRef(uint32_t nodeIndex) {
+        if (nodeIndex == None) {
+            encoded += '\x80';
+            return;
+        }
+
+        auto &n = nodes[nodeIndex];
+        if (n.refIsHash) encoded += '\xa0';
+        encoded.append(reinterpret_cast<const char*>(n.ref), n.refLen);
+    }
+
+    void encodeNode(const Node &node, std::span<const std::string_view> values) {
+        if (node.kind == NodeKind::Leaf) {
+            auto path = hexPrefix(node, true);
+            auto value = values[node.entry];
+            rlpAppendListHeader(encoded, rlpStringSize(path) + rlpStringSize(value));
+            rlpAppendString(encoded, path);
+            rlpAppendString(encoded, value);
+        } else if (node.kind == NodeKind::Extension) {
+            auto path = hexPrefix(node, false);
+            rlpAppendListHeader(encoded, rlpStringSize(path) + refSize(node.child));
+            rlpAppendString(encoded, path);
+            appendRef(node.child);
+        } else {
+            std::string_view value;
+            if (node.entry != None) value = values[node.entry];
+
+            size_t payloadSize = rlpStringSize(value);
+            for (size_t i = 0; i < 16; i++) payloadSize += refSize(branchChildren[node.child + i]);
+
+            rlpAppendListHeader(encoded, payloadSize);
+            for (size_t i = 0; i < 16; i++) appendRef(branchChildren[node.child + i]);
+            rlpAppendString(encoded, value);
+        }
+    }
+};
+
+
+/// Convenience wrapper, see TrieRoot::ordered
+static inline Keccak256Digest orderedTrieRoot(std::span<const std::string_view> items) {
+    TrieRoot trie;
+    return trie.ordered(items);
+}
+
+}
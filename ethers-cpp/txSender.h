@@ -0,0 +1,199 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <span>
+#include <optional>
+#include <atomic>
+#include <cstring>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/keccak.h"
+#include "ethers-cpp/bytes.h"
+#include "ethers-cpp/rlp.h"
+#include "ethers-cpp/parallel.h"
+#include "ethers-cpp/ecrecover.h"
+
+
+// Recovers the senders of raw signed transactions, as returned by eth_getRawTransactionByHash or
+// found in a block body:
+//
+//     auto txs = blockTransactions(blockRlp);
+//     std::vector<Address> senders(txs.size());
+//     std::vector<uint8_t> ok(txs.size());
+//     recoverSenders(txs, senders, ok, pool);
+//
+// Supports legacy (with or without EIP-155 replay protection), EIP-2930, EIP-1559, EIP-4844 and
+// EIP-7702 transactions. The signing payload is hashed straight out of the raw transaction, so
+// nothing is copied or allocated per transaction.
+
+
+namespace EthersCpp {
+
+struct TxSignature {
+    Bytes32 signingHash;
+    Bytes32 r;
+    Bytes32 s;
+    uint8_t recoveryId;
+};
+
+namespace txSenderDetail {
+    static inline Bytes32 word(std::string_view v) {
+        if (v.size() > 32) throw hoytech::error("transaction signature value too large");
+        if (v.size() && v[0] == 0) throw hoytech::error("transaction signature value has leading zeros");
+
+        Bytes32 output{};
+        memcpy(output.data() + 32 - v.size(), v.data(), v.size());
+        return output;
+    }
+
+    // Number of fields in a typed transaction's RLP list, including yParity, r and s
+    static inline size_t typedTxNumFields(uint8_t type) {
+        switch (type) {
+            case 0x01: return 11; // EIP-2930: chainId, nonce, gasPrice, gasLimit, to, value, data, accessList
+            case 0x02: return 12; // EIP-1559: chainId, nonce, maxPriorityFeePerGas, maxFeePerGas, gasLimit, to, value, data, accessList
+            case 0x03: return 14; // EIP-4844: ... accessList, maxFeePerBlobGas, blobVersionedHashes
+            case 0x04: return 13; // EIP-7702: ... accessList, authorizationList
+            default: throw hoytech::error("unsupported transaction type: ", int(type));
+        }
+    }
+}
+
+/// Signing hash and signature of a raw transaction. Throws if it's malformed or of an unknown type.
+static inline TxSignature txSignature(std::string_view rawTx) {
+    if (rawTx.empty()) throw hoytech::error("empty transaction");
+
+    TxSignature output;
+    Keccak k;
+    char header[9];
+    uint8_t type = rawTx[0];
+
+    if (type >= 0xc0) {
+        // Legacy: [nonce, gasPrice, gasLimit, to, value, data, v, r, s]
+        auto tx = rlpDecode(rawTx);
+        RlpReader fields(tx.payload);
+        for (size_t i = 0; i < 6; i++) fields.next();
+        auto unsignedFields = tx.payload.substr(0, tx.payload.size() - fields.rest().size());
+
+        uint64_t v = fields.uint();
+        output.r = txSenderDetail::word(fields.string());
+        output.s = txSenderDetail::word(fields.string());
+        if (!fields.empty()) throw hoytech::error("too many transaction fields");
+
+        if (v == 27 || v == 28) {
+            output.recoveryId = v - 27;
+            k.add(header, rlpWriteHeader(header, unsignedFields.size(), 0xc0));
+            k.add(unsignedFields.data(), unsignedFields.size());
+        } else if (v >= 35) {
+            // EIP-155: v is chainId * 2 + 35 + recoveryId, and chainId, 0, 0 are signed in place of v, r, s
+            output.recoveryId = (v - 35) % 2;
+
+            char extra[11];
+            size_t extraSize = rlpWriteUint(extra, (v - 35) / 2);
+            extra[extraSize++] = '\x80';
+            extra[extraSize++] = '\x80';
+
+            k.add(header, rlpWriteHeader(header, unsignedFields.size() + extraSize, 0xc0));
+            k.add(unsignedFields.data(), unsignedFields.size());
+            k.add(extra, extraSize);
+        } else {
+            throw hoytech::error("bad transaction v: ", v);
+        }
+    } else {
+        // Typed: type || rlp([...fields, yParity, r, s]), where type || rlp([...fields]) is signed
+        size_t numFields = txSenderDetail::typedTxNumFields(type);
+        auto tx = rlpDecode(rawTx.substr(1));
+        if (!tx.isList) throw hoytech::error("typed transaction is not a list");
+
+        RlpReader fields(tx.payload);
+
+        // EIP-4844 network form: [tx, blobs, commitments, proofs]
+        if (type == 0x03 && !fields.empty() && static_cast<uint8_t>(fields.rest()[0]) >= 0xc0) {
+            tx = fields.next();
+            fields = RlpReader(tx.payload);
+        }
+
+        for (size_t i = 0; i < numFields - 3; i++) fields.next();
+        auto unsignedFields = tx.payload.substr(0, tx.payload.size() - fields.rest().size());
+
+        uint64_t yParity = fields.uint();
+        if (yParity > 1) throw hoytech::error("bad transaction yParity: ", yParity);
+        output.recoveryId = yParity;
+        output.r = txSenderDetail::word(fields.string());
+        output.s = txSenderDetail::word(fields.string());
+        if (!fields.empty()) throw hoytech::error("too many transaction fields");
+
+        k.add(&type, 1);
+        k.add(header, rlpWriteHeader(header, unsignedFields.size(), 0xc0));
+        k.add(unsignedFields.data(), unsignedFields.size());
+    }
+
+    k.getHash(output.signingHash.data());
+    return output;
+}
+
+/// Sender of a raw transaction, or nullopt if it's malformed or its signature doesn't recover
+static inline std::optional<Address> recoverSender(std::string_view rawTx) {
+    try {
+        auto sig = txSignature(rawTx);
+        Address output;
+        if (ecrecoverDetail::recover(secp256k1ctx, sig.signingHash.data(), sig.recoveryId, sig.r.data(), sig.s.data(), output.data())) return std::nullopt;
+        return output;
+    } catch (std::exception &) {
+        return std::nullopt;
+    }
+}
+
+/// Recovers the sender of each raw transaction into senders[i], on pool's threads. ok[i] is set to
+/// 1 if it recovered, else 0 and senders[i] is zeroed (see recoverSender()). Returns the number
+/// that failed.
+static inline size_t recoverSenders(std::span<const std::string_view> rawTxs, std::span<Address> senders, std::span<uint8_t> ok, ThreadPool &pool) {
+    if (senders.size() != rawTxs.size() || ok.size() != rawTxs.size()) throw hoytech::error("recoverSenders: spans have different sizes");
+
+    std::atomic<size_t> numFailed = 0;
+
+    pool.parallelFor(rawTxs.size(), [&](size_t i){
+        try {
+            auto sig = txSignature(rawTxs[i]);
+            ok[i] = !ecrecoverDetail::recover(ecrecoverDetail::threadContext(), sig.signingHash.data(), sig.recoveryId, sig.r.data(), sig.s.data(), senders[i].data());
+        } catch (std::exception &) {
+            ok[i] = 0;
+        }
+
+        if (!ok[i]) {
+            senders[i] = Address();
+            numFailed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }, 16);
+
+    return numFailed;
+}
+
+/// numThreads of 0 means one per hardware thread
+static inline size_t recoverSenders(std::span<const std::string_view> rawTxs, std::span<Address> senders, std::span<uint8_t> ok, size_t numThreads = 0) {
+    ThreadPool pool(numThreads);
+    return recoverSenders(rawTxs, senders, ok, pool);
+}
+
+/// The raw transactions in an RLP-encoded block ([header, transactions, ...]), pointing into it.
+/// Legacy transactions are embedded as lists, typed ones as strings holding type || rlp(...).
+static inline std::vector<std::string_view> blockTransactions(std::string_view blockRlp) {
+    auto blockItem = rlpDecode(blockRlp);
+    if (!blockItem.isList) throw hoytech::error("block is not a list");
+
+    RlpReader block(blockItem.payload);
+    block.list(); // header
+    auto txs = block.list();
+
+    std::vector<std::string_view> output;
+
+    while (!txs.empty()) {
+        auto item = txs.next();
+        output.push_back(item.isList ? item.encoded : item.payload);
+    }
+
+    return output;
+}
+
+}
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <compare>
+#include <algorithm>
+#include <charconv>
+#include <bit>
+#include <cstring>
+#include <cstdint>
+
+#include "hoytech/error.h"
+
+
+// Fixed-width 256-bit integers for ABI and storage words. Values live on the stack as four
+// 64-bit limbs, so loading, storing and formatting a word never allocates (apart from the
+// returned std::string, which toChars() avoids). See uint256Gmp.h for conversions to and from mpz_class.
+
+
+namespace EthersCpp {
+
+struct uint256 {
+    std::array<uint64_t, 4> limbs{}; // least significant limb first
+
+    constexpr uint256() = default;
+    constexpr uint256(uint64_t v) : limbs{v, 0, 0, 0} {}
+
+    /// Big-endian bytes of up to 32 bytes (shorter inputs are zero-extended)
+    static uint256 fromBigEndian(std::string_view bytes) {
+        if (bytes.size() > 32) throw hoytech::error("uint256 input exceeds 32 bytes");
+
+        uint8_t buf[32] = {};
+        memcpy(buf + 32 - bytes.size(), bytes.data(), bytes.size());
+        return fromBigEndian(buf);
+    }
+
+    static uint256 fromBigEndian(const uint8_t *p) {
+        uint256 v;
+        for (size_t i = 0; i < 4; i++) v.limbs[3 - i] = loadBE64(p + i * 8);
+        return v;
+    }
+
+    /// Writes 32 big-endian bytes to out
+    void toBigEndian(uint8_t *out) const {
+        for (size_t i = 0; i < 4; i++) storeBE64(out + i * 8, limbs[3 - i]);
+    }
+
+    /// Big-endian bytes, left-padded to numBytes. Throws if the value doesn't fit.
+    std::string toBytes(size_t numBytes = 32) const {
+        if (numBytes > 32 || (numBytes < 32 && (*this >> (numBytes * 8)) != 0)) throw hoytech::error("input exceeds numBytes");
+
+        uint8_t buf[32];
+        toBigEndian(buf);
+        return std::string(reinterpret_cast<const char*>(buf) + 32 - numBytes, numBytes);
+    }
+
+    /// Decimal, or hex with a 0x prefix. Returns false on invalid input or overflow.
+    static bool parse(std::string_view s, uint256 &out) {
+        out = uint256();
+        if (s.empty()) return false;
+
+        if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+            s = s.substr(2);
+            if (s.size() > 64) return false;
+
+            for (char c : s) {
+                int d;
+                if (c >= '0' && c <= '9') d = c - '0';
+                else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') d = c - 'A' + 10;
+                else return false;
+                out = (out << 4);
+                out.limbs[0] |= d;
+            }
+
+            return true;
+        }
+
+        // 19 decimal digits at a time fit in one limb
+        while (!s.empty()) {
+            size_t n = std::min(s.size(), size_t(19));
+            uint64_t chunk = 0, scale = 1;
+
+            for (size_t i = 0; i < n; i++) {
+                char c = s[i];
+                if (c < '0' || c > '9') return false;
+                chunk = chunk * 10 + (c - '0');
+                scale *= 10;
+            }
+
+            if (!out.mulAdd(scale, chunk)) return false;
+            s = s.substr(n);
+        }
+
+        return true;
+    }
+
+    static uint256 fromString(std::string_view s) {
+        uint256 v;
+        if (!parse(s, v)) throw hoytech::error("invalid uint256: ", s);
+        return v;
+    }
+
+    static constexpr size_t maxDecimalDigits = 78;
+
+    /// Writes the decimal form (at most maxDecimalDigits) to out, and returns its length
+    size_t toChars(char *out) const {
+        if (fitsUint64()) return std::to_chars(out, out + maxDecimalDigits, limbs[0]).ptr - out;
+
+        static constexpr uint64_t tenTo19 = 10'000'000'000'000'000'000ULL;
+
+        // At most 78 decimal digits, ie 5 chunks of 19
+        uint64_t chunks[5];
+        size_t numChunks = 0;
+        uint256 v = *this;
+        while (!v.isZero()) chunks[numChunks++] = v.divModSmall(tenTo19);
+
+        char *p = std::to_chars(out, out + maxDecimalDigits, chunks[numChunks - 1]).ptr;
+
+        for (size_t i = numChunks - 1; i > 0; i--) {
+            uint64_t c = chunks[i - 1];
+            for (size_t j = 19; j > 0; j--) {
+                p[j - 1] = '0' + c % 10;
+                c /= 10;
+            }
+            p += 19;
+        }
+
+        return p - out;
+    }
+
+    std::string toString() const {
+        char buf[maxDecimalDigits];
+        return std::string(buf, toChars(buf));
+    }
+
+    constexpr bool isZero() const { return (limbs[0] | limbs[1] | limbs[2] | limbs[3]) == 0; }
+    constexpr bool fitsUint64() const { return (limbs[1] | limbs[2] | limbs[3]) == 0; }
+    constexpr bool bit(size_t n) const { return (limbs[n / 64] >> (n % 64)) & 1; }
+
+    /// Only meaningful if fitsUint64()
+    constexpr uint64_t low64() const { return limbs[0]; }
+
+    /// this = this * m + a. Returns false (leaving this truncated) on overflow.
+    constexpr bool mulAdd(uint64_t m, uint64_t a) {
+        uint64_t carry = a;
+        for (size_t i = 0; i < 4; i++) {
+            unsigned __int128 cur = static_cast<unsigned __int128>(limbs[i]) * m + carry;
+            limbs[i] = static_cast<uint64_t>(cur);
+            carry = static_cast<uint64_t>(cur >> 64);
+        }
+        return carry == 0;
+    }
+
+    /// this = this / d, returns this % d
+    constexpr uint64_t divModSmall(uint64_t d) {
+        unsigned __int128 rem = 0;
+        for (size_t i = 4; i > 0; i--) {
+            unsigned __int128 cur = (rem << 64) | limbs[i - 1];
+            limbs[i - 1] = static_cast<uint64_t>(cur / d);
+            rem = cur % d;
+        }
+        return static_cast<uint64_t>(rem);
+    }
+
+
+    friend constexpr bool operator==(const uint256 &a, const uint256 &b) = default;
+
+    friend constexpr std::strong_ordering operator<=>(const uint256 &a, const uint256 &b) {
+        for (size_t i = 4; i > 0; i--) {
+            if (a.limbs[i - 1] != b.limbs[i - 1]) return a.limbs[i - 1] <=> b.limbs[i - 1];
+        }
+        return std::strong_ordering::equal;
+    }
+
+    // Arithmetic wraps modulo 2**256
+
+    friend constexpr uint256 operator+(const uint256 &a, const uint256 &b) {
+        uint256 r;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < 4; i++) {
+            unsigned __int128 sum = static_cast<unsigned __int128>(a.limbs[i]) + b.limbs[i] + carry;
+            r.limbs[i] = static_cast<uint64_t>(sum);
+            carry = static_cast<uint64_t>(sum >> 64);
+        }
+        return r;
+    }
+
+    friend constexpr uint256 operator-(const uint256 &a, const uint256 &b) {
+        return a + -b;
+    }
+
+    constexpr uint256 operator~() const {
+        uint256 r;
+        for (size_t i = 0; i < 4; i++) r.limbs[i] = ~limbs[i];
+        return r;
+    }
+
+    /// Two's complement negation
+    constexpr uint256 operator-() const {
+        return ~*this + uint256(1);
+    }
+
+    friend constexpr uint256 operator<<(const uint256 &a, size_t n) {
+        uint256 r;
+        if (n >= 256) return r;
+        size_t limbShift = n / 64, bitShift = n % 64;
+        for (size_t i = 4; i > limbShift; i--) {
+            size_t dst = i - 1, src = dst - limbShift;
+            r.limbs[dst] = a.limbs[src] << bitShift;
+            if (bitShift && src > 0) r.limbs[dst] |= a.limbs[src - 1] >> (64 - bitShift);
+        }
+        return r;
+    }
+
+    friend constexpr uint256 operator>>(const uint256 &a, size_t n) {
+        uint256 r;
+        if (n >= 256) return r;
+        size_t limbShift = n / 64, bitShift = n % 64;
+        for (size_t dst = 0; dst + limbShift < 4; dst++) {
+            size_t src = dst + limbShift;
+            r.limbs[dst] = a.limbs[src] >> bitShift;
+            if (bitShift && src < 3) r.limbs[dst] |= a.limbs[src + 1] << (64 - bitShift);
+        }
+        return r;
+    }
+
+  private:
+    static uint64_t loadBE64(const uint8_t *p) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        if constexpr (std::endian::native == std::endian::little) v = __builtin_bswap64(v);
+        return v;
+    }
+
+    static void storeBE64(uint8_t *p, uint64_t v) {
+        if constexpr (std::endian::native == std::endian::little) v = __builtin_bswap64(v);
+        memcpy(p, &v, 8);
+    }
+};
+
+
+/// Signed 256-bit integer, stored as the two's complement bit pattern
+struct int256 {
+    uint256 bits;
+
+    constexpr int256() = default;
+    constexpr int256(int64_t v) : bits(static_cast<uint64_t>(v)) {
+        if (v < 0) bits.limbs[1] = bits.limbs[2] = bits.limbs[3] = ~uint64_t(0);
+    }
+
+    static constexpr int256 fromBits(const uint256 &bits) {
+        int256 v;
+        v.bits = bits;
+        return v;
+    }
+
+    /// Big-endian two's complement of up to 32 bytes, sign-extended from the top bit of the input
+    static int256 fromBigEndian(std::string_view bytes) {
+        if (bytes.size() > 32) throw hoytech::error("int256 input exceeds 32 bytes");
+
+        uint8_t buf[32];
+        bool negative = bytes.size() && (static_cast<uint8_t>(bytes[0]) & 0x80);
+        memset(buf, negative ? 0xFF : 0, 32 - bytes.size());
+        memcpy(buf + 32 - bytes.size(), bytes.data(), bytes.size());
+        return fromBits(uint256::fromBigEndian(buf));
+    }
+
+    constexpr bool isNegative() const { return bits.bit(255); }
+
+    /// Absolute value. Correct for -2**255 too, since the result is unsigned.
+    constexpr uint256 magnitude() const { return isNegative() ? -bits : bits; }
+
+    /// Decimal with optional leading '-', or 0x hex (non-negative). Returns false on invalid input
+    /// or if the value is outside [-2**255, 2**255 - 1].
+    static bool parse(std::string_view s, int256 &out) {
+        bool negative = s.starts_with("-");
+        if (negative) s = s.substr(1);
+
+        uint256 mag;
+        if (!uint256::parse(s, mag)) return false;
+
+        if (negative) {
+            if (mag > (uint256(1) << 255)) return false;
+            out = fromBits(-mag);
+        } else {
+            if (mag.bit(255)) return false;
+            out = fromBits(mag);
+        }
+
+        return true;
+    }
+
+    static int256 fromString(std::string_view s) {
+        int256 v;
+        if (!parse(s, v)) throw hoytech::error("invalid int256: ", s);
+        return v;
+    }
+
+    /// Writes the decimal form (at most uint256::maxDecimalDigits + 1) to out, and returns its length
+    size_t toChars(char *out) const {
+        if (isNegative()) {
+            *out = '-';
+            return 1 + magnitude().toChars(out + 1);
+        }
+        return bits.toChars(out);
+    }
+
+    std::string toString() const {
+        char buf[uint256::maxDecimalDigits + 1];
+        return std::string(buf, toChars(buf));
+    }
+
+    friend constexpr bool operator==(const int256 &a, const int256 &b) = default;
+
+    friend constexpr std::strong_ordering operator<=>(const int256 &a, const int256 &b) {
+        if (a.isNegative() != b.isNegative()) return a.isNegative() ? std::strong_ordering::less : std::strong_ordering::greater;
+        return a.bits <=> b.bits;
+    }
+};
+
+}
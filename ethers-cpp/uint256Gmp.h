@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <gmpxx.h>
+
+#include "hoytech/error.h"
+
+#include "ethers-cpp/uint256.h"
+
+
+// Interop between uint256/int256 and GMP, plus the mpz_class helpers that SolidityAbi.h
+// used to provide. Only include this if you link against gmp and gmpxx.
+
+
+namespace EthersCpp {
+
+static inline mpz_class toMpz(const uint256 &v) {
+    mpz_class num;
+    mpz_import(num.get_mpz_t(), 4, -1, sizeof(uint64_t), 0, 0, v.limbs.data());
+    return num;
+}
+
+static inline mpz_class toMpz(const int256 &v) {
+    mpz_class num = toMpz(v.magnitude());
+    if (v.isNegative()) num = -num;
+    return num;
+}
+
+static inline uint256 uint256FromMpz(const mpz_class &num) {
+    if (num < 0) throw hoytech::error("value for uint is negative: ", num.get_str());
+    if (mpz_sizeinbase(num.get_mpz_t(), 2) > 256) throw hoytech::error("input exceeds numBytes");
+
+    uint256 v;
+    mpz_export(v.limbs.data(), nullptr, -1, sizeof(uint64_t), 0, 0, num.get_mpz_t());
+    return v;
+}
+
+static inline int256 int256FromMpz(const mpz_class &num) {
+    mpz_class mag = abs(num);
+    auto v = uint256FromMpz(mag);
+    if (num < 0) {
+        if (v > (uint256(1) << 255)) throw hoytech::error("input exceeds numBytes");
+        return int256::fromBits(-v);
+    }
+    if (v.bit(255)) throw hoytech::error("input exceeds numBytes");
+    return int256::fromBits(v);
+}
+
+
+static mpz_class twoToThe256 = mpz_class("115792089237316195423570985008687907853269984665640564039457584007913129639936");
+
+static inline std::string normaliseMpz(mpz_class &num, size_t numBytes = 32) {
+    return uint256FromMpz(num).toBytes(numBytes);
+}
+
+static inline std::string normaliseSignedMpz(mpz_class &numMpz, size_t numBytes = 32) {
+    if (numMpz < 0) numMpz += twoToThe256;
+
+    return normaliseMpz(numMpz, numBytes);
+}
+
+static inline mpz_class convertToMpz(std::string_view str) {
+    mpz_class num;
+    if (str.size()) mpz_import(num.get_mpz_t(), str.size(), 1, 1, 1, 0, str.data());
+    return num;
+}
+
+static inline mpz_class convertToMpzSigned(std::string_view str) {
+    auto num = convertToMpz(str);
+
+    if (mpz_tstbit(num.get_mpz_t(), 255)) {
+        return -(twoToThe256 - num);
+    }
+
+    return num;
+}
+
+}
@@ -2,48 +2,713 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <memory_resource>
 
 #include <tao/json.hpp>
 
 #include "hoytech/hex.h"
 #include "hoytech/error.h"
 #include "ethers-cpp/keccak.h"
+#include "ethers-cpp/keccakBatch.h"
+#include "ethers-cpp/keccakConstexpr.h"
+#include "ethers-cpp/trieRoot.h"
+#include "ethers-cpp/StorageLayout.h"
+#include "ethers-cpp/createAddress.h"
 #include "ethers-cpp/SolidityAbi.h"
+#include "ethers-cpp/AbiRegistry.h"
+#include "ethers-cpp/Multicall.h"
+#include "ethers-cpp/Eip712.h"
 #include "ethers-cpp/ecrecover.h"
+#include "ethers-cpp/txSender.h"
+#include "ethers-cpp/uint256Gmp.h"
+
+
+static_assert(EthersCpp::selector("transfer(address,uint256)") == 0xa9059cbb);
+static_assert(EthersCpp::eventTopicPrefix("Transfer(address,address,uint256)") == 0xddf252ad1be2c89bULL);
+static_assert(EthersCpp::eventTopic("").at(0) == 0xc5 && EthersCpp::eventTopic("").at(31) == 0x70);
+
+
+// Typed decoding: mirrors of TestContract's structs, printed back as JSON positionally (tuples
+// and structs become arrays). std::string_view is used for bytes fields and printed as hex.
+
+struct MyNestedStruct {
+    EthersCpp::Address addr;
+    std::vector<EthersCpp::uint256> nums;
+    static constexpr auto abiFields() { return std::make_tuple(&MyNestedStruct::addr, &MyNestedStruct::nums); }
+};
+
+struct MyDynStruct {
+    EthersCpp::uint256 a;
+    uint64_t b;
+    std::string str;
+    MyNestedStruct nested;
+    static constexpr auto abiFields() { return std::make_tuple(&MyDynStruct::a, &MyDynStruct::b, &MyDynStruct::str, &MyDynStruct::nested); }
+};
+
+struct MyStaticStruct {
+    std::array<EthersCpp::uint256, 2> s1;
+    EthersCpp::Address s2;
+    EthersCpp::Bytes32 s3;
+};
+
+template<>
+struct EthersCpp::AbiFields<MyStaticStruct> {
+    static constexpr auto fields() { return std::make_tuple(&MyStaticStruct::s1, &MyStaticStruct::s2, &MyStaticStruct::s3); }
+};
+
+using KitchenSink = std::tuple<uint64_t, std::vector<EthersCpp::uint256>, EthersCpp::uint256, std::array<uint32_t, 4>, std::string, std::string_view,
+                               EthersCpp::Bytes32, EthersCpp::FixedBytes<12>, MyDynStruct, bool, MyStaticStruct>;
+
+struct TransferEvent {
+    EthersCpp::Address from;
+    EthersCpp::Address to;
+    EthersCpp::uint256 value;
+    static constexpr auto abiFields() { return std::make_tuple(&TransferEvent::from, &TransferEvent::to, &TransferEvent::value); }
+};
+
+using EncodeStruct2 = std::tuple<uint64_t, std::string>;
+using EncodeStruct3 = std::tuple<std::array<EncodeStruct2, 4>>;
+
+// The Mail example from EIP-712, for typed hashing
+
+struct Eip712Person {
+    std::string name;
+    EthersCpp::Address wallet;
+    static constexpr auto abiFields() { return std::make_tuple(&Eip712Person::name, &Eip712Person::wallet); }
+};
+
+struct Eip712Mail {
+    Eip712Person from;
+    Eip712Person to;
+    std::string contents;
+    static constexpr auto abiFields() { return std::make_tuple(&Eip712Mail::from, &Eip712Mail::to, &Eip712Mail::contents); }
+};
+
+template<typename T>
+static tao::json::value typedToJson(const T &v) {
+    using namespace EthersCpp;
+
+    if constexpr (std::is_same_v<T, uint256> || std::is_same_v<T, int256>) {
+        return v.toString();
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return v;
+    } else if constexpr (std::is_integral_v<T>) {
+        return std::to_string(v);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return v;
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+        return toHex(v, true);
+    } else if constexpr (requires { AbiCodec<T>::numFields(); }) {
+        tao::json::value arr = tao::json::empty_array;
+        AbiCodec<T>::forEachField(const_cast<T&>(v), [&](size_t, auto &f){ arr.push_back(typedToJson(f)); });
+        return arr;
+    } else if constexpr (std::is_same_v<typename T::value_type, uint8_t>) {
+        return toHex(asStringView(v), true);
+    } else {
+        tao::json::value arr = tao::json::empty_array;
+        for (const auto &e : v) arr.push_back(typedToJson(e));
+        return arr;
+    }
+}
+
+static EthersCpp::AbiDecodeLimits decodeLimitsFromJson(std::string_view json) {
+    auto limitsJson = tao::json::from_string(json);
+
+    EthersCpp::AbiDecodeLimits limits;
+    if (auto *v = limitsJson.find("maxElements")) limits.maxElements = v->as<uint64_t>();
+    if (auto *v = limitsJson.find("maxBytes")) limits.maxBytes = v->as<uint64_t>();
+    if (auto *v = limitsJson.find("maxDepth")) limits.maxDepth = v->as<uint64_t>();
+    if (auto *v = limitsJson.find("strictOffsets")) limits.strictOffsets = v->get_boolean();
+    return limits;
+}
 
 
 int main(int argc, char **argv) {
     std::string abiStr;
 
     {
-        std::ifstream input("artifacts/TestContract.abi");
+        // With ABI_JSON set, commands use that JSON ABI instead of TestContract's
+        auto *abiJson = getenv("ABI_JSON");
+        std::ifstream input(abiJson ? abiJson : "artifacts/TestContract.abi");
         std::stringstream sstr;
         while(input >> sstr.rdbuf());
         abiStr = sstr.str();
     }
 
-    EthersCpp::SolidityAbi abi(abiStr);
+    // With ABI_BINARY set, commands use the binary ABI written by compileAbi instead
+    auto *abiBinary = getenv("ABI_BINARY");
+    EthersCpp::SolidityAbi abi = abiBinary ? EthersCpp::SolidityAbi(EthersCpp::AbiFile::open(abiBinary)) : EthersCpp::SolidityAbi(abiStr);
 
     if (argc < 2) throw hoytech::error("invalid usage");
 
     std::string cmd(argv[1]);
 
-    if (cmd == "encodeFunctionData") {
+    if (cmd == "compileAbi") {
+        std::ofstream output(argv[2], std::ios::binary);
+        output << abi.toBinary();
+    } else if (cmd == "encodeFunctionData") {
         std::string funcName(argv[2]);
         std::string inputJson(argv[3]);
         auto input = tao::json::from_string(inputJson);
         auto result = abi.encodeFunctionData(funcName, input);
         std::cout << hoytech::to_hex(result, true) << std::endl;
+    } else if (cmd == "encodeFunctionDataReuse") {
+        // Encodes each input with the same buffer
+        std::string funcName(argv[2]);
+        std::string buffer;
+        for (int i = 3; i < argc; i++) {
+            buffer.clear();
+            abi.encodeFunctionData(funcName, tao::json::from_string(argv[i]), buffer);
+            std::cout << hoytech::to_hex(buffer, true) << std::endl;
+        }
     } else if (cmd == "decodeFunctionResult") {
         std::string funcName(argv[2]);
         std::string result = hoytech::from_hex(argv[3]);
         auto decodedResult = abi.decodeFunctionResult(funcName, result);
         std::cout << tao::json::to_string(decodedResult) << std::endl;
+    } else if (cmd == "decodeFunctionData") {
+        // decodeFunctionData <numThreads> <calldata>...
+        std::vector<std::string> calldata;
+        for (int i = 3; i < argc; i++) calldata.push_back(hoytech::from_hex(argv[i]));
+        std::vector<std::string_view> views(calldata.begin(), calldata.end());
+
+        for (auto &v : abi.decodeFunctionDataBatch(views, std::stoull(argv[2]))) std::cout << tao::json::to_string(v) << std::endl;
+    } else if (cmd == "multicallEncode" || cmd == "multicallDecode") {
+        // multicallEncode <calls JSON> <limits JSON>: prints each chunk, then each call's encoding error (or "")
+        // multicallDecode <calls JSON> <aggregate3 return data>: all calls in one chunk, prints each call's result
+        // Calls are [target, function, args], all with the TestContract ABI
+        auto callsJson = tao::json::from_string(argv[2]);
+        std::vector<EthersCpp::Multicall3::Call> calls;
+        for (auto &c : callsJson.get_array()) {
+            auto &a = c.get_array();
+            calls.push_back({ EthersCpp::addressFromHex(a.at(0).get_string()), &abi, a.at(1).get_string(), a.at(2) });
+        }
+
+        EthersCpp::Multicall3 multicall;
+
+        if (cmd == "multicallEncode") {
+            auto l = tao::json::from_string(argv[3]);
+            EthersCpp::Multicall3::Limits limits{ l.at("maxCalls").as<uint64_t>(), l.at("maxBytes").as<uint64_t>(), l.at("maxGas").as<uint64_t>() };
+            auto batch = multicall.prepare(calls, limits);
+
+            for (auto &chunk : batch.chunks) {
+                tao::json::value indices = tao::json::empty_array;
+                for (auto i : chunk.calls) indices.push_back(i);
+                std::cout << tao::json::to_string(tao::json::value({ { "calls", indices }, { "data", hoytech::to_hex(chunk.calldata, true) } })) << std::endl;
+            }
+
+            tao::json::value errors = tao::json::empty_array;
+            for (auto &r : batch.results) errors.push_back(r.error);
+            std::cout << tao::json::to_string(errors) << std::endl;
+        } else {
+            auto batch = multicall.prepare(calls);
+            multicall.decodeChunk(calls, batch, 0, hoytech::from_hex(argv[3]));
+
+            for (auto &r : batch.results) {
+                tao::json::value out = { { "success", r.success } };
+                if (r.success) out["result"] = r.result;
+                else out["error"] = r.error;
+                std::cout << tao::json::to_string(out) << std::endl;
+            }
+        }
+    } else if (cmd == "decodeLogs" || cmd == "filterTransferLogs" || cmd == "registryDecodeLogs") {
+        // decodeLogs <numThreads> [<address> <concatenated topics> <data>]...
+        // filterTransferLogs <conditions JSON> [<address> <concatenated topics> <data>]...
+        // registryDecodeLogs <watched addresses JSON> [<address> <concatenated topics> <data>]...
+        std::vector<std::vector<EthersCpp::Bytes32>> topics;
+        std::vector<std::string> data;
+        std::vector<EthersCpp::RawLog> logs;
+
+        for (int i = 3; i + 2 < argc; i += 3) {
+            std::string t = hoytech::from_hex(argv[i + 1]);
+            auto &logTopics = topics.emplace_back();
+            for (size_t j = 0; j + 32 <= t.size(); j += 32) logTopics.push_back(EthersCpp::fixedBytesFromRaw<32>(std::string_view(t).substr(j, 32)));
+            data.push_back(hoytech::from_hex(argv[i + 2]));
+        }
+
+        for (size_t i = 0; i < topics.size(); i++) {
+            logs.push_back({ EthersCpp::addressFromHex(argv[3 + i * 3]), topics[i], data[i] });
+        }
+
+        if (cmd == "decodeLogs") {
+            for (auto &v : abi.decodeLogs(logs, std::stoull(argv[2]))) std::cout << tao::json::to_string(v) << std::endl;
+        } else if (cmd == "registryDecodeLogs") {
+            // The ABI is added twice, and watched addresses alternate between the copies
+            EthersCpp::AbiRegistry registry;
+            uint32_t abiIds[2] = { registry.addAbi(abiStr), registry.addAbi(abiStr) };
+            auto watched = tao::json::from_string(argv[2]);
+            for (size_t i = 0; i < watched.get_array().size(); i++) {
+                registry.addContract(EthersCpp::addressFromHex(watched.get_array().at(i).get_string()), abiIds[i % 2]);
+            }
+
+            std::cout << tao::json::to_string(tao::json::value({ { "events", registry.numEvents() }, { "functions", registry.numFunctions() } })) << std::endl;
+            for (auto &v : registry.decodeLogs(logs, 4)) std::cout << tao::json::to_string(v) << std::endl;
+        } else {
+            // Conditions are [op, param, operand], where operand is an address, a decimal value, or an array of addresses for "in"
+            auto conditions = tao::json::from_string(argv[2]);
+            auto filter = abi.logFilter("Transfer");
+            std::vector<EthersCpp::LogFilter::AddressSet> sets;
+            sets.reserve(conditions.get_array().size());
+
+            for (auto &c : conditions.get_array()) {
+                auto &op = c.get_array().at(0).get_string();
+                auto &param = c.get_array().at(1).get_string();
+                auto &operand = c.get_array().at(2);
+
+                if (op == "in") {
+                    auto &set = sets.emplace_back();
+                    for (auto &a : operand.get_array()) set.insert(EthersCpp::addressFromHex(a.get_string()));
+                    filter.in(param, set);
+                } else if (param != "value") {
+                    auto addr = EthersCpp::addressFromHex(operand.get_string());
+                    if (op == "equals") filter.equals(param, addr);
+                    else if (op == "notEquals") filter.notEquals(param, addr);
+                    else throw hoytech::error("unsupported op for address: ", op);
+                } else {
+                    auto v = EthersCpp::uint256::fromString(operand.get_string());
+                    if (op == "equals") filter.equals(param, v);
+                    else if (op == "less") filter.less(param, v);
+                    else if (op == "greaterEq") filter.greaterEq(param, v);
+                    else throw hoytech::error("unsupported op for value: ", op);
+                }
+            }
+
+            for (size_t i = 0; i < logs.size(); i++) {
+                if (filter.matches(logs[i])) std::cout << i << std::endl;
+            }
+        }
+    } else if (cmd == "decodeFunctionResultStream") {
+        std::string funcName(argv[2]);
+        std::string result = hoytech::from_hex(argv[3]);
+        tao::json::events::to_stream out(std::cout);
+        abi.decodeFunctionResult(funcName, result, out);
+        std::cout << std::endl;
+    } else if (cmd == "decodeFunctionResultArena" || cmd == "decodeEventArena") {
+        // Decodes twice from a fixed buffer, releasing in between. The null upstream makes any allocation outside the buffer throw.
+        static char buffer[1 << 20];
+        std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+        std::string arg1 = cmd == "decodeEventArena" ? hoytech::from_hex(argv[2]) : argv[2];
+        std::string arg2 = hoytech::from_hex(argv[3]);
+        auto decode = [&]{ return cmd == "decodeEventArena" ? abi.decodeEvent(arg1, arg2, arena) : abi.decodeFunctionResult(arg1, arg2, arena); };
+
+        auto first = tao::json::to_string(decode().toJson());
+        arena.release();
+        auto second = tao::json::to_string(decode().toJson());
+        if (first != second) throw hoytech::error("arena decode mismatch");
+        std::cout << second << std::endl;
+    } else if (cmd == "decodeFunctionResultLimited") {
+        // Limits are any of maxElements, maxBytes, maxDepth and strictOffsets. The arena decoder must agree.
+        std::string funcName(argv[2]);
+        std::string result = hoytech::from_hex(argv[3]);
+        abi.setDecodeLimits(decodeLimitsFromJson(argv[4]));
+
+        auto output = tao::json::to_string(abi.decodeFunctionResult(funcName, result));
+        std::pmr::monotonic_buffer_resource arena;
+        if (tao::json::to_string(abi.decodeFunctionResult(funcName, result, arena).toJson()) != output) throw hoytech::error("arena decode mismatch");
+        std::cout << output << std::endl;
+    } else if (cmd == "decodeTypedLimited") {
+        // decode_multi_dyn_array_of_dyn_structs with the typed decoder and a view, which must agree
+        std::string result = hoytech::from_hex(argv[2]);
+        abi.setDecodeLimits(decodeLimitsFromJson(argv[3]));
+
+        using Structs = std::vector<std::vector<std::tuple<EthersCpp::uint256, std::string>>>;
+        auto output = typedToJson(abi.decodeFunctionResult<Structs>("decode_multi_dyn_array_of_dyn_structs", result));
+        if (typedToJson(abi.functionResultView("decode_multi_dyn_array_of_dyn_structs", result)["o1"].as<Structs>()) != output) throw hoytech::error("view decode mismatch");
+        std::cout << tao::json::to_string(output) << std::endl;
+    } else if (cmd == "viewFunctionResult") {
+        // Prints the value at each path (a JSON array of component names and indices)
+        std::string funcName(argv[2]);
+        std::string result = hoytech::from_hex(argv[3]);
+        auto root = abi.functionResultView(funcName, result);
+
+        for (int i = 4; i < argc; i++) {
+            auto view = root;
+            auto path = tao::json::from_string(argv[i]);
+            for (auto &step : path.get_array()) {
+                if (step.is_string()) view = view[step.get_string()];
+                else view = view[step.as<uint64_t>()];
+            }
+            std::cout << tao::json::to_string(view.toJson()) << std::endl;
+        }
+    } else if (cmd == "viewKitchenSinkTyped") {
+        std::string result = hoytech::from_hex(argv[2]);
+        auto view = abi.functionResultView("decode_kitchenSink", result);
+        tao::json::value out = tao::json::empty_array;
+        out.push_back(typedToJson(view["o8"]["nested"]["nums"].as<std::vector<EthersCpp::uint256>>()));
+        out.push_back(typedToJson(view["o3_5"][2].as<uint32_t>()));
+        out.push_back(typedToJson(view["o10"].as<MyStaticStruct>()));
+        std::cout << tao::json::to_string(out) << std::endl;
     } else if (cmd == "decodeEvent") {
         std::string topics = hoytech::from_hex(argv[2]);
         std::string data = hoytech::from_hex(argv[3]);
         auto result = abi.decodeEvent(topics, data);
         std::cout << tao::json::to_string(result) << std::endl;
+    } else if (cmd == "decodeKitchenSinkTyped") {
+        std::string result = hoytech::from_hex(argv[2]);
+        auto decoder = abi.functionResultDecoder<KitchenSink>("decode_kitchenSink");
+        std::cout << tao::json::to_string(typedToJson(decoder(result))) << std::endl;
+    } else if (cmd == "decodeFlat1Typed") {
+        std::string type(argv[2]);
+        std::string result = hoytech::from_hex(argv[3]);
+        tao::json::value v;
+        if (type == "uint8") v = typedToJson(abi.decodeFunctionResult<uint8_t>("decode_flat1", result));
+        else if (type == "uint64") v = typedToJson(abi.decodeFunctionResult<uint64_t>("decode_flat1", result));
+        else if (type == "uint256") v = typedToJson(abi.decodeFunctionResult<std::tuple<EthersCpp::uint256>>("decode_flat1", result));
+        else if (type == "bool") v = typedToJson(abi.decodeFunctionResult<bool>("decode_flat1", result));
+        else throw hoytech::error("unknown type: ", type);
+        std::cout << tao::json::to_string(v) << std::endl;
+    } else if (cmd == "decodeTransferTyped") {
+        std::string topics = hoytech::from_hex(argv[2]);
+        std::string data = hoytech::from_hex(argv[3]);
+        auto decoder = abi.eventDecoder<TransferEvent>("Transfer");
+        std::cout << tao::json::to_string(typedToJson(decoder(topics, data))) << std::endl;
+    } else if (cmd == "encodeKitchenSinkTyped") {
+        std::vector<EthersCpp::uint256> p10 = { 1, 2, 3 };
+        auto result = abi.encodeFunctionData("encode_kitchenSink",
+            EthersCpp::int256::fromString("-19231212939123912939"),
+            int64_t(-123123123123),
+            "hello world!",
+            std::string(200, '\xee'),
+            EthersCpp::fixedBytesFromHex<32>("0x3333333333333333333333333333333333333333333333333333333333333333"),
+            EthersCpp::fixedBytesFromHex<12>("0x0011223344556677889900aa"),
+            std::span<const EthersCpp::uint256>(p10),
+            EthersCpp::addressFromHex("0x00aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"));
+        std::cout << hoytech::to_hex(result, true) << std::endl;
+    } else if (cmd == "encodeStruct3Typed") {
+        // EncodeStruct3[][]: [[s(0)], [], [s(1), s(2)]], where s(i).a[j] = {i * 10 + j, "x" repeated j * 20 times}
+        auto s = [](uint64_t i){
+            EncodeStruct3 v;
+            for (size_t j = 0; j < 4; j++) std::get<0>(v)[j] = { i * 10 + j, std::string(j * 20, 'x') };
+            return v;
+        };
+        std::vector<std::vector<EncodeStruct3>> p1 = { { s(0) }, {}, { s(1), s(2) } };
+        std::cout << hoytech::to_hex(abi.encodeFunctionData("encode_struct3_4", p1), true) << std::endl;
+    } else if (cmd == "encodeIntLimitsTyped") {
+        auto encoder = abi.functionDataEncoder<int64_t, int64_t, uint64_t>("encode_int_limits");
+        std::cout << hoytech::to_hex(encoder(std::stoll(argv[2]), std::stoll(argv[3]), std::stoull(argv[4])), true) << std::endl;
+    } else if (cmd == "eip712Hash") {
+        // eip712Hash <types JSON> <domain JSON> <primary type> <value JSON>
+        EthersCpp::Eip712 eip712(tao::json::from_string(argv[2]), tao::json::from_string(argv[3]));
+        auto value = tao::json::from_string(argv[5]);
+
+        tao::json::value out = {
+            { "encodeType", eip712.encodeType(argv[4]) },
+            { "domainSeparator", EthersCpp::toHex(eip712.domainSeparator(), true) },
+            { "structHash", EthersCpp::toHex(eip712.hashStruct(argv[4], value), true) },
+            { "digest", EthersCpp::toHex(eip712.hash(argv[4], value), true) },
+        };
+        std::cout << tao::json::to_string(out) << std::endl;
+    } else if (cmd == "eip712RecoverMail") {
+        // eip712RecoverMail <domain JSON> [<mail JSON> <signature>]...
+        // Prints each typed digest (checked against the JSON one) and the recovered signer, or null
+        auto types = tao::json::from_string(R"({
+            "Person": [{"name": "name", "type": "string"}, {"name": "wallet", "type": "address"}],
+            "Mail": [{"name": "from", "type": "Person"}, {"name": "to", "type": "Person"}, {"name": "contents", "type": "string"}]
+        })");
+        EthersCpp::Eip712 eip712(types, tao::json::from_string(argv[2]));
+        auto hasher = eip712.hasher<Eip712Mail>("Mail");
+
+        std::vector<Eip712Mail> mails;
+        std::vector<std::string> signatures;
+
+        for (int i = 3; i + 1 < argc; i += 2) {
+            auto json = tao::json::from_string(argv[i]);
+            auto person = [&](const char *k){ return Eip712Person{ json.at(k).at("name").get_string(), EthersCpp::addressFromHex(json.at(k).at("wallet").get_string()) }; };
+            mails.push_back({ person("from"), person("to"), json.at("contents").get_string() });
+            signatures.push_back(hoytech::from_hex(argv[i + 1]));
+
+            if (hasher.hash(mails.back()) != eip712.hash("Mail", json)) throw hoytech::error("typed/JSON digest mismatch");
+        }
+
+        std::vector<std::string_view> sigViews(signatures.begin(), signatures.end());
+        auto signers = hasher.recoverSigners(mails, sigViews, 4);
+
+        for (size_t i = 0; i < mails.size(); i++) {
+            if (hasher.recoverSigner(mails[i], sigViews[i]) != signers[i]) throw hoytech::error("batch/single signer mismatch");
+
+            tao::json::value out = { { "digest", EthersCpp::toHex(hasher.hash(mails[i]), true) } };
+            if (signers[i]) out["signer"] = EthersCpp::toHex(*signers[i], true);
+            else out["signer"] = tao::json::null;
+            std::cout << tao::json::to_string(out) << std::endl;
+        }
+    } else if (cmd == "ecrecoverBatch") {
+        // ecrecoverBatch [<hash> <65-byte r,s,v signature>]...
+        // Prints each recovered signer or null, checked against ecrecover(), then the number that failed
+        std::vector<EthersCpp::Bytes32> hashes, rs, ss;
+        std::vector<uint8_t> vs;
+
+        for (int i = 2; i + 1 < argc; i += 2) {
+            auto sig = hoytech::from_hex(argv[i + 1]);
+            if (sig.size() != 65) throw hoytech::error("bad signature length");
+            hashes.push_back(EthersCpp::fixedBytesFromRaw<32>(hoytech::from_hex(argv[i])));
+            rs.push_back(EthersCpp::fixedBytesFromRaw<32>(sig.substr(0, 32)));
+            ss.push_back(EthersCpp::fixedBytesFromRaw<32>(sig.substr(32, 32)));
+            vs.push_back(sig[64]);
+        }
+
+        std::vector<EthersCpp::Address> addresses(hashes.size());
+        std::vector<uint8_t> ok(hashes.size());
+        size_t numFailed = EthersCpp::ecrecoverBatch(hashes, vs, rs, ss, addresses, ok, 4);
+
+        for (size_t i = 0; i < hashes.size(); i++) {
+            std::string single;
+            int v = vs[i] >= 27 ? vs[i] - 27 : vs[i];
+            try {
+                if (v <= 1) single = EthersCpp::ecrecover(EthersCpp::asStringView(hashes[i]), v, EthersCpp::asStringView(rs[i]), EthersCpp::asStringView(ss[i]));
+            } catch (std::exception &) {}
+            if (ok[i] ? single != EthersCpp::asStringView(addresses[i]) : single.size() || addresses[i] != EthersCpp::Address()) throw hoytech::error("batch/single ecrecover mismatch");
+
+            std::cout << (ok[i] ? tao::json::to_string(EthersCpp::toHex(addresses[i], true)) : "null") << std::endl;
+        }
+
+        std::cout << numFailed << std::endl;
+    } else if (cmd == "rlpDecode") {
+        // Prints the item as JSON, with lists as arrays and strings as hex
+        std::string input = hoytech::from_hex(argv[2]);
+        std::function<tao::json::value(const EthersCpp::RlpItem &)> toJson = [&](const EthersCpp::RlpItem &item) -> tao::json::value {
+            if (!item.isList) return EthersCpp::toHex(item.payload, true);
+            tao::json::value arr = tao::json::empty_array;
+            EthersCpp::RlpReader reader(item.payload);
+            while (!reader.empty()) arr.push_back(toJson(reader.next()));
+            return arr;
+        };
+        std::cout << tao::json::to_string(toJson(EthersCpp::rlpDecode(input))) << std::endl;
+    } else if (cmd == "recoverSenders" || cmd == "recoverBlockSenders") {
+        // recoverSenders [<raw tx>]... or recoverBlockSenders <block RLP>
+        // Prints each sender or null, checked against recoverSender(), then the number that failed
+        std::vector<std::string> raw;
+        for (int i = 2; i < argc; i++) raw.push_back(hoytech::from_hex(argv[i]));
+
+        std::vector<std::string_view> txs;
+        if (cmd == "recoverBlockSenders") txs = EthersCpp::blockTransactions(raw.at(0));
+        else txs.assign(raw.begin(), raw.end());
+
+        std::vector<EthersCpp::Address> senders(txs.size());
+        std::vector<uint8_t> ok(txs.size());
+        size_t numFailed = EthersCpp::recoverSenders(txs, senders, ok, 4);
+
+        for (size_t i = 0; i < txs.size(); i++) {
+            auto single = EthersCpp::recoverSender(txs[i]);
+            if (ok[i] ? single != senders[i] : single || senders[i] != EthersCpp::Address()) throw hoytech::error("batch/single sender mismatch");
+
+            std::cout << (ok[i] ? tao::json::to_string(EthersCpp::toHex(senders[i], true)) : "null") << std::endl;
+        }
+
+        std::cout << numFailed << std::endl;
+    } else if (cmd == "keccak256Batch") {
+        // keccak256Batch <auto|scalar|avx2|avx512> <hex>...: prints "unsupported" if the CPU or build lacks the implementation
+        std::string implName(argv[2]);
+        std::vector<std::string> inputs;
+        for (int i = 3; i < argc; i++) inputs.push_back(hoytech::from_hex(argv[i]));
+        std::vector<std::string_view> views(inputs.begin(), inputs.end());
+        std::vector<EthersCpp::Keccak256Digest> outputs(inputs.size());
+
+        if (implName == "auto") {
+            EthersCpp::keccak256Batch(views, outputs);
+        } else {
+            EthersCpp::KeccakBatchImpl impl;
+            if (implName == "scalar") impl = EthersCpp::KeccakBatchImpl::Scalar;
+            else if (implName == "avx2") impl = EthersCpp::KeccakBatchImpl::Avx2;
+            else if (implName == "avx512") impl = EthersCpp::KeccakBatchImpl::Avx512;
+            else throw hoytech::error("unknown keccak256Batch impl: ", implName);
+
+            try {
+                EthersCpp::keccak256Batch(views, outputs, impl);
+            } catch (hoytech::error &) {
+                std::cout << "unsupported" << std::endl;
+                return 0;
+            }
+        }
+
+        for (auto &o : outputs) std::cout << hoytech::to_hex(std::string_view(reinterpret_cast<const char*>(o.data()), o.size()), true) << std::endl;
+    } else if (cmd == "hexRoundTrip") {
+        // hexRoundTrip <scalar|ssse3|avx2> <hex>...: decodes each input and re-encodes it, printing
+        // 0x-prefixed lower-case hex or "invalid". Must agree with the scalar codec. Prints
+        // "unsupported" if the CPU or build lacks the implementation.
+        std::string implName(argv[2]);
+        EthersCpp::HexImpl impl;
+        if (implName == "scalar") impl = EthersCpp::HexImpl::Scalar;
+        else if (implName == "ssse3") impl = EthersCpp::HexImpl::Ssse3;
+        else if (implName == "avx2") impl = EthersCpp::HexImpl::Avx2;
+        else throw hoytech::error("unknown hex impl: ", implName);
+
+        if (!EthersCpp::hexImplSupported(impl)) {
+            std::cout << "unsupported" << std::endl;
+            return 0;
+        }
+
+        for (int i = 3; i < argc; i++) {
+            std::string_view in(argv[i]);
+            std::string decoded(in.size() / 2, '\0'), scalarDecoded(in.size() / 2, '\0');
+            bool ok = EthersCpp::hexDecode(in, decoded.data(), impl);
+            if (ok != EthersCpp::hexDecode(in, scalarDecoded.data(), EthersCpp::HexImpl::Scalar) || (ok && decoded != scalarDecoded)) throw hoytech::error("scalar/SIMD decode mismatch");
+
+            if (!ok) {
+                std::cout << "invalid" << std::endl;
+                continue;
+            }
+
+            std::string encoded(decoded.size() * 2, '\0'), scalarEncoded(decoded.size() * 2, '\0');
+            EthersCpp::hexEncode(decoded, encoded.data(), impl);
+            EthersCpp::hexEncode(decoded, scalarEncoded.data(), EthersCpp::HexImpl::Scalar);
+            if (encoded != scalarEncoded) throw hoytech::error("scalar/SIMD encode mismatch");
+
+            std::cout << "0x" << encoded << std::endl;
+        }
+    } else if (cmd == "orderedTrieRoot") {
+        std::vector<std::string> items;
+        for (int i = 2; i < argc; i++) items.push_back(hoytech::from_hex(argv[i]));
+        std::vector<std::string_view> views(items.begin(), items.end());
+        auto root = EthersCpp::orderedTrieRoot(views);
+        EthersCpp::ThreadPool pool(3);
+        if (EthersCpp::TrieRoot().ordered(views, pool) != root) throw hoytech::error("pooled/single trie root mismatch");
+        std::cout << hoytech::to_hex(std::string_view(reinterpret_cast<const char*>(root.data()), root.size()), true) << std::endl;
+    } else if (cmd == "trieRoot") {
+        std::vector<std::string> keys, values;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            keys.push_back(hoytech::from_hex(argv[i]));
+            values.push_back(hoytech::from_hex(argv[i + 1]));
+        }
+        std::vector<std::string_view> keyViews(keys.begin(), keys.end()), valueViews(values.begin(), values.end());
+        EthersCpp::TrieRoot trie;
+        auto root = trie.root(keyViews, valueViews);
+        EthersCpp::ThreadPool pool(3);
+        if (trie.root(keyViews, valueViews, pool) != root) throw hoytech::error("pooled/single trie root mismatch");
+        std::cout << hoytech::to_hex(std::string_view(reinterpret_cast<const char*>(root.data()), root.size()), true) << std::endl;
+    } else if (cmd == "storageLocate" || cmd == "storageDecode") {
+        EthersCpp::StorageLayout layout{std::string_view(argv[2])};
+        auto path = tao::json::from_string(argv[4]);
+        auto loc = layout.locate(argv[3], path.get_array());
+
+        if (cmd == "storageLocate") {
+            std::string_view slot(reinterpret_cast<const char*>(loc.slot.data()), loc.slot.size());
+            std::cout << tao::json::to_string(tao::json::value({ { "slot", hoytech::to_hex(slot, true) }, { "offset", loc.offset } })) << std::endl;
+        } else {
+            std::vector<EthersCpp::StorageSlot> words;
+            for (int i = 5; i < argc; i++) {
+                auto w = hoytech::from_hex(argv[i]);
+                if (w.size() != 32) throw hoytech::error("storage words must be 32 bytes");
+                words.emplace_back();
+                memcpy(words.back().data(), w.data(), 32);
+            }
+            std::cout << tao::json::to_string(layout.decode(loc, words)) << std::endl;
+        }
+    } else if (cmd == "storageMappingLocations") {
+        // Locations of mapping[key] for each key, from mappingLocations() (and mappingLocationsRaw()
+        // if already-encoded keys are given), which must match locate() element by element
+        EthersCpp::StorageLayout layout{std::string_view(argv[2])};
+        auto path = tao::json::from_string(argv[4]).get_array();
+        auto keys = tao::json::from_string(argv[5]).get_array();
+        auto mapping = layout.locate(argv[3], path);
+
+        std::vector<EthersCpp::StorageLayout::Location> locs(keys.size());
+        layout.mappingLocations(mapping, keys, locs);
+
+        std::vector<std::string> rawKeys;
+        for (int i = 6; i < argc; i++) rawKeys.push_back(hoytech::from_hex(argv[i]));
+        std::vector<std::string_view> rawViews(rawKeys.begin(), rawKeys.end());
+        std::vector<EthersCpp::StorageLayout::Location> rawLocs(rawKeys.size());
+        if (rawKeys.size()) layout.mappingLocationsRaw(mapping, rawViews, rawLocs);
+
+        tao::json::value out = tao::json::empty_array;
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            auto fullPath = path;
+            fullPath.push_back(keys[i]);
+            auto single = layout.locate(argv[3], fullPath);
+            if (locs[i].slot != single.slot || locs[i].offset != single.offset || locs[i].type != single.type) throw hoytech::error("batch/single mismatch");
+            if (rawKeys.size() && (rawKeys.size() != keys.size() || rawLocs[i].slot != single.slot)) throw hoytech::error("raw/single mismatch");
+
+            std::string_view slot(reinterpret_cast<const char*>(locs[i].slot.data()), locs[i].slot.size());
+            out.push_back(hoytech::to_hex(slot, true));
+        }
+
+        std::cout << tao::json::to_string(out) << std::endl;
+    } else if (cmd == "storageLongBytes") {
+        // A string or bytes value too long to store inline: its length slot, then the data slots
+        EthersCpp::StorageLayout layout{std::string_view(argv[2])};
+        auto loc = layout.locate(argv[3], tao::json::from_string(argv[4]).get_array());
+
+        std::vector<EthersCpp::StorageSlot> words;
+        for (int i = 5; i < argc; i++) {
+            auto w = hoytech::from_hex(argv[i]);
+            if (w.size() != 32) throw hoytech::error("storage words must be 32 bytes");
+            words.emplace_back();
+            memcpy(words.back().data(), w.data(), 32);
+        }
+
+        auto length = std::stoull(layout.decode(loc, std::span(words).first(1)).at("length").get_string());
+        auto dataLoc = layout.bytesDataLocation(loc);
+        std::string_view dataSlot(reinterpret_cast<const char*>(dataLoc.slot.data()), dataLoc.slot.size());
+
+        std::cout << tao::json::to_string(tao::json::value({
+            { "dataSlot", hoytech::to_hex(dataSlot, true) },
+            { "value", layout.decodeLongBytes(loc, length, std::span(words).subspan(1)) },
+        })) << std::endl;
+    } else if (cmd == "createAddress") {
+        auto deployer = EthersCpp::addressFromHex(argv[2]);
+        std::cout << EthersCpp::toHex(EthersCpp::createAddress(deployer, std::stoull(argv[3])), true) << std::endl;
+    } else if (cmd == "create2Address") {
+        EthersCpp::Create2 c2(EthersCpp::addressFromHex(argv[2]), EthersCpp::fixedBytesFromHex<32>(argv[3]));
+
+        std::vector<EthersCpp::Bytes32> salts;
+        for (int i = 4; i < argc; i++) salts.push_back(EthersCpp::fixedBytesFromHex<32>(argv[i]));
+
+        std::vector<EthersCpp::Address> addrs(salts.size());
+        c2.batch(salts, addrs);
+
+        for (size_t i = 0; i < salts.size(); i++) {
+            if (addrs[i] != c2(salts[i])) throw hoytech::error("batch/single mismatch");
+            std::cout << EthersCpp::toHex(addrs[i], true) << std::endl;
+        }
+    } else if (cmd == "create2Search") {
+        // create2Search <deployer> <initCodeHash> <prefix> <threads> [<prefix that makes pred throw>]
+        // The match must be the same as with one thread
+        EthersCpp::Create2 c2(EthersCpp::addressFromHex(argv[2]), EthersCpp::fixedBytesFromHex<32>(argv[3]));
+        std::string prefix = argv[4];
+        std::string throwPrefix = argc > 6 ? argv[6] : "";
+
+        auto pred = [&](const EthersCpp::Address &a){
+            auto hex = EthersCpp::toHex(a);
+            if (throwPrefix.size() && hex.starts_with(throwPrefix)) throw hoytech::error("pred failed on ", hex);
+            return hex.starts_with(prefix);
+        };
+
+        auto m = c2.search(pred, {}, 1'000'000, std::stoul(argv[5]));
+        if (!m) throw hoytech::error("no match found");
+
+        auto single = c2.search(pred, {}, 1'000'000, 1);
+        if (!single || single->salt != m->salt || single->address != m->address) throw hoytech::error("multi/single thread mismatch");
+
+        std::cout << tao::json::to_string(tao::json::value({ { "salt", EthersCpp::toHex(m->salt, true) }, { "address", EthersCpp::toHex(m->address, true) } })) << std::endl;
+    } else if (cmd == "gmpRoundTrip") {
+        // For each decimal value: its uint256 and int256 conversions from mpz_class (null if out of range), each converted back to mpz_class
+        for (int i = 2; i < argc; i++) {
+            mpz_class num(argv[i]);
+            tao::json::value out = tao::json::empty_object;
+
+            std::optional<EthersCpp::uint256> u;
+            try { u = EthersCpp::uint256FromMpz(num); } catch (hoytech::error &) {}
+
+            out["unsigned"] = u ? tao::json::value(u->toString()) : tao::json::null;
+            if (u) out["unsignedMpz"] = EthersCpp::toMpz(*u).get_str();
+
+            std::optional<EthersCpp::int256> s;
+            try { s = EthersCpp::int256FromMpz(num); } catch (hoytech::error &) {}
+
+            out["signed"] = s ? tao::json::value(s->toString()) : tao::json::null;
+            if (s) {
+                out["signedMpz"] = EthersCpp::toMpz(*s).get_str();
+
+                mpz_class copy = num;
+                auto bits = EthersCpp::normaliseSignedMpz(copy);
+                if (bits != s->bits.toBytes()) throw hoytech::error("normaliseSignedMpz mismatch");
+                out["bits"] = hoytech::to_hex(bits, true);
+                out["bitsMpz"] = EthersCpp::convertToMpzSigned(bits).get_str();
+            }
+
+            std::cout << tao::json::to_string(out) << std::endl;
+        }
     } else {
         throw hoytech::error("unknown cmd: ", cmd);
     }
@@ -13,6 +13,270 @@ let interface = new ethers.utils.Interface(abi);
 
 
 
+////////////// KECCAK256 BATCH
+
+{
+    // Mixed lengths around the 136-byte rate, and more inputs than lanes so lanes get refilled
+    let lengths = [0, 1, 31, 32, 135, 136, 137, 271, 272, 500, 3, 7, 1000];
+    for (let i = 0; i < 30; i++) lengths.push((i * 97) % 420);
+
+    let inputs = lengths.map(len => {
+        let buf = Buffer.alloc(len);
+        for (let i = 0; i < len; i++) buf[i] = (i * 7 + len) & 0xFF;
+        return ethers.utils.hexlify(buf);
+    });
+
+    // Every implementation the CPU supports, not just the one picked at runtime
+    for (let impl of ['auto', 'scalar', 'avx2', 'avx512']) {
+        let res = child_process.execSync(`./testHarness keccak256Batch ${impl} ${inputs.join(' ')}`).toString().trimEnd().split("\n");
+        if (res[0] === 'unsupported' && impl.startsWith('avx')) continue;
+        expect(res).to.deep.equal(inputs.map(i => ethers.utils.keccak256(i)));
+    }
+}
+
+
+
+
+
+////////////// HEX
+
+{
+    // Lengths on either side of the 16 and 32-byte SIMD blocks, so each implementation's tail runs
+    let inputs = [], expected = [];
+    let add = (input, output) => { inputs.push(input); expected.push(output); };
+
+    for (let len of [0, 1, 15, 16, 17, 31, 32, 33, 47, 48, 49, 63, 64, 65, 100]) {
+        let buf = Buffer.alloc(len);
+        for (let i = 0; i < len; i++) buf[i] = (i * 37 + len) & 0xFF;
+        let hex = ethers.utils.hexlify(buf);
+        add(hex.substr(2), hex);
+        add(hex.substr(2).toUpperCase(), hex);
+    }
+
+    // Odd lengths, and bad characters (including the neighbours of the valid ranges) at positions in the
+    // AVX2 block, the SSSE3 block and the scalar tail of a 50-byte input
+    for (let bad of ['abc', '0', 'f'.repeat(33), 'f'.repeat(99)]) add(bad, 'invalid');
+
+    let valid = 'a1'.repeat(50);
+    for (let c of ['g', 'G', '/', ':', '@', '`', 'z', ' ']) {
+        for (let pos of [0, 1, 31, 63, 64, 95, 96, 99]) add(valid.substr(0, pos) + c + valid.substr(pos + 1), 'invalid');
+    }
+
+    for (let impl of ['scalar', 'ssse3', 'avx2']) {
+        let res = child_process.execSync(`./testHarness hexRoundTrip ${impl} ${inputs.map(i => `'${i}'`).join(' ')}`).toString().trimEnd().split("\n");
+        if (res[0] === 'unsupported' && impl !== 'scalar') continue;
+        expect(res).to.deep.equal(expected);
+    }
+}
+
+
+
+
+
+////////////// TRIE ROOTS
+
+{
+    let trieRoot = (kv) => {
+        let args = [];
+        for (let k of Object.keys(kv)) args.push(ethers.utils.hexlify(Buffer.from(k)), ethers.utils.hexlify(Buffer.from(kv[k])));
+        return child_process.execSync(`./testHarness trieRoot ${args.join(' ')}`).toString().trimEnd();
+    };
+
+    // Vectors from ethereum/tests TrieTests
+    expect(trieRoot({})).to.equal('0x56e81f171bcc55a6ff8345e692c0f86e5b48e01b996cadc001622fb5e363b421');
+    expect(trieRoot({ A: 'a'.repeat(50) })).to.equal('0xd23786fb4a010da3ce639d66d5e904a11dbc02746d1ce25029e53290cabf28ab');
+    expect(trieRoot({ doe: 'reindeer', dog: 'puppy', dogglesworth: 'cat' })).to.equal('0x8aad789dff2f538bca5d8ea56e8abe10f4c7ba3a5dea95fea4cd6e7c3a1168d3');
+    expect(trieRoot({ do: 'verb', horse: 'stallion', doge: 'coin', dog: 'puppy' })).to.equal('0x5991bb8c6514148a29db676a14ac506cd2cd5775ace63c30a4fe457715e9ac84');
+    expect(trieRoot({ be: 'e', dog: 'puppy', bed: 'd' })).to.equal('0x3f67c7a47520f79faa29255d2d3c084a7a6df0453116ed7232ff10277a8be68b');
+
+    // Ordered trie is the same as a trie keyed by rlp(index)
+    let items = [];
+    for (let i = 0; i < 300; i++) items.push(ethers.utils.hexlify(ethers.utils.randomBytes(1 + (i * 37) % 250)));
+
+    let kvArgs = [];
+    items.forEach((item, i) => kvArgs.push(ethers.utils.RLP.encode(i === 0 ? '0x' : ethers.utils.hexlify(i)), item));
+
+    let ordered = child_process.execSync(`./testHarness orderedTrieRoot ${items.join(' ')}`).toString().trimEnd();
+    let keyed = child_process.execSync(`./testHarness trieRoot ${kvArgs.join(' ')}`).toString().trimEnd();
+    expect(ordered).to.equal(keyed);
+}
+
+
+
+
+
+////////////// STORAGE LAYOUT
+
+{
+    let layout = JSON.stringify({
+        storage: [
+            { label: "owner", offset: 0, slot: "0", type: "t_address" },
+            { label: "flag", offset: 20, slot: "0", type: "t_bool" },
+            { label: "small", offset: 21, slot: "0", type: "t_int16" },
+            { label: "balances", offset: 0, slot: "1", type: "t_mapping(t_address,t_uint256)" },
+            { label: "allowances", offset: 0, slot: "2", type: "t_mapping(t_address,t_mapping(t_address,t_uint256))" },
+            { label: "items", offset: 0, slot: "3", type: "t_array(t_struct(Item)10_storage)dyn_storage" },
+            { label: "names", offset: 0, slot: "4", type: "t_mapping(t_string_memory_ptr,t_uint256)" },
+            { label: "packed", offset: 0, slot: "5", type: "t_array(t_uint64)3_storage" },
+            { label: "description", offset: 0, slot: "6", type: "t_string_storage" },
+            { label: "blob", offset: 0, slot: "7", type: "t_bytes_storage" },
+        ],
+        types: {
+            "t_address": { encoding: "inplace", label: "address", numberOfBytes: "20" },
+            "t_bool": { encoding: "inplace", label: "bool", numberOfBytes: "1" },
+            "t_int16": { encoding: "inplace", label: "int16", numberOfBytes: "2" },
+            "t_uint64": { encoding: "inplace", label: "uint64", numberOfBytes: "8" },
+            "t_uint128": { encoding: "inplace", label: "uint128", numberOfBytes: "16" },
+            "t_uint256": { encoding: "inplace", label: "uint256", numberOfBytes: "32" },
+            "t_string_memory_ptr": { encoding: "bytes", label: "string", numberOfBytes: "32" },
+            "t_string_storage": { encoding: "bytes", label: "string", numberOfBytes: "32" },
+            "t_bytes_storage": { encoding: "bytes", label: "bytes", numberOfBytes: "32" },
+            "t_mapping(t_address,t_uint256)": { encoding: "mapping", key: "t_address", label: "mapping(address => uint256)", numberOfBytes: "32", value: "t_uint256" },
+            "t_mapping(t_address,t_mapping(t_address,t_uint256))": { encoding: "mapping", key: "t_address", label: "mapping(address => mapping(address => uint256))", numberOfBytes: "32", value: "t_mapping(t_address,t_uint256)" },
+            "t_mapping(t_string_memory_ptr,t_uint256)": { encoding: "mapping", key: "t_string_memory_ptr", label: "mapping(string => uint256)", numberOfBytes: "32", value: "t_uint256" },
+            "t_array(t_struct(Item)10_storage)dyn_storage": { base: "t_struct(Item)10_storage", encoding: "dynamic_array", label: "struct C.Item[]", numberOfBytes: "32" },
+            "t_array(t_uint64)3_storage": { base: "t_uint64", encoding: "inplace", label: "uint64[3]", numberOfBytes: "32" },
+            "t_struct(Item)10_storage": { encoding: "inplace", label: "struct C.Item", numberOfBytes: "64", members: [
+                { label: "a", offset: 0, slot: "0", type: "t_uint128" },
+                { label: "b", offset: 16, slot: "0", type: "t_uint128" },
+                { label: "c", offset: 0, slot: "1", type: "t_address" },
+            ] },
+        },
+    });
+
+    let locate = (variable, path) => JSON.parse(child_process.execSync(`./testHarness storageLocate '${layout}' ${variable} '${JSON.stringify(path)}'`).toString());
+    let decode = (variable, path, words) => JSON.parse(child_process.execSync(`./testHarness storageDecode '${layout}' ${variable} '${JSON.stringify(path)}' ${words.join(' ')}`).toString());
+    let coder = ethers.utils.defaultAbiCoder;
+
+    let a1 = "0x1111111111111111111111111111111111111111";
+    let a2 = "0x2222222222222222222222222222222222222222";
+
+    expect(locate("balances", [a1])).to.deep.equal({ offset: 0, slot: ethers.utils.keccak256(coder.encode(['address', 'uint256'], [a1, 1])) });
+    expect(locate("allowances", [a1, a2])).to.deep.equal({ offset: 0, slot: ethers.utils.keccak256(coder.encode(['address', 'bytes32'], [a2, ethers.utils.keccak256(coder.encode(['address', 'uint256'], [a1, 2]))])) });
+    expect(locate("names", ["alice"])).to.deep.equal({ offset: 0, slot: ethers.utils.keccak256(ethers.utils.concat([ethers.utils.toUtf8Bytes("alice"), ethers.utils.hexZeroPad("0x04", 32)])) });
+
+    let itemsBase = ethers.BigNumber.from(ethers.utils.keccak256(coder.encode(['uint256'], [3])));
+    expect(locate("items", [1, "b"])).to.deep.equal({ offset: 16, slot: ethers.utils.hexZeroPad(itemsBase.add(2).toHexString(), 32) });
+    expect(locate("items", [1, "c"])).to.deep.equal({ offset: 0, slot: ethers.utils.hexZeroPad(itemsBase.add(3).toHexString(), 32) });
+    expect(locate("packed", [2])).to.deep.equal({ offset: 16, slot: ethers.utils.hexZeroPad("0x05", 32) });
+
+    let slot0 = "0x000000000000000000fffe011111111111111111111111111111111111111111";
+    expect(decode("owner", [], [slot0])).to.equal(a1);
+    expect(decode("flag", [], [slot0])).to.equal(true);
+    expect(decode("small", [], [slot0])).to.equal("-2");
+    expect(decode("items", [0], [
+        "0x000000000000000000000000000000070000000000000000000000000000000b",
+        "0x0000000000000000000000002222222222222222222222222222222222222222",
+    ])).to.deep.equal({ a: "11", b: "7", c: a2 });
+    expect(decode("packed", [], ["0x0000000000000000000000000000000300000000000000020000000000000001"])).to.deep.equal(["1", "2", "3"]);
+
+    // Batched mapping locations (the harness checks each against locate()), with enough keys to
+    // fill the SIMD lanes and leave a tail, and string keys longer than a keccak block
+    let mappingLocations = (variable, path, keys, rawKeys) => JSON.parse(child_process.execSync(`./testHarness storageMappingLocations '${layout}' ${variable} '${JSON.stringify(path)}' '${JSON.stringify(keys)}' ${rawKeys.join(' ')}`).toString());
+
+    let addrs = [];
+    for (let i = 0; i < 19; i++) addrs.push(ethers.utils.hexZeroPad(ethers.utils.hexlify(i * 7919 + 1), 20));
+    expect(mappingLocations("balances", [], addrs, addrs.map(a => ethers.utils.hexZeroPad(a, 32))))
+        .to.deep.equal(addrs.map(a => ethers.utils.keccak256(coder.encode(['address', 'uint256'], [a, 1]))));
+
+    let inner = ethers.utils.keccak256(coder.encode(['address', 'uint256'], [a1, 2]));
+    expect(mappingLocations("allowances", [a1], addrs, []))
+        .to.deep.equal(addrs.map(a => ethers.utils.keccak256(coder.encode(['address', 'bytes32'], [a, inner]))));
+
+    let names = ["", "a", "alice", "x".repeat(31), "y".repeat(32), "z".repeat(135), "w".repeat(136), "v".repeat(300), "héllo"];
+    expect(mappingLocations("names", [], names, names.map(n => ethers.utils.hexlify(ethers.utils.toUtf8Bytes(n)))))
+        .to.deep.equal(names.map(n => ethers.utils.keccak256(ethers.utils.concat([ethers.utils.toUtf8Bytes(n), ethers.utils.hexZeroPad("0x04", 32)]))));
+
+    // Long strings and bytes: the slot holds length*2+1 and the data is at keccak256(slot)
+    let longBytes = (variable, slotNum, data) => {
+        let words = [ethers.utils.hexZeroPad(ethers.utils.hexlify(data.length * 2 + 1), 32)];
+        let padded = ethers.utils.concat([data, new Uint8Array((32 - data.length % 32) % 32)]);
+        for (let i = 0; i < padded.length; i += 32) words.push(ethers.utils.hexlify(padded.slice(i, i + 32)));
+
+        let res = JSON.parse(child_process.execSync(`./testHarness storageLongBytes '${layout}' ${variable} '[]' ${words.join(' ')}`).toString());
+        expect(res.dataSlot).to.equal(ethers.utils.keccak256(ethers.utils.hexZeroPad(ethers.utils.hexlify(slotNum), 32)));
+        return res.value;
+    };
+
+    let description = "The quick brown fox jumps over the lazy dog, then does it again.";
+    expect(longBytes("description", 6, ethers.utils.toUtf8Bytes(description))).to.equal(description);
+    let blob = ethers.utils.arrayify("0x" + "c0ffee".repeat(40));
+    expect(longBytes("blob", 7, blob)).to.equal(ethers.utils.hexlify(blob));
+}
+
+
+
+
+
+////////////// CONTRACT ADDRESSES
+
+{
+    let deployer = '0x8ba1f109551bD432803012645Ac136ddd64DBA72';
+
+    for (let nonce of [0, 1, 127, 128, 255, 256, 1000000, 2**40]) {
+        let res = child_process.execSync(`./testHarness createAddress ${deployer} ${nonce}`).toString().trimEnd();
+        expect(res).to.equal(ethers.utils.getContractAddress({ from: deployer, nonce }).toLowerCase());
+    }
+
+    let initCodeHash = ethers.utils.keccak256('0x6080604052');
+    let salts = [];
+    for (let i = 0; i < 70; i++) salts.push(ethers.utils.hexZeroPad(ethers.utils.hexlify(i * 7919), 32));
+
+    let res = child_process.execSync(`./testHarness create2Address ${deployer} ${initCodeHash} ${salts.join(' ')}`).toString().trimEnd().split("\n");
+    expect(res).to.deep.equal(salts.map(s => ethers.utils.getCreate2Address(deployer, s, initCodeHash).toLowerCase()));
+
+    // Lowest matching counter must be found regardless of thread count (the harness also compares with 1 thread)
+    for (let threads of [1, 3, 8]) {
+        let found = JSON.parse(child_process.execSync(`./testHarness create2Search ${deployer} ${initCodeHash} 00 ${threads}`).toString());
+        let counter = parseInt(found.salt, 16);
+        expect(found.address).to.equal(ethers.utils.getCreate2Address(deployer, found.salt, initCodeHash).toLowerCase());
+        expect(found.address.substr(2, 2)).to.equal('00');
+        for (let i = 0; i < counter; i++) {
+            let addr = ethers.utils.getCreate2Address(deployer, ethers.utils.hexZeroPad(ethers.utils.hexlify(i), 32), initCodeHash);
+            expect(addr.substr(2, 2)).to.not.equal('00');
+        }
+    }
+
+    // An exception from the predicate stops the search and is rethrown to the caller, on any thread
+    for (let threads of [1, 3]) {
+        expect(() => child_process.execSync(`./testHarness create2Search ${deployer} ${initCodeHash} 000000 ${threads} ff`, { stdio: 'pipe' })).to.throw(/pred failed on ff/);
+    }
+}
+
+
+
+
+
+////////////// GMP INTEROP
+
+{
+    let two = ethers.BigNumber.from(2);
+    let values = [0, 1, -1, 255, -256, '123456789012345678901234567890', two.pow(255).sub(1), two.pow(255).mul(-1), two.pow(255), two.pow(256).sub(1), two.pow(256), two.pow(255).mul(-1).sub(1)]
+                 .map(v => ethers.BigNumber.from(v));
+
+    let res = child_process.execSync(`./testHarness gmpRoundTrip ${values.map(v => v.toString()).join(' ')}`).toString().trimEnd().split("\n").map(r => JSON.parse(r));
+
+    for (let i = 0; i < values.length; i++) {
+        let v = values[i], r = res[i], str = v.toString();
+
+        let inUnsigned = v.gte(0) && v.lt(two.pow(256));
+        expect(r.unsigned).to.equal(inUnsigned ? str : null);
+        if (inUnsigned) expect(r.unsignedMpz).to.equal(str);
+
+        let inSigned = v.gte(two.pow(255).mul(-1)) && v.lt(two.pow(255));
+        expect(r.signed).to.equal(inSigned ? str : null);
+        if (inSigned) {
+            expect(r.signedMpz).to.equal(str);
+            expect(r.bits).to.equal(ethers.utils.hexZeroPad(v.toTwos(256).toHexString(), 32));
+            expect(r.bitsMpz).to.equal(str);
+        }
+    }
+}
+
+
+
+
+
 ////////////// DECODE LOGS
 
 {
@@ -26,6 +290,7 @@ let interface = new ethers.utils.Interface(abi);
     let data = "0x3333333333333333333333333333333333333333333333333333333333333333";
 
     let res = JSON.parse(child_process.execSync(`./testHarness decodeEvent ${topics} ${data}`).toString());
+    expect(JSON.parse(child_process.execSync(`./testHarness decodeEventArena ${topics} ${data}`).toString())).to.deep.equal(res);
 
     expect(res).to.deep.equal({
         name: 'Transfer',
@@ -37,6 +302,69 @@ let interface = new ethers.utils.Interface(abi);
     });
 }
 
+{
+    let transferTopic = interface.getEventTopic('Transfer');
+    let args = [], expected = [];
+
+    for (let i = 0; i < 300; i++) {
+        let address = ethers.utils.hexlify(ethers.utils.randomBytes(20));
+
+        if (i % 7 === 3) {
+            // Not an event in the ABI
+            args.push(address, ethers.utils.hexlify(ethers.utils.randomBytes(32)), "0x");
+            expected.push(null);
+            continue;
+        }
+
+        let from = ethers.utils.hexlify(ethers.utils.randomBytes(20)), to = ethers.utils.hexlify(ethers.utils.randomBytes(20));
+        let value = ethers.BigNumber.from(ethers.utils.randomBytes(1 + i % 32));
+
+        args.push(address, ethers.utils.hexlify(ethers.utils.concat([transferTopic, ethers.utils.hexZeroPad(from, 32), ethers.utils.hexZeroPad(to, 32)])), ethers.utils.hexZeroPad(value.toHexString(), 32));
+        expected.push({ name: 'Transfer', args: { from, to, value: value.toString() }, address });
+    }
+
+    for (let threads of [1, 4]) {
+        let res = child_process.execSync(`./testHarness decodeLogs ${threads} ${args.join(' ')}`).toString().trimEnd().split("\n").map(JSON.parse);
+        expect(res).to.deep.equal(expected);
+    }
+
+    // Registry only decodes logs from watched addresses
+    let watched = [];
+    for (let i = 0; i < args.length; i += 6) watched.push(args[i]);
+
+    let res = child_process.execSync(`./testHarness registryDecodeLogs '${JSON.stringify(watched)}' ${args.join(' ')}`).toString().trimEnd().split("\n").map(JSON.parse);
+    expect(res[0]).to.deep.equal({ events: abi.filter(f => f.type === 'event').length, functions: abi.filter(f => f.type === 'function').length });
+    expect(res.slice(1)).to.deep.equal(expected.map(e => e && watched.includes(e.address) ? e : null));
+}
+
+{
+    let transferTopic = interface.getEventTopic('Transfer');
+    let accounts = [1, 2, 3, 4, 5].map(i => ethers.utils.hexZeroPad(ethers.utils.hexlify(i * 0x1111), 20));
+    let args = [], logs = [];
+
+    for (let i = 0; i < 200; i++) {
+        let from = accounts[i % 5], to = accounts[(i * 3 + 1) % 5];
+        let value = ethers.BigNumber.from(i).mul(i % 2 ? "1000000000000000000000" : 1);
+        let topics = [transferTopic, ethers.utils.hexZeroPad(from, 32), ethers.utils.hexZeroPad(to, 32)];
+        if (i % 11 === 0) topics.pop(); // same topic0 but different indexing (eg ERC-721)
+        args.push(accounts[0], ethers.utils.hexlify(ethers.utils.concat(topics)), ethers.utils.hexZeroPad(value.toHexString(), 32));
+        logs.push({ i, from, to, value, ok: i % 11 !== 0 });
+    }
+
+    let filter = (conditions) => {
+        let res = child_process.execSync(`./testHarness filterTransferLogs '${JSON.stringify(conditions)}' ${args.join(' ')}`).toString().trimEnd();
+        return res === '' ? [] : res.split("\n").map(Number);
+    };
+
+    let threshold = "5000000000000000000000";
+    expect(filter([["in", "to", [accounts[1], accounts[3]]], ["greaterEq", "value", threshold]]))
+        .to.deep.equal(logs.filter(l => l.ok && [accounts[1], accounts[3]].includes(l.to) && l.value.gte(threshold)).map(l => l.i));
+    expect(filter([["equals", "from", accounts[2]], ["less", "value", "50"]]))
+        .to.deep.equal(logs.filter(l => l.ok && l.from === accounts[2] && l.value.lt(50)).map(l => l.i));
+    expect(filter([["notEquals", "to", accounts[0]]]))
+        .to.deep.equal(logs.filter(l => l.ok && l.to !== accounts[0]).map(l => l.i));
+}
+
 
 
 
@@ -263,6 +591,159 @@ decodeFunctionResult('decode_kitchenSink', {
 
 
 
+////////////// DECODE LIMITS
+
+{
+    let word = (n) => ethers.utils.hexZeroPad(ethers.utils.hexlify(n), 32).substr(2);
+    let hello = word(5) + '68656c6c6f' + '00'.repeat(27);
+    let decodeLimited = (funcName, encoded, limits) => JSON.parse(child_process.execSync(`./testHarness decodeFunctionResultLimited ${funcName} ${encoded} '${JSON.stringify(limits)}'`, { stdio: 'pipe' }).toString());
+    let ethersDecode = (funcName, encoded) => JSON.parse(JSON.stringify(interface.decodeFunctionResult(funcName, encoded), (k, v) => v && v.type === 'BigNumber' ? ethers.BigNumber.from(v).toString() : v));
+
+    // Canonical encodings are unaffected
+    let encoded = interface.encodeFunctionResult('decode_multi_dyn_array_of_dyn_structs', [[[{ a: 1, b: "hello" }, { a: 2, b: "" }], [], [{ a: 3, b: "world" }]]]);
+    expect(decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, {})).to.deep.equal(
+           decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, { strictOffsets: false, maxElements: 1e9 }));
+    expect(decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, {}).o1[2][0].b).to.equal("world");
+
+    // Both elements point at the same struct
+    encoded = '0x' + word(0x20) + word(2) + word(0x40) + word(0x40) + word(123) + word(0x40) + hello;
+    expect(decodeLimited('decode_dyn_array_of_dyn_structs', encoded, { strictOffsets: false }).o1.map(s => [s.a, s.b])).to.deep.equal([["123", "hello"], ["123", "hello"]]);
+    expect(() => decodeLimited('decode_dyn_array_of_dyn_structs', encoded, {})).to.throw(/ABI offset overlaps other data/);
+
+    // Pointing back into the head
+    encoded = '0x' + word(0x20) + word(1) + word(0x00) + word(123) + word(0x40) + hello;
+    expect(() => decodeLimited('decode_dyn_array_of_dyn_structs', encoded, {})).to.throw(/ABI offset overlaps other data/);
+
+    // Offsets with high bits set
+    encoded = '0x' + word(ethers.BigNumber.from(1).shl(255).add(0x20)) + word(0);
+    expect(() => decodeLimited('decode_dyn_array_of_dyn_structs', encoded, {})).to.throw(/ABI offset or length too large/);
+
+    // n outer elements all point at one inner array, whose n elements all point at one struct: n^2 structs from O(n) bytes
+    let n = 40;
+    let aliasedArray = (n, tail) => word(n) + word(n * 32).repeat(n) + tail;
+    encoded = '0x' + word(0x20) + aliasedArray(n, aliasedArray(n, word(123) + word(0x40) + hello));
+
+    let res = decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, { strictOffsets: false, maxElements: 1e9 });
+    expect(res.o1.length).to.equal(n);
+    expect(res.o1[n - 1].length).to.equal(n);
+    expect(res).to.deep.equal({ o1: ethersDecode('decode_multi_dyn_array_of_dyn_structs', encoded).o1.map(inner => inner.map(s => ({ a: s[0], b: s[1] }))) });
+
+    expect(() => decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, {})).to.throw(/ABI offset overlaps other data/);
+    expect(() => decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, { strictOffsets: false, maxElements: 1000 })).to.throw(/too many elements/);
+    expect(() => decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, { strictOffsets: false, maxElements: 1e9, maxBytes: 10000 })).to.throw(/too many bytes/);
+    expect(() => decodeLimited('decode_multi_dyn_array_of_dyn_structs', encoded, { maxDepth: 3 })).to.throw(/nested too deeply/);
+
+    // Typed decoders and views are held to the same limits
+    let decodeTypedLimited = (encoded, limits) => JSON.parse(child_process.execSync(`./testHarness decodeTypedLimited ${encoded} '${JSON.stringify(limits)}'`, { stdio: 'pipe' }).toString());
+    expect(decodeTypedLimited(encoded, { strictOffsets: false, maxElements: 1e9 })).to.deep.equal(res.o1.map(inner => inner.map(s => [s.a, s.b])));
+    expect(() => decodeTypedLimited(encoded, {})).to.throw(/ABI offset overlaps other data/);
+    expect(() => decodeTypedLimited(encoded, { strictOffsets: false, maxElements: 1000 })).to.throw(/too many elements/);
+    expect(() => decodeTypedLimited(encoded, { strictOffsets: false, maxElements: 1e9, maxBytes: 10000 })).to.throw(/too many bytes/);
+    expect(() => decodeTypedLimited(encoded, { maxDepth: 3 })).to.throw(/nested too deeply/);
+}
+
+
+
+
+
+////////////// TYPED DECODING
+
+{
+    // Typed results are printed positionally: tuples and structs become arrays
+    let positional = (v) => {
+        if (Array.isArray(v)) return v.map(positional);
+        if (typeof v === 'object') return Object.values(v).map(positional);
+        return v;
+    };
+
+    let args = {
+        o1: "18446744073709551615",
+        o2: [],
+        o3: "115792089237316195423570985008687907853269984665640564039457584007913129639935",
+        o3_5: ["0", "1", "4294967295", "7"],
+        o4: "",
+        o5: "0x" + "ab".repeat(70),
+        o6: "0x" + "01".repeat(32),
+        o7: "0x" + "fe".repeat(12),
+        o8: {
+            a: "1",
+            b: "2",
+            str: "x".repeat(100),
+            nested: {
+                addr: "0xcccccccccccccccccccccccccccccccccccccccc",
+                nums: ["3", "4", "5"],
+            },
+        },
+        o9: false,
+        o10: {
+            s1: ["0", "99"],
+            s2: "0xdddddddddddddddddddddddddddddddddddddddd",
+            s3: "0x" + "00".repeat(32),
+        },
+    };
+
+    let encoded = interface.encodeFunctionResult('decode_kitchenSink', Object.values(args));
+    let res = JSON.parse(child_process.execSync(`./testHarness decodeKitchenSinkTyped ${encoded}`).toString());
+    expect(res).to.deep.equal(positional(args));
+
+    let view = (...paths) => child_process.execSync(`./testHarness viewFunctionResult decode_kitchenSink ${encoded} ${paths.map(p => `'${JSON.stringify(p)}'`).join(' ')}`, { stdio: 'pipe' })
+                                 .toString().trimEnd().split("\n").map(JSON.parse);
+    expect(view(["o8", "nested", "nums", 2], ["o8", "nested"], [8, 2], ["o3_5", 3], ["o2"], [])).to.deep.equal([
+        "5", args.o8.nested, args.o8.str, "7", [], args,
+    ]);
+    expect(() => view(["o2", 0])).to.throw(/array index out of range/);
+    expect(() => view(["nope"])).to.throw(/no such ABI component/);
+
+    res = JSON.parse(child_process.execSync(`./testHarness viewKitchenSinkTyped ${encoded}`).toString());
+    expect(res).to.deep.equal([["3", "4", "5"], "4294967295", positional(args.o10)]);
+
+    encoded = interface.encodeFunctionResult('decode_flat1', ["300"]);
+    expect(JSON.parse(child_process.execSync(`./testHarness decodeFlat1Typed uint64 ${encoded}`).toString())).to.equal("300");
+    expect(JSON.parse(child_process.execSync(`./testHarness decodeFlat1Typed uint256 ${encoded}`).toString())).to.deep.equal(["300"]);
+    expect(() => child_process.execSync(`./testHarness decodeFlat1Typed uint8 ${encoded}`, { stdio: 'pipe' })).to.throw(/out of range/);
+    expect(() => child_process.execSync(`./testHarness decodeFlat1Typed bool ${encoded}`, { stdio: 'pipe' })).to.throw(/can't be decoded into bool/);
+
+    let topics = ethers.utils.hexlify(ethers.utils.concat([
+        interface.getEventTopic('Transfer'),
+        ethers.utils.hexZeroPad("0x1111111111111111111111111111111111111111", 32),
+        ethers.utils.hexZeroPad("0x2222222222222222222222222222222222222222", 32),
+    ]));
+    res = JSON.parse(child_process.execSync(`./testHarness decodeTransferTyped ${topics} ${ethers.utils.hexZeroPad("0x1234", 32)}`).toString());
+    expect(res).to.deep.equal(["0x1111111111111111111111111111111111111111", "0x2222222222222222222222222222222222222222", "4660"]);
+}
+
+
+
+
+
+////////////// TYPED ENCODING
+
+{
+    let typed = (args) => child_process.execSync(`./testHarness ${args}`, { stdio: 'pipe' }).toString().trimEnd();
+
+    expect(typed('encodeKitchenSinkTyped')).to.equal(interface.encodeFunctionData('encode_kitchenSink', [
+        '-19231212939123912939',
+        '-123123123123',
+        "hello world!",
+        "0x" + "ee".repeat(200),
+        "0x3333333333333333333333333333333333333333333333333333333333333333",
+        "0x0011223344556677889900aa",
+        [1, 2, 3],
+        "0x00aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+    ]));
+
+    let s = (i) => ({ a: [0, 1, 2, 3].map(j => ({ a: i * 10 + j, b: "x".repeat(j * 20) })) });
+    expect(typed('encodeStruct3Typed')).to.equal(interface.encodeFunctionData('encode_struct3_4', [[[s(0)], [], [s(1), s(2)]]]));
+
+    expect(typed('encodeIntLimitsTyped -1 -2147483648 12345')).to.equal(interface.encodeFunctionData('encode_int_limits', ['-1', '-2147483648', '12345']));
+    expect(() => typed('encodeIntLimitsTyped 0 2147483648 0')).to.throw(/out of range/);
+    expect(() => typed('encodeIntLimitsTyped 0 -2147483649 0')).to.throw(/out of range/);
+}
+
+
+
+
+
 ////////////// ENCODE FUNCTION DATA
 
 encodeFunctionData('encode_flat1', {
@@ -474,6 +955,20 @@ encodeFunctionData('encode_kitchenSink', {
 
 
 
+{
+    let inputs = [
+        { p1: 1, p2: { a: 2, b: "x".repeat(100) }, p3: 3 },
+        { p1: 4, p2: { a: 5, b: "" }, p3: 6 },
+    ];
+
+    let res = child_process.execSync(`./testHarness encodeFunctionDataReuse encode_struct2 ${inputs.map(i => `'${JSON.stringify(i)}'`).join(' ')}`).toString().trimEnd().split("\n");
+    expect(res).to.deep.equal(inputs.map(i => interface.encodeFunctionData('encode_struct2', Object.values(i))));
+}
+
+
+
+
+
 encodeFunctionData('encode_int_limits', {
     p1: '1000',
     p2: '-1231233',
@@ -481,6 +976,391 @@ encodeFunctionData('encode_int_limits', {
     p3: 50,
 });
 
+encodeFunctionData('encode_overloaded(uint256)', {
+    p1: 7,
+});
+
+encodeFunctionData('encode_overloaded(string,uint256)', {
+    p1: 'hello',
+    p2: 8,
+});
+
+
+
+
+
+////////////// DECODE FUNCTION DATA
+
+{
+    let calldata = [
+        interface.encodeFunctionData('encode_struct2', [1, { a: 2, b: "x".repeat(40) }, 3]),
+        interface.encodeFunctionData('encode_overloaded(uint256)', [7]),
+        interface.encodeFunctionData('encode_overloaded(string,uint256)', ["abc", 8]),
+        interface.encodeFunctionData('encode_int_limits', ['-1', '-2147483648', '12345']),
+        '0x', // plain transfer
+        '0xdeadbeef', // unknown selector
+    ];
+
+    let expected = calldata.map(data => {
+        let tx;
+        try { tx = interface.parseTransaction({ data }); } catch (e) { return null; }
+        return { name: tx.name, signature: tx.signature, args: cleanupObj(tx.args) };
+    });
+
+    // Enough calldata to be split between threads
+    let batch = [], batchExpected = [];
+    for (let i = 0; i < 40; i++) {
+        batch.push(...calldata);
+        batchExpected.push(...expected);
+    }
+
+    for (let numThreads of [1, 4]) {
+        let res = child_process.execSync(`./testHarness decodeFunctionData ${numThreads} ${batch.join(' ')}`).toString().trimEnd().split("\n");
+        expect(res.map(r => canonicalJsonStringify(JSON.parse(r)))).to.deep.equal(batchExpected.map(e => canonicalJsonStringify(e)));
+    }
+}
+
+{
+    // burn(uint256) and collate_propagate_storage(bytes16) share the selector 0x42966c68
+    let clashAbi = [
+        { type: 'function', name: 'burn', inputs: [{ name: 'amount', type: 'uint256' }], outputs: [] },
+        { type: 'function', name: 'collate_propagate_storage', inputs: [{ name: 'x', type: 'bytes16' }], outputs: [] },
+    ];
+    fs.writeFileSync('artifacts/Clash.abi', JSON.stringify(clashAbi));
+    let clashInterface = new ethers.utils.Interface(clashAbi);
+    let run = (args) => child_process.execSync(`./testHarness ${args}`, { env: { ...process.env, ABI_JSON: 'artifacts/Clash.abi' } }).toString().trimEnd();
+
+    // Both are still reachable by name and signature
+    let x = '0x' + '11'.repeat(16);
+    expect(run(`encodeFunctionData burn '{"amount":5}'`)).to.equal(clashInterface.encodeFunctionData('burn', [5]));
+    expect(run(`encodeFunctionData collate_propagate_storage '{"x":"${x}"}'`)).to.equal(clashInterface.encodeFunctionData('collate_propagate_storage', [x]));
+    expect(run(`encodeFunctionData 'collate_propagate_storage(bytes16)' '{"x":"${x}"}'`)).to.equal(clashInterface.encodeFunctionData('collate_propagate_storage', [x]));
+
+    // Calldata decodes as the first one declared
+    expect(JSON.parse(run(`decodeFunctionData 1 ${clashInterface.encodeFunctionData('burn', [5])}`)).name).to.equal('burn');
+
+    // AbiRegistry looks calls up by selector alone, so it rejects the ABI
+    expect(() => child_process.execSync(`./testHarness registryDecodeLogs '["0x1111111111111111111111111111111111111111"]'`, { stdio: 'pipe', env: { ...process.env, ABI_JSON: 'artifacts/Clash.abi' } }))
+        .to.throw(/function selector clash in ABI: burn\(uint256\) and collate_propagate_storage\(bytes16\)/);
+}
+
+
+
+
+
+////////////// ECRECOVER
+
+{
+    let args = [], expected = [];
+
+    for (let i = 0; i < 50; i++) {
+        let key = ethers.utils.keccak256(ethers.utils.toUtf8Bytes(`key ${i}`));
+        let digest = ethers.utils.keccak256(ethers.utils.toUtf8Bytes(`message ${i}`));
+        let sig = ethers.utils.splitSignature(new ethers.utils.SigningKey(key).signDigest(digest));
+        let signer = ethers.utils.computeAddress(key).toLowerCase();
+
+        let v = i % 2 ? sig.v : sig.recoveryParam;
+        let r = sig.r, s = sig.s;
+
+        if (i % 10 === 3) { v = 5; signer = null; } // bad recovery id
+        if (i % 10 === 5) { r = ethers.constants.HashZero; signer = null; }
+        if (i % 10 === 8) { s = ethers.utils.hexZeroPad(ethers.BigNumber.from('0xfffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364141').toHexString(), 32); signer = null; } // s = n
+
+        args.push(digest, ethers.utils.hexConcat([r, s, ethers.utils.hexlify(v)]));
+        expected.push(signer);
+    }
+
+    let res = child_process.execSync(`./testHarness ecrecoverBatch ${args.join(' ')}`).toString().trimEnd().split("\n").map(r => JSON.parse(r));
+    expect(res.pop()).to.equal(15);
+    expect(res).to.deep.equal(expected);
+}
+
+
+
+
+
+////////////// TRANSACTION SENDERS
+
+{
+    for (let item of ['0x80', '0x7f', '0xc0', '0xc3010203', '0xc2c0c0', '0xb838' + 'aa'.repeat(56), ethers.utils.RLP.encode(['0x1234', ['0x', ['0x' + 'bb'.repeat(100)]]])]) {
+        expect(JSON.parse(child_process.execSync(`./testHarness rlpDecode ${item}`).toString())).to.deep.equal(ethers.utils.RLP.decode(item));
+    }
+
+    for (let item of ['0x817f', '0xb80100', '0xf800', '0x0102', '0xc30102']) {
+        expect(() => child_process.execSync(`./testHarness rlpDecode ${item}`, { stdio: 'pipe' })).to.throw(/rlp: /);
+    }
+
+    let txs = [], expected = [], networkForm = [];
+
+    // Typed transactions that ethers v5 can't serialise are built by hand
+    let num = (n) => n ? ethers.utils.hexlify(n) : '0x';
+    let signTyped = (key, type, fields) => {
+        let sig = key.signDigest(ethers.utils.keccak256(ethers.utils.hexConcat([type, ethers.utils.RLP.encode(fields)])));
+        return [...fields, num(sig.recoveryParam), ethers.utils.hexStripZeros(sig.r), ethers.utils.hexStripZeros(sig.s)];
+    };
+
+    for (let i = 0; i < 32; i++) {
+        let key = new ethers.utils.SigningKey(ethers.utils.keccak256(ethers.utils.toUtf8Bytes(`sender ${i}`)));
+        let sign = (unsigned) => ethers.utils.serializeTransaction(unsigned, key.signDigest(ethers.utils.keccak256(ethers.utils.serializeTransaction(unsigned))));
+        let tx = { nonce: i, gasLimit: 21000 + i, to: i % 7 ? '0x' + '44'.repeat(20) : undefined, value: i * 1000, data: '0x' + 'ab'.repeat(i) };
+        let raw;
+
+        switch (i < 30 ? i % 6 : 6) {
+            case 0: raw = sign({ ...tx, gasPrice: 7 }); break; // pre-EIP-155
+            case 1: raw = sign({ ...tx, gasPrice: 7, chainId: 137 }); break;
+            case 2: raw = sign({ ...tx, type: 1, gasPrice: 7, chainId: 1, accessList: [{ address: '0x' + '11'.repeat(20), storageKeys: ['0x' + '22'.repeat(32)] }] }); break;
+            case 3: case 4: raw = sign({ ...tx, type: 2, maxFeePerGas: 100, maxPriorityFeePerGas: 2, chainId: 1, accessList: [] }); break;
+            case 5: {
+                // EIP-4844
+                let fields = [num(1), num(i), num(2), num(100), num(tx.gasLimit), '0x' + '44'.repeat(20), num(tx.value), tx.data, [], num(3), ['0x01' + '55'.repeat(31)]];
+                if (i % 12 === 5) {
+                    raw = ethers.utils.hexConcat(['0x03', ethers.utils.RLP.encode(signTyped(key, '0x03', fields))]);
+                } else {
+                    // Network form, as sent to eth_sendRawTransaction: [tx, blobs, commitments, proofs]
+                    raw = ethers.utils.hexConcat(['0x03', ethers.utils.RLP.encode([signTyped(key, '0x03', fields), ['0x' + '99'.repeat(64)], ['0x' + 'aa'.repeat(48)], ['0x' + 'bb'.repeat(48)]])]);
+                    networkForm.push(i);
+                }
+                break;
+            }
+            case 6: {
+                // EIP-7702, with authorizationList [[chainId, address, nonce, yParity, r, s]]
+                let auth = [num(1), '0x' + '66'.repeat(20), num(i), num(1), '0x' + '77'.repeat(32), '0x' + '88'.repeat(32)];
+                let fields = [num(1), num(i), num(2), num(100), num(tx.gasLimit), '0x' + '44'.repeat(20), num(tx.value), tx.data, [], [auth]];
+                raw = ethers.utils.hexConcat(['0x04', ethers.utils.RLP.encode(signTyped(key, '0x04', fields))]);
+                break;
+            }
+        }
+
+        let sender = ethers.utils.computeAddress(key.privateKey);
+        if (i < 30 && i % 6 !== 5) expect(ethers.utils.parseTransaction(raw).from).to.equal(sender);
+
+        txs.push(raw);
+        expected.push(sender.toLowerCase());
+    }
+
+    txs.push('0x05' + txs[3].substr(4), txs[4].substr(0, txs[4].length - 2));
+    expected.push(null, null);
+
+    let recoverSenders = (cmd, args) => child_process.execSync(`./testHarness ${cmd} ${args.join(' ')}`).toString().trimEnd().split("\n").map(r => JSON.parse(r));
+
+    let res = recoverSenders('recoverSenders', txs);
+    expect(res.pop()).to.equal(2);
+    expect(res).to.deep.equal(expected);
+
+    // A block embeds legacy transactions as lists, and typed ones as strings (never in network form)
+    let inBlock = [...Array(32).keys()].filter(i => !networkForm.includes(i));
+    let blockTxs = inBlock.map(i => ethers.utils.arrayify(txs[i])[0] >= 0xc0 ? ethers.utils.RLP.decode(txs[i]) : txs[i]);
+    res = recoverSenders('recoverBlockSenders', [ethers.utils.RLP.encode([['0x01', '0x02'], blockTxs, []])]);
+    expect(res.pop()).to.equal(0);
+    expect(res).to.deep.equal(inBlock.map(i => expected[i]));
+}
+
+
+
+
+
+////////////// EIP-712
+
+{
+    let types = {
+        Order: [
+            { name: 'maker', type: 'address' }, { name: 'amounts', type: 'uint256[]' }, { name: 'legs', type: 'Leg[2]' }, { name: 'memo', type: 'bytes' },
+            { name: 'tags', type: 'string[]' }, { name: 'delta', type: 'int64' }, { name: 'flag', type: 'bool' }, { name: 'sel', type: 'bytes4' }, { name: 'grid', type: 'uint8[][]' },
+        ],
+        Leg: [{ name: 'asset', type: 'Asset' }, { name: 'qty', type: 'uint128' }],
+        Asset: [{ name: 'token', type: 'address' }, { name: 'id', type: 'uint256' }],
+    };
+
+    let order = {
+        maker: '0x' + '12'.repeat(20),
+        amounts: ['1', '2', 3],
+        legs: [{ asset: { token: '0x' + '34'.repeat(20), id: '7' }, qty: '99' }, { asset: { token: '0x' + '56'.repeat(20), id: '8' }, qty: 100 }],
+        memo: '0xdeadbeef',
+        tags: ['a', 'bb', ''],
+        delta: '-5',
+        flag: true,
+        sel: '0x01020304',
+        grid: [[1, 2], [], [3]],
+    };
+
+    for (let domain of [{ name: 'X', chainId: 5, salt: '0x' + 'ab'.repeat(32) }, { name: 'Exchange', version: '2', chainId: 1, verifyingContract: '0x' + '78'.repeat(20) }]) {
+        let res = JSON.parse(child_process.execSync(`./testHarness eip712Hash '${JSON.stringify(types)}' '${JSON.stringify(domain)}' Order '${JSON.stringify(order)}'`).toString());
+
+        expect(res.encodeType).to.equal(ethers.utils._TypedDataEncoder.from(types).encodeType('Order'));
+        expect(res.domainSeparator).to.equal(ethers.utils._TypedDataEncoder.hashDomain(domain));
+        expect(res.structHash).to.equal(ethers.utils._TypedDataEncoder.hashStruct('Order', types, order));
+        expect(res.digest).to.equal(ethers.utils._TypedDataEncoder.hash(domain, types, order));
+    }
+
+    // Typed hashing and batch signer recovery
+    let mailTypes = {
+        Person: [{ name: 'name', type: 'string' }, { name: 'wallet', type: 'address' }],
+        Mail: [{ name: 'from', type: 'Person' }, { name: 'to', type: 'Person' }, { name: 'contents', type: 'string' }],
+    };
+    let domain = { name: 'Ether Mail', version: '1', chainId: 1, verifyingContract: '0xCcCCccccCCCCcCCCCCCcCcCccCcCCCcCcccccccC' };
+
+    let args = [], expected = [];
+
+    for (let i = 0; i < 40; i++) {
+        let key = ethers.utils.keccak256(ethers.utils.toUtf8Bytes(`key ${i}`));
+        let mail = {
+            from: { name: `sender ${i}`, wallet: ethers.utils.computeAddress(key).toLowerCase() },
+            to: { name: 'Bob', wallet: '0x' + 'bb'.repeat(20) },
+            contents: 'x'.repeat(i),
+        };
+
+        let digest = ethers.utils._TypedDataEncoder.hash(domain, mailTypes, mail);
+        let sig = ethers.utils.joinSignature(new ethers.utils.SigningKey(key).signDigest(digest));
+        let signer = mail.from.wallet;
+
+        if (i % 10 === 3) sig = '0x1234'; // malformed
+        if (i % 10 === 7) sig = ethers.utils.splitSignature(sig).compact; // EIP-2098
+
+        args.push(`'${JSON.stringify(mail)}'`, sig);
+        expected.push({ digest, signer: sig === '0x1234' ? null : signer });
+    }
+
+    let res = child_process.execSync(`./testHarness eip712RecoverMail '${JSON.stringify(domain)}' ${args.join(' ')}`).toString().trimEnd().split("\n").map(r => JSON.parse(r));
+    expect(res).to.deep.equal(expected);
+}
+
+
+
+
+
+////////////// MULTICALL
+
+{
+    let multicall3 = new ethers.utils.Interface([
+        "function aggregate3((address target, bool allowFailure, bytes callData)[] calls) payable returns ((bool success, bytes returnData)[] returnData)",
+    ]);
+
+    let a = '0x' + '11'.repeat(20), b = '0x' + '22'.repeat(20);
+
+    let calls = [
+        [a, 'decode_flat1', {}],
+        [b, 'encode_overloaded(uint256)', { p1: 7 }],
+        [b, 'no_such_function', {}],
+        [a, 'encode_overloaded(string,uint256)', { p1: 'x'.repeat(100), p2: 8 }],
+        [b, 'decode_flat1', {}],
+    ];
+
+    let multicallEncode = (limits) => {
+        let res = child_process.execSync(`./testHarness multicallEncode '${JSON.stringify(calls)}' '${JSON.stringify(limits)}'`).toString().trimEnd().split("\n").map(r => JSON.parse(r));
+        let errors = res.pop();
+
+        // Calls that can't be encoded fail without being sent
+        expect(errors.map(e => e !== '')).to.deep.equal([false, false, true, false, false]);
+
+        for (let chunk of res) {
+            // Only a call that's too big on its own can take a chunk over the limit
+            if (chunk.calls.length > 1) expect(ethers.utils.hexDataLength(chunk.data)).to.be.at.most(limits.maxBytes);
+
+            let decoded = multicall3.decodeFunctionData('aggregate3', chunk.data);
+            expect(decoded.calls.map(c => [c.target.toLowerCase(), c.allowFailure, c.callData])).to.deep.equal(chunk.calls.map(i => [
+                calls[i][0],
+                true,
+                interface.encodeFunctionData(calls[i][1], Object.values(calls[i][2])),
+            ]));
+        }
+
+        return res.map(chunk => chunk.calls);
+    };
+
+    let unlimited = { maxCalls: 1000, maxBytes: 1000000, maxGas: 30000000 };
+    expect(multicallEncode(unlimited)).to.deep.equal([[0, 1, 3, 4]]);
+    expect(multicallEncode({ ...unlimited, maxCalls: 3 })).to.deep.equal([[0, 1, 3], [4]]);
+    expect(multicallEncode({ ...unlimited, maxGas: 100000 })).to.deep.equal([[0, 1], [3, 4]]);
+    expect(multicallEncode({ ...unlimited, maxBytes: 500 })).to.deep.equal([[0, 1], [3], [4]]);
+    expect(multicallEncode({ ...unlimited, maxBytes: 484 })).to.deep.equal([[0, 1], [3], [4]]); // exactly the calldata size of [0, 1]
+    expect(multicallEncode({ ...unlimited, maxBytes: 483 })).to.deep.equal([[0], [1], [3], [4]]);
+
+    let errorData = '0x08c379a0' + ethers.utils.defaultAbiCoder.encode(['string'], ['nope']).substr(2);
+    let panicData = '0x4e487b71' + ethers.utils.defaultAbiCoder.encode(['uint256'], [0x11]).substr(2);
+
+    let decodeCalls = [[a, 'decode_flat1', {}], [b, 'decode_flat2', {}], [a, 'decode_flat1', {}], [a, 'decode_flat1', {}], [a, 'decode_flat1', {}]];
+    let returnData = multicall3.encodeFunctionResult('aggregate3', [[
+        [true, interface.encodeFunctionResult('decode_flat1', [5])],
+        [true, interface.encodeFunctionResult('decode_flat2', [6, a, ethers.utils.hexZeroPad('0x01', 32), '0x' + '02'.repeat(12), true])],
+        [false, errorData],
+        [false, panicData],
+        [true, '0x'], // doesn't decode
+    ]]);
+
+    let res = child_process.execSync(`./testHarness multicallDecode '${JSON.stringify(decodeCalls)}' ${returnData}`).toString().trimEnd().split("\n").map(r => JSON.parse(r));
+
+    expect(res[0]).to.deep.equal({ success: true, result: { o1: '5' } });
+    expect(res[1].success).to.equal(true);
+    expect(res[1].result.o2).to.equal(a);
+    expect(res[2]).to.deep.equal({ success: false, error: 'reverted: nope' });
+    expect(res[3]).to.deep.equal({ success: false, error: 'panic: 17' });
+    expect(res[4].success).to.equal(false);
+    expect(res[4].error).to.match(/^decoding failed/);
+
+    // A bad aggregate3 result fails every call in the chunk
+    res = child_process.execSync(`./testHarness multicallDecode '${JSON.stringify(decodeCalls)}' 0x1234`).toString().trimEnd().split("\n").map(r => JSON.parse(r));
+    expect(res.every(r => !r.success && r.error.startsWith('bad aggregate3 result'))).to.equal(true);
+}
+
+
+
+
+
+////////////// BINARY ABI
+
+{
+    child_process.execSync(`./testHarness compileAbi artifacts/TestContract.abibin`);
+
+    let commands = [
+        `encodeFunctionData encode_kitchenSink '${JSON.stringify({ p3: -5, p4: "123", p6: "hello", p7: "0x1234", p8: ethers.utils.hexZeroPad("0x01", 32), p9: "0x000000000000000000000001", p10: [3, 4], p11: "0x1111111111111111111111111111111111111111" })}'`,
+        `encodeFunctionData 'encode_overloaded(string,uint256)' '{"p1":"abc","p2":5}'`,
+        `decodeFunctionResult decode_flat1 ${interface.encodeFunctionResult('decode_flat1', [12345])}`,
+        `decodeFunctionData 1 ${interface.encodeFunctionData('encode_overloaded(uint256)', [7])} 0xdeadbeef`,
+        `decodeEvent ${interface.getEventTopic('Transfer')}${"00".repeat(64)} ${"0x" + "33".repeat(32)}`,
+    ];
+
+    for (let cmd of commands) {
+        let fromJson = child_process.execSync(`./testHarness ${cmd}`).toString();
+        let fromBinary = child_process.execSync(`./testHarness ${cmd}`, { env: { ...process.env, ABI_BINARY: 'artifacts/TestContract.abibin' } }).toString();
+        expect(fromBinary).to.equal(fromJson);
+    }
+
+    // Corrupted node layouts are rejected when loading, rather than trusted by the encoder
+    let corrupt = (edit) => {
+        let buf = fs.readFileSync('artifacts/TestContract.abibin');
+        let nodeSize = buf.readUInt32LE(16), numFunctions = buf.readUInt32LE(20), numEvents = buf.readUInt32LE(24), numNodes = buf.readUInt32LE(28);
+        let nodesStart = 40 + numFunctions * 52 + numEvents * 88, stringsStart = nodesStart + numNodes * nodeSize;
+
+        let eventsStart = 40 + numFunctions * 52;
+        let isIndexed = (eventName) => { // start of the event's isIndexed bytes
+            for (let i = 0; i < numEvents; i++) {
+                let e = eventsStart + i * 88;
+                let name = buf.toString('utf8', stringsStart + buf.readUInt32LE(e + 32), stringsStart + buf.readUInt32LE(e + 32) + buf.readUInt32LE(e + 36));
+                if (name === eventName) return stringsStart + buf.readUInt32LE(e + 48);
+            }
+        };
+
+        for (let i = 0; i < numFunctions; i++) {
+            let f = 40 + i * 52;
+            let name = buf.toString('utf8', stringsStart + buf.readUInt32LE(f + 4), stringsStart + buf.readUInt32LE(f + 4) + buf.readUInt32LE(f + 8));
+            if (name === 'encode_flat1') edit(buf, (node) => nodesStart + (buf.readUInt32LE(f + 20) + node) * nodeSize, isIndexed); // first node of inputs
+        }
+
+        fs.writeFileSync('artifacts/Corrupt.abibin', buf);
+        return () => child_process.execSync(`./testHarness encodeFunctionData encode_flat1 '${JSON.stringify({ p1: 1, p2: -2, p3: "0x" + "33".repeat(32), p4: "0x" + "22".repeat(20) })}'`, { stdio: 'pipe', env: { ...process.env, ABI_BINARY: 'artifacts/Corrupt.abibin' } });
+    };
+
+    // root headSize, 4th component's headOffset
+    expect(corrupt((buf, node) => { buf.writeUInt32LE(0, node(0) + 8); buf.writeUInt32LE(1 << 20, node(4) + 12); })).to.throw(/ABI file tuple component at wrong offset/);
+    // static component marked dynamic
+    expect(corrupt((buf, node) => buf.writeUInt8(1, node(1) + 1))).to.throw(/ABI file node has inconsistent layout/);
+    // arraySize on a non-array
+    expect(corrupt((buf, node) => buf.writeUInt32LE(1000, node(1) + 4))).to.throw(/ABI file node has inconsistent layout/);
+    // Transfer's isIndexed is [1, 1, 0]: a byte that isn't 0 or 1, and a count that doesn't match its items
+    expect(corrupt((buf, node, isIndexed) => buf.writeUInt8(2, isIndexed('Transfer') + 2))).to.throw(/ABI file event has bad isIndexed/);
+    expect(corrupt((buf, node, isIndexed) => buf.writeUInt8(0, isIndexed('Transfer') + 1))).to.throw(/ABI file event isIndexed doesn't match its items/);
+}
+
 
 
 
@@ -507,13 +1387,14 @@ function encodeFunctionData(funcName, args) {
     //console.log("EXPECTED:");
     //dumpWords(expectedEncoded.substr(8));
 
-    let resEncoded = child_process.execSync(`./testHarness encodeFunctionData ${funcName} '${JSON.stringify(args)}'`).toString().trimEnd();
+    let resEncoded = child_process.execSync(`./testHarness encodeFunctionData '${funcName}' '${JSON.stringify(args)}'`).toString().trimEnd();
     let res = interface.decodeFunctionData(funcName, resEncoded);
 
     //console.log("GOT:");
     //dumpWords(resEncoded.substr(8));
 
     expect(canonicalJsonStringify(cleanupObj(expected))).to.equal(canonicalJsonStringify(cleanupObj(res)));
+    expect(resEncoded).to.equal(expectedEncoded);
 }
 
 
@@ -534,6 +1415,12 @@ function decodeFunctionResult(funcName, args) {
     let res = child_process.execSync(`./testHarness decodeFunctionResult ${funcName} ${encodedResult}`).toString().trimEnd();
 
     expect(res).to.equal(canonicalJsonStringify(args));
+
+    let streamed = child_process.execSync(`./testHarness decodeFunctionResultStream ${funcName} ${encodedResult}`).toString().trimEnd();
+    expect(canonicalJsonStringify(JSON.parse(streamed))).to.equal(canonicalJsonStringify(args));
+
+    let arena = child_process.execSync(`./testHarness decodeFunctionResultArena ${funcName} ${encodedResult}`).toString().trimEnd();
+    expect(arena).to.equal(canonicalJsonStringify(args));
 }
 
 